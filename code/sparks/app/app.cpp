@@ -131,8 +131,14 @@ void Application::OnUpdate() {
   }
   scene_->SetSceneSettings(settings);
 
-  asset_manager_->Update(core_->CurrentFrame());
+  // The scene requests derived asset data on demand, it has to be bound by
+  // the asset manager in the same frame.
   scene_->UpdatePipelineObjects();
+  const uint64_t num_built_blases = asset_manager_->NumBuiltBlases();
+  asset_manager_->Update(core_->CurrentFrame());
+  // Meshes whose BLAS was just built are ray traced from the next frame on.
+  render_settings_changed_ |=
+      asset_manager_->NumBuiltBlases() != num_built_blases;
 
   core_->TransferCommandPool()->SingleTimeCommands(
       core_->TransferQueue(), [&](VkCommandBuffer cmd_buffer) {
@@ -478,6 +484,11 @@ ImVec2 Application::ImGuiSettingsWindow() {
         ImGui::Checkbox("Direct Lighting",
                         reinterpret_cast<bool *>(
                             &editing_scene_settings_.enable_direct_lighting));
+    const char *light_sampler_names[] = {"Power", "Light BVH"};
+    render_settings_changed_ |= ImGui::Combo(
+        "Light Sampler",
+        reinterpret_cast<int *>(&editing_scene_settings_.light_sampler),
+        light_sampler_names, 2);
     scene_->SetSceneSettings(editing_scene_settings_);
   }
   if (ImGui::CollapsingHeader("Environment Map Settings")) {
@@ -500,8 +511,16 @@ ImVec2 Application::ImGuiSettingsWindow() {
       EntityMetadata metadata;
       scene_->GetEntityMaterial(selected_instances_[0], material);
       scene_->GetEntityMetadata(selected_instances_[0], metadata);
-      render_settings_changed_ |=
-          asset_manager_->ComboForMeshSelection("Mesh", &metadata.mesh_id);
+      const char *primitive_type_names[] = {"Mesh", "Sphere", "Quad", "Disk",
+                                            "Plane"};
+      int primitive_type = metadata.primitive_type;
+      bool primitive_changed =
+          ImGui::Combo("Geometry", &primitive_type, primitive_type_names, 5);
+      render_settings_changed_ |= primitive_changed;
+      if (metadata.primitive_type == uint32_t(PrimitiveType::Mesh)) {
+        render_settings_changed_ |=
+            asset_manager_->ComboForMeshSelection("Mesh", &metadata.mesh_id);
+      }
 
       const char *material_type_names[] = {"Lambertian", "Specular",
                                            "Principled"};
@@ -568,6 +587,14 @@ ImVec2 Application::ImGuiSettingsWindow() {
 
       scene_->SetEntityMaterial(selected_instances_[0], material);
       scene_->SetEntityMetadata(selected_instances_[0], metadata);
+      if (primitive_changed) {
+        if (primitive_type == int(PrimitiveType::Mesh)) {
+          scene_->SetEntityMesh(selected_instances_[0], 0);
+        } else {
+          scene_->SetEntityPrimitive(selected_instances_[0],
+                                     PrimitiveType(primitive_type));
+        }
+      }
     }
   }
   ImGui::End();
@@ -31,19 +31,18 @@ void LoadCornellBox(Scene *scene) {
   // <vertex position="343.0 548.7 332.0" tex_coord="1 0"/>
   // <vertex position="213.0 548.7 332.0" tex_coord="1 1"/>
   // <vertex position="213.0 548.7 227.0" tex_coord="0 1"/>
-  vertices.push_back(make_vertex({343.0f, 548.7f, 227.0f}, {0.0f, 0.0f}));
-  vertices.push_back(make_vertex({343.0f, 548.7f, 332.0f}, {1.0f, 0.0f}));
-  vertices.push_back(make_vertex({213.0f, 548.7f, 332.0f}, {1.0f, 1.0f}));
-  vertices.push_back(make_vertex({213.0f, 548.7f, 227.0f}, {0.0f, 1.0f}));
-  int light_mesh_id =
-      asset_manager->LoadMesh(Mesh(vertices, indices), "LightMesh");
   Material light_material;
   light_material.base_color = {0.0f, 0.0f, 0.0f};
   light_material.emission = {1.0f, 1.0f, 1.0f};
   light_material.emission_strength = 30.0f;
   int light_id = scene->CreateEntity();
-  scene->SetEntityMesh(light_id, light_mesh_id);
+  scene->SetEntityPrimitive(light_id, PrimitiveType::Quad);
   scene->SetEntityMaterial(light_id, light_material);
+  scene->SetEntityTransform(
+      light_id,
+      glm::scale(glm::translate(glm::mat4{1.0f},
+                                glm::vec3{278.0f, 548.7f, 279.5f}),
+                 glm::vec3{130.0f, 1.0f, 105.0f}));
 
   // floor
   // <vertex position="552.8 0.0   0.0" tex_coord="0 0"/>
@@ -304,86 +303,67 @@ void LoadIslandScene(Scene *scene) {
   AssetManager *asset_manager = scene->Renderer()->AssetManager();
   scene->Camera()->GetPosition() = glm::vec3{0.0f, 0.0f, 5.0f};
 
-  auto envmap = scene->GetEnvMap();
-
-  Texture envmap_texture;
-  envmap_texture.LoadFromFile(FindAssetsFile("texture/envmap_clouds_4k.hdr"),
-                              LDRColorSpace::UNORM);
-  auto envmap_id = asset_manager->LoadTexture(envmap_texture, "Envmap");
-  envmap->SetEnvmapTexture(envmap_id);
-  scene->SetEnvmapSettings({0.0f, 1.0f, uint32_t(envmap_id), 0});
-
-  int entity_id = scene->CreateEntity();
-
-  Texture terrain_texture;
-  terrain_texture.LoadFromFile(
+  // Decoding, compression and the terrain tiles run on the asset workers in
+  // parallel, only the uploads are left to this thread.
+  TextureAssetSettings compressed_texture_settings;
+  compressed_texture_settings.compress = true;
+  TextureAssetSettings envmap_settings = compressed_texture_settings;
+  envmap_settings.generate_mips = false;
+  auto envmap_load = asset_manager->LoadTextureAsync(
+      FindAssetsFile("texture/envmap_clouds_4k.hdr"), LDRColorSpace::UNORM,
+      "Envmap", envmap_settings);
+  auto terrain_texture_load = asset_manager->LoadTextureAsync(
       FindAssetsFile("texture/terrain/terrain-texture3.bmp"),
-      LDRColorSpace::UNORM);
+      LDRColorSpace::UNORM, "TerrainTexture", compressed_texture_settings);
+  auto terrain_detail_texture_load = asset_manager->LoadTextureAsync(
+      FindAssetsFile("texture/terrain/detail.bmp"), LDRColorSpace::UNORM,
+      "TerrainDetailTexture", compressed_texture_settings);
+  auto water_texture_load = asset_manager->LoadTextureAsync(
+      FindAssetsFile("texture/terrain/SkyBox/SkyBox5.bmp"),
+      LDRColorSpace::UNORM, "WaterTexture", compressed_texture_settings);
 
-  Texture terrain_detail_texture;
-  terrain_detail_texture.LoadFromFile(
-      FindAssetsFile("texture/terrain/detail.bmp"), LDRColorSpace::UNORM);
-  auto terrain_texture_id =
-      asset_manager->LoadTexture(terrain_texture, "TerrainTexture");
-  auto terrain_detail_texture_id = asset_manager->LoadTexture(
-      terrain_detail_texture, "TerrainDetailTexture");
+  // Each tile gets an entity and a BLAS of its own, so that the tiles are
+  // loaded in parallel.
+  auto terrain_tiles_load = asset_manager->LoadThreadPool()->Submit([]() {
+    std::vector<TerrainTile> terrain_tiles;
+    Texture heightmap_texture;
+    if (heightmap_texture.LoadFromFile(
+            FindAssetsFile("texture/terrain/heightmap.bmp"),
+            LDRColorSpace::UNORM)) {
+      return terrain_tiles;
+    }
+    TerrainSettings terrain_settings;
+    terrain_settings.height_scale = 0.2f;
+    BuildTerrainTiles(heightmap_texture, terrain_settings, terrain_tiles);
+    return terrain_tiles;
+  });
 
-  scene->SetEntityAlbedoTexture(entity_id, terrain_texture_id);
-  scene->SetEntityAlbedoDetailTexture(entity_id, terrain_detail_texture_id);
+  asset_manager->WaitAsyncLoads();
 
-  Texture heightmap_texture;
-  heightmap_texture.LoadFromFile(
-      FindAssetsFile("texture/terrain/heightmap.bmp"), LDRColorSpace::UNORM);
-  Mesh terrain_mesh;
-  terrain_mesh.LoadFromHeightMap(heightmap_texture, 1.0f, 0.2f, 0.0f);
-  auto terrain_mesh_id = asset_manager->LoadMesh(terrain_mesh, "TerrainMesh");
+  auto envmap = scene->GetEnvMap();
+  auto envmap_id = envmap_load.get();
+  envmap->SetEnvmapTexture(envmap_id);
+  scene->SetEnvmapSettings({0.0f, 1.0f, uint32_t(envmap_id), 0});
+
+  auto terrain_texture_id = terrain_texture_load.get();
+  auto terrain_detail_texture_id = terrain_detail_texture_load.get();
   Material terrain_material;
   terrain_material.sheen = 1.0f;
-  scene->SetEntityMesh(entity_id, terrain_mesh_id);
-  scene->SetEntityMaterial(entity_id, terrain_material);
-  scene->SetEntityTransform(
-      entity_id,
-      glm::translate(glm::mat4{1.0f}, glm::vec3{0.0f, -0.06f, 0.0f}));
-  scene->SetEntityDetailScaleOffset(entity_id, {20.0f, 20.0f, 0.0f, 0.0f});
-
-  Mesh plane_mesh;
-  std::vector<Vertex> plane_vertices;
-  std::vector<uint32_t> plane_indices;
-  const int precision = 500;
-  const float inv_precision = 1.0f / static_cast<float>(precision);
-  for (int i = 0; i <= precision; i++) {
-    for (int j = 0; j <= precision; j++) {
-      Vertex vertex;
-      vertex.position = {static_cast<float>(i) * inv_precision - 0.5f, 0.0f,
-                         static_cast<float>(j) * inv_precision - 0.5f};
-      vertex.normal = {0.0f, 1.0f, 0.0f};
-      vertex.tangent = {1.0f, 0.0f, 0.0f};
-      vertex.tex_coord = {static_cast<float>(i) * inv_precision,
-                          1.0f - static_cast<float>(j) * inv_precision};
-      vertex.signal = 1.0f;
-      plane_vertices.push_back(vertex);
-    }
-  }
-  for (int i = 0; i < precision; i++) {
-    for (int j = 0; j < precision; j++) {
-      plane_indices.push_back(i * (precision + 1) + j);
-      plane_indices.push_back(i * (precision + 1) + j + 1);
-      plane_indices.push_back((i + 1) * (precision + 1) + j);
-      plane_indices.push_back((i + 1) * (precision + 1) + j);
-      plane_indices.push_back(i * (precision + 1) + j + 1);
-      plane_indices.push_back((i + 1) * (precision + 1) + j + 1);
-    }
+  for (auto &tile : terrain_tiles_load.get()) {
+    auto terrain_mesh_id = asset_manager->LoadMesh(
+        tile.mesh, tile.lods, fmt::format("TerrainMesh {} {}", tile.x, tile.y));
+    int entity_id = scene->CreateEntity();
+    scene->SetEntityAlbedoTexture(entity_id, terrain_texture_id);
+    scene->SetEntityAlbedoDetailTexture(entity_id, terrain_detail_texture_id);
+    scene->SetEntityMesh(entity_id, terrain_mesh_id);
+    scene->SetEntityMaterial(entity_id, terrain_material);
+    scene->SetEntityTransform(
+        entity_id,
+        glm::translate(glm::mat4{1.0f}, glm::vec3{0.0f, -0.06f, 0.0f}));
+    scene->SetEntityDetailScaleOffset(entity_id, {20.0f, 20.0f, 0.0f, 0.0f});
   }
-  plane_mesh = {plane_vertices, plane_indices};
 
-  auto plane_mesh_id = asset_manager->LoadMesh(plane_mesh, "PlaneMesh");
-
-  Texture water_texture;
-  water_texture.LoadFromFile(
-      FindAssetsFile("texture/terrain/SkyBox/SkyBox5.bmp"),
-      LDRColorSpace::UNORM);
-  auto water_texture_id =
-      asset_manager->LoadTexture(water_texture, "WaterTexture");
+  auto water_texture_id = water_texture_load.get();
   int water_entity_id = scene->CreateEntity();
   Material water_material;
   water_material.base_color = {1.0f, 1.0f, 1.0f};
@@ -391,7 +371,7 @@ void LoadIslandScene(Scene *scene) {
   water_material.specular = 1.0f;
   water_material.alpha = 1.0f;
   scene->SetEntityAlbedoDetailTexture(water_entity_id, water_texture_id);
-  scene->SetEntityMesh(water_entity_id, plane_mesh_id);
+  scene->SetEntityPrimitive(water_entity_id, PrimitiveType::Quad);
   scene->SetEntityMaterial(water_entity_id, water_material);
   scene->SetEntityTransform(water_entity_id,
                             glm::scale(glm::mat4{1.0f}, glm::vec3{1000.0f}));
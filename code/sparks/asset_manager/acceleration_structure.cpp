@@ -0,0 +1,231 @@
+#include "sparks/asset_manager/acceleration_structure.h"
+
+#include "algorithm"
+
+namespace sparks {
+
+namespace {
+template <class Procedure>
+void LoadProcedure(VkDevice device, const char *name, Procedure &procedure) {
+  procedure = reinterpret_cast<Procedure>(vkGetDeviceProcAddr(device, name));
+}
+
+// Fills the TLAS build over an instance array, except for the addresses.
+void FillTopLevelBuildInfo(
+    VkAccelerationStructureGeometryKHR &geometry,
+    VkAccelerationStructureBuildGeometryInfoKHR &build_info) {
+  geometry = {};
+  geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+  geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+  geometry.geometry.instances.sType =
+      VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+  geometry.geometry.instances.arrayOfPointers = VK_FALSE;
+
+  build_info = {};
+  build_info.sType =
+      VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+  build_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+  build_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+  build_info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+  build_info.geometryCount = 1;
+  build_info.pGeometries = &geometry;
+}
+}  // namespace
+
+const AccelerationStructureProcedures &GetAccelerationStructureProcedures(
+    vulkan::Core *core) {
+  static AccelerationStructureProcedures procedures{};
+  static VkDevice loaded_device{VK_NULL_HANDLE};
+  VkDevice device = core->Device()->Handle();
+  if (loaded_device != device) {
+    LoadProcedure(device, "vkCreateAccelerationStructureKHR",
+                  procedures.vkCreateAccelerationStructureKHR);
+    LoadProcedure(device, "vkDestroyAccelerationStructureKHR",
+                  procedures.vkDestroyAccelerationStructureKHR);
+    LoadProcedure(device, "vkGetAccelerationStructureBuildSizesKHR",
+                  procedures.vkGetAccelerationStructureBuildSizesKHR);
+    LoadProcedure(device, "vkGetAccelerationStructureDeviceAddressKHR",
+                  procedures.vkGetAccelerationStructureDeviceAddressKHR);
+    LoadProcedure(device, "vkCmdBuildAccelerationStructuresKHR",
+                  procedures.vkCmdBuildAccelerationStructuresKHR);
+    LoadProcedure(device, "vkCmdWriteAccelerationStructuresPropertiesKHR",
+                  procedures.vkCmdWriteAccelerationStructuresPropertiesKHR);
+    LoadProcedure(device, "vkCmdCopyAccelerationStructureKHR",
+                  procedures.vkCmdCopyAccelerationStructureKHR);
+    loaded_device = device;
+  }
+  return procedures;
+}
+
+VkDeviceAddress GetBufferDeviceAddress(vulkan::Core *core,
+                                       vulkan::Buffer *buffer) {
+  VkBufferDeviceAddressInfo address_info{};
+  address_info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+  address_info.buffer = buffer->Handle();
+  return vkGetBufferDeviceAddress(core->Device()->Handle(), &address_info);
+}
+
+int AccelerationStructure::Create(
+    vulkan::Core *core,
+    VkAccelerationStructureTypeKHR type,
+    VkDeviceSize size,
+    std::unique_ptr<AccelerationStructure> *pp_as) {
+  std::unique_ptr<AccelerationStructure> as(new AccelerationStructure);
+  as->core_ = core;
+  as->size_ = size;
+  if (core->CreateStaticBuffer<uint8_t>(
+          size,
+          VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR |
+              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+          &as->buffer_) != VK_SUCCESS) {
+    return -1;
+  }
+
+  auto &procedures = GetAccelerationStructureProcedures(core);
+  VkAccelerationStructureCreateInfoKHR create_info{};
+  create_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+  create_info.buffer = as->buffer_->GetBuffer()->Handle();
+  create_info.size = size;
+  create_info.type = type;
+  if (procedures.vkCreateAccelerationStructureKHR(
+          core->Device()->Handle(), &create_info, nullptr, &as->handle_) !=
+      VK_SUCCESS) {
+    return -1;
+  }
+
+  VkAccelerationStructureDeviceAddressInfoKHR address_info{};
+  address_info.sType =
+      VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+  address_info.accelerationStructure = as->handle_;
+  as->device_address_ = procedures.vkGetAccelerationStructureDeviceAddressKHR(
+      core->Device()->Handle(), &address_info);
+  *pp_as = std::move(as);
+  return 0;
+}
+
+AccelerationStructure::~AccelerationStructure() {
+  if (handle_ != VK_NULL_HANDLE) {
+    GetAccelerationStructureProcedures(core_)
+        .vkDestroyAccelerationStructureKHR(core_->Device()->Handle(), handle_,
+                                           nullptr);
+  }
+}
+
+ScratchBuffer::ScratchBuffer(vulkan::Core *core) : core_(core) {
+  VkPhysicalDeviceAccelerationStructurePropertiesKHR as_properties{};
+  as_properties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &as_properties;
+  vkGetPhysicalDeviceProperties2(core->Device()->PhysicalDevice().Handle(),
+                                 &properties);
+  alignment_ = std::max<VkDeviceSize>(
+      as_properties.minAccelerationStructureScratchOffsetAlignment, 1);
+}
+
+int ScratchBuffer::Reserve(VkDeviceSize size) {
+  if (size <= size_) {
+    return 0;
+  }
+  VkDeviceSize capacity = std::max(size_, alignment_);
+  while (capacity < size) {
+    capacity *= 2;
+  }
+  buffer_.reset();
+  size_ = 0;
+  // The allocation may start anywhere, the slack keeps an aligned start.
+  if (core_->CreateStaticBuffer<uint8_t>(
+          capacity + alignment_,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+          &buffer_) != VK_SUCCESS) {
+    return -1;
+  }
+  VkDeviceAddress address = GetBufferDeviceAddress(core_, buffer_->GetBuffer());
+  device_address_ = (address + alignment_ - 1) / alignment_ * alignment_;
+  size_ = capacity;
+  return 0;
+}
+
+TopLevelAccelerationStructure::TopLevelAccelerationStructure(
+    vulkan::Core *core)
+    : core_(core), scratch_buffer_(core) {
+}
+
+int TopLevelAccelerationStructure::Reserve(uint32_t num_instances) {
+  // Sized for a power of two instances, so that a scene growing one entity
+  // at a time does not reallocate every frame.
+  if (as_ && num_instances <= capacity_) {
+    return 0;
+  }
+  capacity_ = 1;
+  while (capacity_ < num_instances) {
+    capacity_ *= 2;
+  }
+  VkAccelerationStructureGeometryKHR geometry;
+  VkAccelerationStructureBuildGeometryInfoKHR build_info;
+  FillTopLevelBuildInfo(geometry, build_info);
+  VkAccelerationStructureBuildSizesInfoKHR sizes{};
+  sizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+  GetAccelerationStructureProcedures(core_)
+      .vkGetAccelerationStructureBuildSizesKHR(
+          core_->Device()->Handle(),
+          VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &build_info,
+          &capacity_, &sizes);
+  as_.reset();
+  if (AccelerationStructure::Create(
+          core_, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+          sizes.accelerationStructureSize, &as_) ||
+      scratch_buffer_.Reserve(sizes.buildScratchSize)) {
+    as_.reset();
+    return -1;
+  }
+  return 0;
+}
+
+void TopLevelAccelerationStructure::RecordBuild(
+    VkCommandBuffer cmd_buffer,
+    VkDeviceAddress instance_address,
+    uint32_t num_instances) {
+  VkAccelerationStructureGeometryKHR geometry;
+  VkAccelerationStructureBuildGeometryInfoKHR build_info;
+  FillTopLevelBuildInfo(geometry, build_info);
+  geometry.geometry.instances.data.deviceAddress = instance_address;
+  build_info.dstAccelerationStructure = as_->Handle();
+  build_info.scratchData.deviceAddress = scratch_buffer_.DeviceAddress();
+  VkAccelerationStructureBuildRangeInfoKHR range{};
+  range.primitiveCount = num_instances;
+  const VkAccelerationStructureBuildRangeInfoKHR *ranges[] = {&range};
+  GetAccelerationStructureProcedures(core_)
+      .vkCmdBuildAccelerationStructuresKHR(cmd_buffer, 1, &build_info, ranges);
+
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+  barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+  vkCmdPipelineBarrier(cmd_buffer,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
+}
+
+void TopLevelAccelerationStructure::Bind(vulkan::DescriptorSet *descriptor_set,
+                                         uint32_t binding) const {
+  VkAccelerationStructureKHR handle = as_->Handle();
+  VkWriteDescriptorSetAccelerationStructureKHR as_write{};
+  as_write.sType =
+      VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+  as_write.accelerationStructureCount = 1;
+  as_write.pAccelerationStructures = &handle;
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.pNext = &as_write;
+  write.dstSet = descriptor_set->Handle();
+  write.dstBinding = binding;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+  vkUpdateDescriptorSets(core_->Device()->Handle(), 1, &write, 0, nullptr);
+}
+
+}  // namespace sparks
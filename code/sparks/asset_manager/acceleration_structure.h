@@ -0,0 +1,124 @@
+#pragma once
+#include "sparks/asset_manager/asset_manager_utils.h"
+
+namespace sparks {
+
+// Functions of VK_KHR_acceleration_structure. Sparks records its builds
+// itself: LongMarch builds every acceleration structure through a command
+// buffer of its own that it waits for, so builds could be neither batched,
+// compacted nor moved off the graphics queue.
+struct AccelerationStructureProcedures {
+  PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR;
+  PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR;
+  PFN_vkGetAccelerationStructureBuildSizesKHR
+      vkGetAccelerationStructureBuildSizesKHR;
+  PFN_vkGetAccelerationStructureDeviceAddressKHR
+      vkGetAccelerationStructureDeviceAddressKHR;
+  PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR;
+  PFN_vkCmdWriteAccelerationStructuresPropertiesKHR
+      vkCmdWriteAccelerationStructuresPropertiesKHR;
+  PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR;
+};
+
+// Loaded on first use for the device of core.
+const AccelerationStructureProcedures &GetAccelerationStructureProcedures(
+    vulkan::Core *core);
+
+VkDeviceAddress GetBufferDeviceAddress(vulkan::Core *core,
+                                       vulkan::Buffer *buffer);
+
+// Acceleration structure in a buffer of its own, to be built by the caller.
+class AccelerationStructure {
+ public:
+  static int Create(vulkan::Core *core,
+                    VkAccelerationStructureTypeKHR type,
+                    VkDeviceSize size,
+                    std::unique_ptr<AccelerationStructure> *pp_as);
+
+  ~AccelerationStructure();
+
+  AccelerationStructure(const AccelerationStructure &) = delete;
+  AccelerationStructure &operator=(const AccelerationStructure &) = delete;
+
+  VkAccelerationStructureKHR Handle() const {
+    return handle_;
+  }
+
+  VkDeviceAddress DeviceAddress() const {
+    return device_address_;
+  }
+
+  VkDeviceSize Size() const {
+    return size_;
+  }
+
+  vulkan::Buffer *GetBuffer() const {
+    return buffer_->GetBuffer();
+  }
+
+ private:
+  AccelerationStructure() = default;
+
+  vulkan::Core *core_{};
+  std::unique_ptr<vulkan::StaticBuffer<uint8_t>> buffer_;
+  VkAccelerationStructureKHR handle_{VK_NULL_HANDLE};
+  VkDeviceAddress device_address_{};
+  VkDeviceSize size_{};
+};
+
+// Scratch memory for acceleration structure builds. It only grows, so that
+// one allocation serves every later build.
+class ScratchBuffer {
+ public:
+  explicit ScratchBuffer(vulkan::Core *core);
+
+  // Makes room for size bytes, the previous contents are dropped. The buffer
+  // must not be in use by the device.
+  int Reserve(VkDeviceSize size);
+
+  // Offsets of concurrent builds are rounded up to this.
+  VkDeviceSize Alignment() const {
+    return alignment_;
+  }
+
+  // Start of the scratch memory, aligned to Alignment().
+  VkDeviceAddress DeviceAddress() const {
+    return device_address_;
+  }
+
+ private:
+  vulkan::Core *core_;
+  VkDeviceSize alignment_{};
+  VkDeviceSize size_{};
+  std::unique_ptr<vulkan::StaticBuffer<uint8_t>> buffer_;
+  VkDeviceAddress device_address_{};
+};
+
+// Top level acceleration structure over BLAS instances, rebuilt from scratch
+// every frame. Instances with a null accelerationStructureReference are
+// inactive.
+class TopLevelAccelerationStructure {
+ public:
+  explicit TopLevelAccelerationStructure(vulkan::Core *core);
+
+  // Makes room for num_instances, growing to the next power of two. The
+  // structure must not be in use by the device.
+  int Reserve(uint32_t num_instances);
+
+  // Records the build over num_instances instances at instance_address,
+  // followed by a barrier making it visible to the ray tracing shaders.
+  void RecordBuild(VkCommandBuffer cmd_buffer,
+                   VkDeviceAddress instance_address,
+                   uint32_t num_instances);
+
+  // Writes the structure to binding of the descriptor set.
+  void Bind(vulkan::DescriptorSet *descriptor_set, uint32_t binding) const;
+
+ private:
+  vulkan::Core *core_;
+  uint32_t capacity_{};
+  std::unique_ptr<AccelerationStructure> as_;
+  ScratchBuffer scratch_buffer_;
+};
+
+}  // namespace sparks
@@ -1,5 +1,8 @@
 #include "sparks/asset_manager/asset_manager.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <utility>
 
 namespace sparks {
@@ -7,11 +10,49 @@ AssetManager::AssetManager(vulkan::Core *core,
                            uint32_t max_textures,
                            uint32_t max_meshes)
     : core_(core), max_textures_(max_textures), max_meshes_(max_meshes) {
+  // Compressed formats are picked before the upload, so that no texture is
+  // encoded twice on devices that cannot sample BC formats.
+  VkPhysicalDevice physical_device =
+      core_->Device()->PhysicalDevice().Handle();
+  for (uint32_t i = 0; i <= uint32_t(TextureFormat::BC7Srgb); i++) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(
+        physical_device, TextureVkFormat(TextureFormat(i)), &properties);
+    if (properties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) {
+      sampled_formats_ |= 1u << i;
+    }
+  }
+  if (!(sampled_formats_ >> uint32_t(TextureFormat::BC7Unorm) & 1)) {
+    LogWarning("BC formats are not supported, textures stay uncompressed");
+  }
+  // Acceleration structure builds need a compute queue. The transfer queue
+  // keeps them off the graphics queue where its family has one.
+  uint32_t num_queue_families = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device,
+                                           &num_queue_families, nullptr);
+  std::vector<VkQueueFamilyProperties> queue_families(num_queue_families);
+  vkGetPhysicalDeviceQueueFamilyProperties(
+      physical_device, &num_queue_families, queue_families.data());
+  blas_queue_ = core_->GraphicsQueue();
+  blas_command_pool_ = core_->GraphicsCommandPool();
+  if (queue_families[core_->TransferQueue()->QueueFamilyIndex()].queueFlags &
+      VK_QUEUE_COMPUTE_BIT) {
+    blas_queue_ = core_->TransferQueue();
+    blas_command_pool_ = core_->TransferCommandPool();
+  }
+  load_thread_pool_ = std::make_unique<ThreadPool>();
   CreateDescriptorObjects();
   CreateDefaultAssets();
 }
 
 AssetManager::~AssetManager() {
+  // Loads still in flight are abandoned, their futures report a broken
+  // promise.
+  load_thread_pool_.reset();
+  pending_loads_.clear();
+  DropBlasBatch();
+  blas_scratch_buffer_.reset();
   DestroyDefaultAssets();
   DestroyDescriptorObjects();
 }
@@ -22,9 +63,29 @@ void AssetManager::CreateDefaultAssets() {
   Mesh mesh;
   mesh.LoadObjFile(FindAssetsFile("mesh/cube.obj"));
   LoadMesh(mesh, "Cube");
+
+  // Raster stand-ins of the analytic primitives, shared by all entities.
+  const std::pair<PrimitiveType, const char *> primitives[] = {
+      {PrimitiveType::Sphere, "Sphere Primitive"},
+      {PrimitiveType::Quad, "Quad Primitive"},
+      {PrimitiveType::Disk, "Disk Primitive"},
+      {PrimitiveType::Plane, "Plane Primitive"}};
+  primitive_mesh_ids_.assign(uint32_t(PrimitiveType::Plane) + 1, 0);
+  for (auto &[type, name] : primitives) {
+    int mesh_id =
+        LoadMesh(BuildPrimitiveMesh(type), std::vector<MeshLod>{}, name);
+    if (mesh_id < 0) {
+      continue;
+    }
+    meshes_[mesh_id].second->hidden_ = true;
+    primitive_mesh_ids_[uint32_t(type)] = mesh_id;
+  }
 }
 
 void AssetManager::DestroyDefaultAssets() {
+  texture_ids_by_hash_.clear();
+  mesh_ids_by_hash_.clear();
+  pending_blas_builds_.clear();
   textures_.clear();
   meshes_.clear();
 }
@@ -44,6 +105,13 @@ void AssetManager::CreateDescriptorObjects() {
 
   mesh_metadata_buffer_ = std::make_unique<vulkan::DynamicBuffer<MeshMetadata>>(
       core_, max_meshes_, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  texture_level_buffer_ = std::make_unique<vulkan::DynamicBuffer<uint32_t>>(
+      core_, max_textures_, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+  AliasEntry placeholder_entry{1.0f, 0, 1.0f, 0};
+  core_->CreateStaticBuffer<AliasEntry>(1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                        &placeholder_alias_buffer_);
+  placeholder_alias_buffer_->UploadContents(&placeholder_entry, 1);
 
   core_->Device()->CreateDescriptorSetLayout(
       {{0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, max_meshes_,
@@ -57,6 +125,8 @@ void AssetManager::CreateDescriptorObjects() {
        {4, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, max_textures_,
         VK_SHADER_STAGE_RAYGEN_BIT_KHR, nullptr},
        {5, VK_DESCRIPTOR_TYPE_SAMPLER, 2, VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+        nullptr},
+       {6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR,
         nullptr}},
       &descriptor_set_layout_);
 
@@ -80,6 +150,8 @@ void AssetManager::CreateDescriptorObjects() {
         3, mesh_metadata_buffer_->GetBuffer(frame_id));
     descriptor_set->BindSamplers(
         5, {linear_sampler_->Handle(), nearest_sampler_->Handle()});
+    descriptor_set->BindStorageBuffer(
+        6, texture_level_buffer_->GetBuffer(frame_id));
   }
 
   last_frame_bound_mesh_num_ =
@@ -90,77 +162,468 @@ void AssetManager::CreateDescriptorObjects() {
 
 void AssetManager::DestroyDescriptorObjects() {
   descriptor_sets_.clear();
+  placeholder_alias_buffer_.reset();
   descriptor_pool_.reset();
   descriptor_set_layout_.reset();
   linear_sampler_.reset();
   nearest_sampler_.reset();
 }
 
-int AssetManager::LoadTexture(const Texture &texture, std::string name) {
+namespace {
+// Encodes the mip levels of the upload into level_texels, after the texture
+// itself.
+void EncodeMipLevels(TextureUpload &upload) {
+  upload.level_texels.resize(1 + upload.mip_levels.size());
+  for (size_t i = 0; i < upload.mip_levels.size(); i++) {
+    EncodeTexture(upload.mip_levels[i], upload.format,
+                  upload.level_texels[i + 1]);
+  }
+}
+
+// The compressed format asked for, unless the device cannot sample it.
+TextureFormat UploadFormat(TextureFormat format,
+                           TextureFormat compressed_format,
+                           uint32_t sampled_formats) {
+  return sampled_formats >> uint32_t(compressed_format) & 1 ? compressed_format
+                                                            : format;
+}
+
+uint32_t NumUploadLevels(const TextureUpload &upload) {
+  return upload.container ? upload.container->NumLevels()
+                          : 1 + upload.mip_levels.size();
+}
+
+// Baked levels are copied to the staging buffer from the mapped file.
+std::pair<const uint8_t *, size_t> UploadLevelData(const TextureUpload &upload,
+                                                   uint32_t level) {
+  if (upload.container) {
+    return {upload.container->LevelData(level),
+            upload.container->LevelSize(level)};
+  }
+  auto &texels = upload.level_texels[level];
+  return {texels.data(), texels.size()};
+}
+
+Hash128 HashTextureUpload(const TextureUpload &upload) {
+  const uint32_t layout[] = {upload.width, upload.height,
+                             uint32_t(upload.format)};
+  Hash128 hash = HashBytes128(layout, sizeof(layout));
+  for (uint32_t i = 0; i < NumUploadLevels(upload); i++) {
+    auto [texels, size] = UploadLevelData(upload, i);
+    hash = HashBytes128(texels, size, hash);
+  }
+  return hash;
+}
+
+Hash128 HashMeshGeometry(const Mesh &mesh,
+                         const MeshAssetSettings &settings,
+                         const Hash128 &seed) {
+  auto &vertices = mesh.Vertices();
+  auto &indices = mesh.Indices();
+  Hash128 hash =
+      HashBytes128(vertices.data(), vertices.size() * sizeof(Vertex), seed);
+  hash = HashBytes128(indices.data(), indices.size() * sizeof(uint32_t), hash);
+  const uint32_t layout[] = {uint32_t(settings.vertex_format),
+                             uint32_t(settings.allow_16bit_indices)};
+  return HashBytes128(layout, sizeof(layout), hash);
+}
+
+// Key of a mesh whose LODs BuildMeshLods generates from the lod_settings,
+// which are all 4-byte fields.
+Hash128 HashMesh(const Mesh &mesh, const MeshAssetSettings &settings) {
+  return HashBytes128(&settings.lod_settings, sizeof(MeshLodSettings),
+                      HashMeshGeometry(mesh, settings, {}));
+}
+
+// Key of a mesh loaded with precomputed LODs.
+Hash128 HashMesh(const Mesh &mesh,
+                 const std::vector<MeshLod> &lods,
+                 const MeshAssetSettings &settings) {
+  Hash128 hash = HashMeshGeometry(mesh, settings, {});
+  for (auto &lod : lods) {
+    hash = HashMeshGeometry(lod.mesh, settings, hash);
+    hash = HashBytes128(&lod.error, sizeof(lod.error), hash);
+  }
+  return hash;
+}
+
+// Begins a one time command buffer from the pool.
+VkCommandBuffer BeginOneTimeCommands(VkDevice device,
+                                     vulkan::CommandPool *command_pool) {
+  VkCommandBufferAllocateInfo allocate_info{};
+  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.commandPool = command_pool->Handle();
+  allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandBufferCount = 1;
+  VkCommandBuffer cmd_buffer;
+  vkAllocateCommandBuffers(device, &allocate_info, &cmd_buffer);
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(cmd_buffer, &begin_info);
+  return cmd_buffer;
+}
+
+// Ends the command buffer and submits it to the queue, the fence is signaled
+// once it has run.
+void SubmitOneTimeCommands(vulkan::Queue *queue,
+                           VkCommandBuffer cmd_buffer,
+                           VkFence fence) {
+  vkEndCommandBuffer(cmd_buffer);
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cmd_buffer;
+  vkQueueSubmit(queue->Handle(), 1, &submit_info, fence);
+}
+
+// Hands the buffer of a BLAS from the queue family that built it to the one
+// that traces it. The release and the acquire record the same barrier.
+void RecordBlasOwnershipTransfer(VkCommandBuffer cmd_buffer,
+                                 const AccelerationStructure &blas,
+                                 uint32_t src_family,
+                                 uint32_t dst_family,
+                                 bool acquire) {
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask =
+      acquire ? 0 : VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+  barrier.dstAccessMask =
+      acquire ? VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR : 0;
+  barrier.srcQueueFamilyIndex = src_family;
+  barrier.dstQueueFamilyIndex = dst_family;
+  barrier.buffer = blas.GetBuffer()->Handle();
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(
+      cmd_buffer,
+      acquire ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+              : VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+      acquire ? VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR |
+                    VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR
+              : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+}  // namespace
+
+int AssetManager::LoadTexture(const Texture &texture,
+                              std::string name,
+                              const TextureAssetSettings &settings) {
+  TextureUpload upload;
+  PrepareTextureUpload(texture, settings, sampled_formats_, upload);
+  return CreateTextureAsset(upload, std::move(name));
+}
+
+int AssetManager::LoadTexture(const std::string &file_path,
+                              LDRColorSpace ldr_color_space,
+                              std::string name,
+                              const TextureAssetSettings &settings) {
+  TextureUpload upload;
+  if (PrepareTextureUpload(file_path, ldr_color_space, settings,
+                           sampled_formats_, upload)) {
+    LogWarning("Failed to load texture {}", file_path);
+    return -1;
+  }
+  return CreateTextureAsset(upload, std::move(name));
+}
+
+int AssetManager::BakeTextureFile(const std::string &file_path,
+                                  LDRColorSpace ldr_color_space,
+                                  const TextureAssetSettings &settings,
+                                  const std::string &ktx2_path) {
+  if (!settings.generate_mips) {
+    LogWarning("KTX2 texture needs a full mip chain: {}", ktx2_path);
+    return -1;
+  }
+  // Baked files do not depend on the device they are made on.
+  TextureUpload upload;
+  if (PrepareTextureUpload(file_path, ldr_color_space, settings, ~0u,
+                           upload)) {
+    LogWarning("Failed to load texture {}", file_path);
+    return -1;
+  }
+  if (upload.container) {
+    LogWarning("Texture {} is baked already", file_path);
+    return -1;
+  }
+  EnvmapImportance envmap_importance;
+  if (upload.build_envmap_importance(envmap_importance)) {
+    LogWarning("Failed to load texture {}", file_path);
+    return -1;
+  }
+  return SaveKtx2File(ktx2_path, upload.format, upload.width, upload.height,
+                      upload.level_texels, &envmap_importance);
+}
+
+void AssetManager::PrepareTextureUpload(const Texture &texture,
+                                        const TextureAssetSettings &settings,
+                                        uint32_t sampled_formats,
+                                        TextureUpload &upload) {
+  upload.width = texture.Width();
+  upload.height = texture.Height();
+  upload.format =
+      settings.compress
+          ? UploadFormat(texture.Format(),
+                         CompressedTextureFormat(texture, settings.prefer_bc1),
+                         sampled_formats)
+          : texture.Format();
+  upload.level_texels.resize(1);
+  EncodeTexture(texture, upload.format, upload.level_texels[0]);
+  upload.mip_levels.clear();
+  if (settings.generate_mips) {
+    BuildMipChain(texture, upload.mip_levels);
+  }
+  EncodeMipLevels(upload);
+  // Nothing of the texture is kept to come back to, so in-memory textures are
+  // reduced right away. The cells are small next to the mip chain.
+  auto envmap_importance = std::make_shared<EnvmapImportance>();
+  BuildEnvmapImportance(texture, *envmap_importance);
+  upload.build_envmap_importance =
+      [envmap_importance](EnvmapImportance &importance) {
+        importance = *envmap_importance;
+        return 0;
+      };
+  upload.content_hash = HashTextureUpload(upload);
+}
+
+int AssetManager::PrepareTextureUpload(const std::string &file_path,
+                                       LDRColorSpace ldr_color_space,
+                                       const TextureAssetSettings &settings,
+                                       uint32_t sampled_formats,
+                                       TextureUpload &upload) {
+  if (file_path.size() >= 5 &&
+      file_path.substr(file_path.size() - 5) == ".ktx2") {
+    auto container = std::make_unique<Ktx2File>();
+    if (container->Open(file_path)) {
+      return -1;
+    }
+    upload.width = container->Width();
+    upload.height = container->Height();
+    // There is nothing to fall back to, the levels exist in this format only.
+    if (!(sampled_formats >> uint32_t(container->Format()) & 1)) {
+      LogWarning("Texture {} is baked in a format the device cannot sample",
+                 file_path);
+      return -1;
+    }
+    upload.format = container->Format();
+    upload.build_envmap_importance = [file_path](EnvmapImportance &importance) {
+      Ktx2File container;
+      if (container.Open(file_path) ||
+          container.ReadEnvmapImportance(importance)) {
+        // Without the baked reduction the envmap is sampled uniformly.
+        importance.width = 1;
+        importance.height = 1;
+        importance.radiance = {1.0f};
+      }
+      return 0;
+    };
+    upload.container = std::move(container);
+    upload.content_hash = HashTextureUpload(upload);
+    return 0;
+  }
+
+  TextureReader reader;
+  if (reader.Open(file_path, ldr_color_space)) {
+    return -1;
+  }
+  upload.width = reader.Width();
+  upload.height = reader.Height();
+  upload.format =
+      settings.compress
+          ? UploadFormat(reader.Format(),
+                         CompressedTextureFormat(reader.Format(),
+                                                 reader.Opaque(),
+                                                 settings.prefer_bc1),
+                         sampled_formats)
+          : reader.Format();
+  upload.build_envmap_importance = [file_path, ldr_color_space](
+                                       EnvmapImportance &importance) {
+    TextureReader reader;
+    if (reader.Open(file_path, ldr_color_space)) {
+      return -1;
+    }
+    return BuildEnvmapImportance(reader, importance);
+  };
+
+  // Only the level below the image is kept as floats, the rest of the chain
+  // is built from it.
+  upload.level_texels.resize(1);
+  upload.mip_levels.clear();
+  const bool has_mips =
+      settings.generate_mips && (reader.Width() > 1 || reader.Height() > 1);
+  Texture first_mip_level;
+  if (EncodeTextureStream(reader, upload.format, upload.level_texels[0],
+                          has_mips ? &first_mip_level : nullptr)) {
+    return -1;
+  }
+  if (has_mips) {
+    std::vector<Texture> lower_levels;
+    BuildMipChain(first_mip_level, lower_levels);
+    upload.mip_levels.push_back(std::move(first_mip_level));
+    for (auto &level : lower_levels) {
+      upload.mip_levels.push_back(std::move(level));
+    }
+  }
+  EncodeMipLevels(upload);
+  upload.content_hash = HashTextureUpload(upload);
+  return 0;
+}
+
+int AssetManager::CreateTextureAsset(TextureUpload &upload, std::string name) {
+  int texture_id = AcquireTexture(upload.content_hash);
+  if (texture_id >= 0) {
+    return texture_id;
+  }
+
+  const uint32_t num_levels = NumUploadLevels(upload);
+  // Every uploaded level takes a slot of its own in sampled_textures.
+  uint32_t binding_texture_id = 0;
+  for (auto &[id, entry] : textures_) {
+    binding_texture_id += entry.second->num_binding_slots_;
+  }
+  const uint32_t num_binding_slots = num_levels;
+  if (binding_texture_id + num_binding_slots > max_textures_) {
+    LogWarning("Texture {} exceeds the texture binding slots", name);
+    return -1;
+  }
+
   TextureAsset texture_asset;
   texture_asset.name_ = std::move(name);
-  if (core_->Device()->CreateImage(
-          VK_FORMAT_R32G32B32A32_SFLOAT,
-          VkExtent2D{texture.Width(), texture.Height()},
-          &texture_asset.image_) != VK_SUCCESS) {
+  texture_asset.format_ = upload.format;
+  texture_asset.num_binding_slots_ = num_binding_slots;
+  // Compressed images are neither storage images nor attachments, only
+  // request what sampling needs.
+  const VkImageUsageFlags usage =
+      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  if (core_->Device()->CreateImage(TextureVkFormat(texture_asset.format_),
+                                   VkExtent2D{upload.width, upload.height},
+                                   usage,
+                                   &texture_asset.image_) != VK_SUCCESS) {
     return -1;
   }
 
+  auto [texels, texels_size] = UploadLevelData(upload, 0);
   UploadImage(core_->GraphicsQueue(), core_->GraphicsCommandPool(),
-              texture_asset.image_.get(), texture.Data(),
-              texture.Width() * texture.Height() * sizeof(glm::vec4));
-
-  std::vector<float> pixel_cdf(texture.Width() * texture.Height());
-
-  float accumulated_weight = 0.0;
-  for (uint32_t y = 0; y < texture.Height(); y++) {
-    for (uint32_t x = 0; x < texture.Width(); x++) {
-      uint32_t index = y * texture.Width() + x;
-      glm::vec3 pixel{texture(x, y)};
-      accumulated_weight += std::max(pixel.x, std::max(pixel.y, pixel.z));
-      pixel_cdf[index] = accumulated_weight;
-    }
-  }
+              texture_asset.image_.get(), texels, texels_size);
 
-  for (auto &weight : pixel_cdf) {
-    weight /= accumulated_weight;
+  for (uint32_t i = 1; i < num_levels; i++) {
+    std::unique_ptr<vulkan::Image> image;
+    if (core_->Device()->CreateImage(
+            TextureVkFormat(texture_asset.format_),
+            VkExtent2D{std::max(upload.width >> i, 1u),
+                       std::max(upload.height >> i, 1u)},
+            usage, &image) != VK_SUCCESS) {
+      return -1;
+    }
+    auto [level_texels, level_size] = UploadLevelData(upload, i);
+    UploadImage(core_->GraphicsQueue(), core_->GraphicsCommandPool(),
+                image.get(), level_texels, level_size);
+    texture_asset.mip_images_.push_back(std::move(image));
   }
-  core_->CreateStaticBuffer<float>(pixel_cdf.size(),
-                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                   &texture_asset.cdf_buffer_);
-  texture_asset.cdf_buffer_->UploadContents(pixel_cdf.data(), pixel_cdf.size());
 
-  uint32_t binding_texture_id = textures_.size();
+  texture_asset.build_envmap_importance_ =
+      std::move(upload.build_envmap_importance);
+  texture_asset.content_hash_ = upload.content_hash;
 
   textures_[next_texture_id_] = {
       binding_texture_id,
       std::make_unique<TextureAsset>(std::move(texture_asset))};
+  texture_ids_by_hash_[upload.content_hash] = next_texture_id_;
 
   return next_texture_id_++;
 }
 
-int AssetManager::LoadMesh(const Mesh &mesh, std::string name) {
+int AssetManager::LoadMesh(const Mesh &mesh,
+                           std::string name,
+                           const MeshAssetSettings &settings) {
+  // Duplicates skip the LOD generation as well.
+  const Hash128 content_hash = HashMesh(mesh, settings);
+  int mesh_id = AcquireMesh(content_hash);
+  if (mesh_id >= 0) {
+    return mesh_id;
+  }
+  std::vector<MeshLod> lods;
+  BuildMeshLods(mesh, settings.lod_settings, lods);
+  return CreateMeshWithLods(mesh, lods, std::move(name), settings,
+                            content_hash);
+}
+
+int AssetManager::LoadMesh(const Mesh &mesh,
+                           const std::vector<MeshLod> &lods,
+                           std::string name,
+                           const MeshAssetSettings &settings) {
+  const Hash128 content_hash = HashMesh(mesh, lods, settings);
+  int mesh_id = AcquireMesh(content_hash);
+  if (mesh_id >= 0) {
+    return mesh_id;
+  }
+  return CreateMeshWithLods(mesh, lods, std::move(name), settings,
+                            content_hash);
+}
+
+int AssetManager::CreateMeshWithLods(const Mesh &mesh,
+                                     const std::vector<MeshLod> &lods,
+                                     std::string name,
+                                     const MeshAssetSettings &settings,
+                                     const Hash128 &content_hash) {
+  int mesh_id = CreateMeshAsset(mesh, std::move(name), settings);
+  if (mesh_id < 0) {
+    return -1;
+  }
+  meshes_[mesh_id].second->content_hash_ = content_hash;
+  mesh_ids_by_hash_[content_hash] = mesh_id;
+
+  for (size_t i = 0; i < lods.size(); i++) {
+    std::string lod_name =
+        fmt::format("{} LOD{}", meshes_[mesh_id].second->name_, i + 1);
+    int lod_mesh_id =
+        CreateMeshAsset(lods[i].mesh, std::move(lod_name), settings);
+    if (lod_mesh_id < 0) {
+      break;
+    }
+    auto lod_mesh = meshes_[lod_mesh_id].second.get();
+    lod_mesh->lod_error_ = lods[i].error;
+    lod_mesh->hidden_ = true;
+    meshes_[mesh_id].second->lod_mesh_ids_.push_back(lod_mesh_id);
+  }
+
+  return mesh_id;
+}
+
+int AssetManager::CreateMeshAsset(const Mesh &mesh,
+                                  std::string name,
+                                  const MeshAssetSettings &settings) {
   auto &vertices = mesh.Vertices();
   auto &indices = mesh.Indices();
 
   float area = 0.0;
-  std::vector<float> area_cdf(indices.size() / 3);
+  std::vector<float> triangle_areas(indices.size() / 3);
   for (int i = 0; i < indices.size() / 3; i++) {
-    area += glm::length(glm::cross(vertices[indices[i * 3 + 1]].position -
-                                       vertices[indices[i * 3]].position,
-                                   vertices[indices[i * 3 + 2]].position -
-                                       vertices[indices[i * 3]].position)) *
-            0.5;
-    area_cdf[i] = area;
+    triangle_areas[i] =
+        glm::length(glm::cross(vertices[indices[i * 3 + 1]].position -
+                                   vertices[indices[i * 3]].position,
+                               vertices[indices[i * 3 + 2]].position -
+                                   vertices[indices[i * 3]].position)) *
+        0.5;
+    area += triangle_areas[i];
   }
-  for (auto &weight : area_cdf) {
-    weight /= area;
+  // The full layout is Vertex itself and is uploaded without a copy.
+  const uint32_t *vertex_words =
+      reinterpret_cast<const uint32_t *>(vertices.data());
+  size_t num_vertex_words = vertices.size() * (sizeof(Vertex) / 4);
+  std::vector<uint32_t> encoded_vertices;
+  if (settings.vertex_format == VertexFormat::Compact) {
+    EncodeCompactVertices(vertices, encoded_vertices);
+    vertex_words = encoded_vertices.data();
+    num_vertex_words = encoded_vertices.size();
   }
 
   MeshAsset mesh_asset;
   mesh_asset.name_ = std::move(name);
-  if (core_->CreateStaticBuffer<Vertex>(
-          mesh.Vertices().size(),
+  mesh_asset.num_vertices_ = vertices.size();
+  mesh_asset.vertex_format_ = settings.vertex_format;
+  if (core_->CreateStaticBuffer<uint32_t>(
+          num_vertex_words,
           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
               VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
@@ -169,8 +632,23 @@ int AssetManager::LoadMesh(const Mesh &mesh, std::string name) {
     return -1;
   }
 
+  const uint32_t *index_words = indices.data();
+  size_t num_index_words = indices.size();
+  std::vector<uint32_t> packed_indices;
+  IndexFormat index_format = IndexFormat::Uint32;
+  if (settings.allow_16bit_indices) {
+    index_format = SelectIndexFormat(vertices.size());
+  }
+  if (index_format == IndexFormat::Uint16) {
+    PackIndices16(indices, packed_indices);
+    index_words = packed_indices.data();
+    num_index_words = packed_indices.size();
+  }
+  mesh_asset.num_indices_ = indices.size();
+  mesh_asset.index_format_ = index_format;
+
   if (core_->CreateStaticBuffer<uint32_t>(
-          mesh.Indices().size(),
+          num_index_words,
           VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
               VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
@@ -179,38 +657,563 @@ int AssetManager::LoadMesh(const Mesh &mesh, std::string name) {
     return -1;
   }
 
-  if (core_->CreateStaticBuffer<float>(
-          area_cdf.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-          &mesh_asset.area_cdf_buffer_) != VK_SUCCESS) {
-    return -1;
+  mesh_asset.vertex_buffer_->UploadContents(vertex_words, num_vertex_words);
+  mesh_asset.index_buffer_->UploadContents(index_words, num_index_words);
+  mesh_asset.area_ = area;
+  mesh_asset.triangle_areas_ = std::move(triangle_areas);
+
+  glm::vec3 lower{0.0f};
+  glm::vec3 upper{0.0f};
+  if (!vertices.empty()) {
+    lower = upper = vertices[0].position;
+  }
+  for (auto &vertex : vertices) {
+    lower = glm::min(lower, vertex.position);
+    upper = glm::max(upper, vertex.position);
+  }
+  mesh_asset.center_ = (lower + upper) * 0.5f;
+  mesh_asset.radius_ = 0.0f;
+  for (auto &vertex : vertices) {
+    mesh_asset.radius_ = std::max(
+        mesh_asset.radius_, glm::length(vertex.position - mesh_asset.center_));
   }
 
-  mesh_asset.vertex_buffer_->UploadContents(mesh.Vertices().data(),
-                                            mesh.Vertices().size());
-  mesh_asset.index_buffer_->UploadContents(mesh.Indices().data(),
-                                           mesh.Indices().size());
-  mesh_asset.area_cdf_buffer_->UploadContents(area_cdf.data(), area_cdf.size());
-  mesh_asset.area_ = area;
+  uint32_t mesh_id = next_mesh_id_++;
+  uint32_t binding_mesh_id = meshes_.size();
+  meshes_[mesh_id] = {binding_mesh_id,
+                      std::make_unique<MeshAsset>(std::move(mesh_asset))};
+  return mesh_id;
+}
+
+std::shared_future<int> AssetManager::LoadTextureAsync(
+    std::function<int(Texture &)> load,
+    std::string name,
+    const TextureAssetSettings &settings) {
+  PendingLoad pending;
+  std::shared_future<int> result = pending.result.get_future().share();
+  pending.prepared = load_thread_pool_->Submit(
+      [this, load = std::move(load), name = std::move(name),
+       settings]() -> std::function<int()> {
+        auto texture = std::make_shared<Texture>();
+        if (load(*texture)) {
+          LogWarning("Failed to load texture {}", name);
+          return []() { return -1; };
+        }
+        auto upload = std::make_shared<TextureUpload>();
+        PrepareTextureUpload(*texture, settings, sampled_formats_, *upload);
+        return [this, upload, name]() {
+          return CreateTextureAsset(*upload, name);
+        };
+      });
+  pending_loads_.push_back(std::move(pending));
+  return result;
+}
+
+std::shared_future<int> AssetManager::LoadTextureAsync(
+    std::string file_path,
+    LDRColorSpace ldr_color_space,
+    std::string name,
+    const TextureAssetSettings &settings) {
+  PendingLoad pending;
+  std::shared_future<int> result = pending.result.get_future().share();
+  pending.prepared = load_thread_pool_->Submit(
+      [this, file_path = std::move(file_path), ldr_color_space,
+       name = std::move(name), settings]() -> std::function<int()> {
+        auto upload = std::make_shared<TextureUpload>();
+        if (PrepareTextureUpload(file_path, ldr_color_space, settings,
+                                 sampled_formats_, *upload)) {
+          LogWarning("Failed to load texture {}", file_path);
+          return []() { return -1; };
+        }
+        return [this, upload, name]() {
+          return CreateTextureAsset(*upload, name);
+        };
+      });
+  pending_loads_.push_back(std::move(pending));
+  return result;
+}
+
+std::shared_future<int> AssetManager::LoadMeshAsync(
+    std::function<int(Mesh &)> load,
+    std::string name,
+    const MeshAssetSettings &settings) {
+  PendingLoad pending;
+  std::shared_future<int> result = pending.result.get_future().share();
+  pending.prepared = load_thread_pool_->Submit(
+      [this, load = std::move(load), name = std::move(name),
+       settings]() -> std::function<int()> {
+        auto mesh = std::make_shared<Mesh>();
+        if (load(*mesh)) {
+          LogWarning("Failed to load mesh {}", name);
+          return []() { return -1; };
+        }
+        // Whether the mesh is a duplicate is only known on the render
+        // thread, the LODs are built regardless.
+        const Hash128 content_hash = HashMesh(*mesh, settings);
+        auto lods = std::make_shared<std::vector<MeshLod>>();
+        BuildMeshLods(*mesh, settings.lod_settings, *lods);
+        return [this, mesh, lods, name, settings, content_hash]() {
+          int mesh_id = AcquireMesh(content_hash);
+          if (mesh_id >= 0) {
+            return mesh_id;
+          }
+          return CreateMeshWithLods(*mesh, *lods, name, settings,
+                                    content_hash);
+        };
+      });
+  pending_loads_.push_back(std::move(pending));
+  return result;
+}
 
-  if (core_->CreateBottomLevelAccelerationStructure(
-          mesh_asset.vertex_buffer_->GetBuffer(),
-          mesh_asset.index_buffer_->GetBuffer(), sizeof(Vertex),
-          &mesh_asset.blas_) != VK_SUCCESS) {
+int AssetManager::AcquireTexture(const Hash128 &content_hash) {
+  auto it = texture_ids_by_hash_.find(content_hash);
+  if (it == texture_ids_by_hash_.end()) {
     return -1;
   }
+  textures_[it->second].second->ref_count_++;
+  return it->second;
+}
 
-  uint32_t binding_mesh_id = meshes_.size();
-  meshes_[next_mesh_id_] = {binding_mesh_id,
-                            std::make_unique<MeshAsset>(std::move(mesh_asset))};
+int AssetManager::AcquireMesh(const Hash128 &content_hash) {
+  auto it = mesh_ids_by_hash_.find(content_hash);
+  // Hidden meshes are the primitive stand-ins, they are not handed out.
+  if (it == mesh_ids_by_hash_.end() || meshes_[it->second].second->hidden_) {
+    return -1;
+  }
+  meshes_[it->second].second->ref_count_++;
+  return it->second;
+}
 
-  return next_mesh_id_++;
+AccelerationStructure *AssetManager::RequestBlas(uint32_t id) {
+  auto it = meshes_.find(id);
+  if (it == meshes_.end()) {
+    return nullptr;
+  }
+  auto &mesh = *it->second.second;
+  if (!mesh.blas_ && !mesh.blas_queued_) {
+    mesh.blas_queued_ = true;
+    pending_blas_builds_.push_back(id);
+  }
+  return mesh.blas_.get();
+}
+
+void AssetManager::WaitBlasBuilds() {
+  BuildPendingBlases(true);
+}
+
+void AssetManager::BuildPendingBlases(bool wait) {
+  do {
+    if (blas_batch_ && !FinishBlasBatch(wait)) {
+      return;
+    }
+    SubmitBlasBatch();
+  } while (wait && blas_batch_);
+}
+
+void AssetManager::SubmitBlasBatch() {
+  auto &procedures = GetAccelerationStructureProcedures(core_);
+  VkDevice device = core_->Device()->Handle();
+  if (!blas_scratch_buffer_) {
+    blas_scratch_buffer_ = std::make_unique<ScratchBuffer>(core_);
+  }
+  const VkDeviceSize scratch_alignment = blas_scratch_buffer_->Alignment();
+
+  auto batch = std::make_unique<BlasBatch>();
+  // Reserved up front, the build infos point into these.
+  std::vector<VkAccelerationStructureGeometryKHR> geometries;
+  std::vector<VkAccelerationStructureBuildGeometryInfoKHR> build_infos;
+  std::vector<VkAccelerationStructureBuildRangeInfoKHR> ranges;
+  std::vector<VkDeviceSize> scratch_offsets;
+  geometries.reserve(pending_blas_builds_.size());
+  VkDeviceSize scratch_size = 0;
+  uint64_t num_triangles = 0;
+  while (!pending_blas_builds_.empty()) {
+    uint32_t mesh_id = pending_blas_builds_.front();
+    auto it = meshes_.find(mesh_id);
+    if (it == meshes_.end()) {
+      pending_blas_builds_.pop_front();
+      continue;
+    }
+    auto &mesh = *it->second.second;
+    const uint32_t mesh_triangles = mesh.num_indices_ / 3;
+    // The first mesh always goes in, however large it is.
+    if (!batch->mesh_ids.empty() &&
+        num_triangles + mesh_triangles > blas_build_budget_) {
+      break;
+    }
+    pending_blas_builds_.pop_front();
+
+    VkAccelerationStructureGeometryKHR geometry{};
+    geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+    geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+    geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+    auto &triangles = geometry.geometry.triangles;
+    triangles.sType =
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+    // Both vertex formats start with the position.
+    triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+    triangles.vertexData.deviceAddress =
+        GetBufferDeviceAddress(core_, mesh.vertex_buffer_->GetBuffer());
+    triangles.vertexStride = VertexStride(mesh.vertex_format_);
+    triangles.maxVertex = mesh.num_vertices_ - 1;
+    triangles.indexType = IndexType(mesh.index_format_);
+    triangles.indexData.deviceAddress =
+        GetBufferDeviceAddress(core_, mesh.index_buffer_->GetBuffer());
+
+    VkAccelerationStructureBuildGeometryInfoKHR build_info{};
+    build_info.sType =
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+    build_info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+    build_info.flags =
+        VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR |
+        VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+    build_info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    build_info.geometryCount = 1;
+    build_info.pGeometries = &geometry;
+
+    VkAccelerationStructureBuildSizesInfoKHR sizes{};
+    sizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+    procedures.vkGetAccelerationStructureBuildSizesKHR(
+        device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &build_info,
+        &mesh_triangles, &sizes);
+    std::unique_ptr<AccelerationStructure> blas;
+    if (AccelerationStructure::Create(
+            core_, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+            sizes.accelerationStructureSize, &blas)) {
+      LogWarning("Failed to build the BLAS of mesh {}", mesh.name_);
+      mesh.blas_queued_ = false;
+      continue;
+    }
+    build_info.dstAccelerationStructure = blas->Handle();
+
+    // The builds run concurrently, each gets its own part of the scratch.
+    scratch_offsets.push_back(scratch_size);
+    scratch_size += (sizes.buildScratchSize + scratch_alignment - 1) /
+                    scratch_alignment * scratch_alignment;
+    geometries.push_back(geometry);
+    build_infos.push_back(build_info);
+    VkAccelerationStructureBuildRangeInfoKHR range{};
+    range.primitiveCount = mesh_triangles;
+    ranges.push_back(range);
+    batch->mesh_ids.push_back(mesh_id);
+    batch->blases.push_back(std::move(blas));
+    num_triangles += mesh_triangles;
+  }
+  if (batch->mesh_ids.empty()) {
+    return;
+  }
+
+  // Only one batch is in flight, the previous one no longer uses the scratch.
+  if (blas_scratch_buffer_->Reserve(scratch_size)) {
+    LogWarning("Failed to allocate {} bytes of BLAS scratch memory",
+               scratch_size);
+    for (auto mesh_id : batch->mesh_ids) {
+      meshes_[mesh_id].second->blas_queued_ = false;
+    }
+    return;
+  }
+  std::vector<const VkAccelerationStructureBuildRangeInfoKHR *> range_ptrs;
+  for (size_t i = 0; i < build_infos.size(); i++) {
+    build_infos[i].pGeometries = &geometries[i];
+    build_infos[i].scratchData.deviceAddress =
+        blas_scratch_buffer_->DeviceAddress() + scratch_offsets[i];
+    range_ptrs.push_back(&ranges[i]);
+  }
+
+  VkQueryPoolCreateInfo query_pool_info{};
+  query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  query_pool_info.queryType =
+      VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+  query_pool_info.queryCount = build_infos.size();
+  vkCreateQueryPool(device, &query_pool_info, nullptr, &batch->query_pool);
+  std::vector<VkAccelerationStructureKHR> handles;
+  for (auto &blas : batch->blases) {
+    handles.push_back(blas->Handle());
+  }
+
+  // Recorded and submitted on their own, so that the builds overlap with
+  // rendering. The fence tells Update when they are done.
+  batch->cmd_buffer = BeginOneTimeCommands(device, blas_command_pool_);
+  vkCmdResetQueryPool(batch->cmd_buffer, batch->query_pool, 0,
+                      build_infos.size());
+  procedures.vkCmdBuildAccelerationStructuresKHR(
+      batch->cmd_buffer, build_infos.size(), build_infos.data(),
+      range_ptrs.data());
+  // The compacted sizes are only known once the builds have finished.
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+  barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+  vkCmdPipelineBarrier(batch->cmd_buffer,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+  procedures.vkCmdWriteAccelerationStructuresPropertiesKHR(
+      batch->cmd_buffer, handles.size(), handles.data(),
+      VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+      batch->query_pool, 0);
+
+  VkFenceCreateInfo fence_info{};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  vkCreateFence(device, &fence_info, nullptr, &batch->fence);
+  SubmitOneTimeCommands(blas_queue_, batch->cmd_buffer, batch->fence);
+  blas_batch_ = std::move(batch);
+}
+
+void AssetManager::CompactBlasBatch() {
+  auto &procedures = GetAccelerationStructureProcedures(core_);
+  VkDevice device = core_->Device()->Handle();
+  auto &batch = *blas_batch_;
+  std::vector<VkDeviceSize> compacted_sizes(batch.blases.size());
+  vkGetQueryPoolResults(device, batch.query_pool, 0, compacted_sizes.size(),
+                        compacted_sizes.size() * sizeof(VkDeviceSize),
+                        compacted_sizes.data(), sizeof(VkDeviceSize),
+                        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+  vkFreeCommandBuffers(device, blas_command_pool_->Handle(), 1,
+                       &batch.cmd_buffer);
+  vkResetFences(device, 1, &batch.fence);
+
+  const uint32_t build_family = blas_queue_->QueueFamilyIndex();
+  const uint32_t trace_family = core_->GraphicsQueue()->QueueFamilyIndex();
+  batch.compacted_blases.resize(batch.blases.size());
+  batch.cmd_buffer = BeginOneTimeCommands(device, blas_command_pool_);
+  for (size_t i = 0; i < batch.blases.size(); i++) {
+    // Meshes destroyed while their BLAS was being built need no copy.
+    if (meshes_.find(batch.mesh_ids[i]) == meshes_.end()) {
+      continue;
+    }
+    if (AccelerationStructure::Create(
+            core_, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+            compacted_sizes[i], &batch.compacted_blases[i])) {
+      batch.compacted_blases[i].reset();
+    } else {
+      VkCopyAccelerationStructureInfoKHR copy_info{};
+      copy_info.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+      copy_info.src = batch.blases[i]->Handle();
+      copy_info.dst = batch.compacted_blases[i]->Handle();
+      copy_info.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+      procedures.vkCmdCopyAccelerationStructureKHR(batch.cmd_buffer,
+                                                   &copy_info);
+    }
+    if (build_family != trace_family) {
+      RecordBlasOwnershipTransfer(batch.cmd_buffer,
+                                  batch.compacted_blases[i]
+                                      ? *batch.compacted_blases[i]
+                                      : *batch.blases[i],
+                                  build_family, trace_family, false);
+    }
+  }
+  SubmitOneTimeCommands(blas_queue_, batch.cmd_buffer, batch.fence);
+  batch.compacting = true;
+}
+
+bool AssetManager::FinishBlasBatch(bool wait) {
+  VkDevice device = core_->Device()->Handle();
+  if (!wait && vkGetFenceStatus(device, blas_batch_->fence) != VK_SUCCESS) {
+    return false;
+  }
+  vkWaitForFences(device, 1, &blas_batch_->fence, VK_TRUE, UINT64_MAX);
+  if (!blas_batch_->compacting) {
+    CompactBlasBatch();
+    return FinishBlasBatch(wait);
+  }
+  for (size_t i = 0; i < blas_batch_->mesh_ids.size(); i++) {
+    auto it = meshes_.find(blas_batch_->mesh_ids[i]);
+    // The mesh may have been destroyed while its BLAS was being built.
+    if (it == meshes_.end()) {
+      continue;
+    }
+    auto &mesh = *it->second.second;
+    // The builds are freed along with the batch, unless compacting failed.
+    auto &blas = blas_batch_->compacted_blases[i]
+                     ? blas_batch_->compacted_blases[i]
+                     : blas_batch_->blases[i];
+    mesh.blas_ = std::move(blas);
+    mesh.blas_queued_ = false;
+    num_built_blases_++;
+    if (blas_queue_->QueueFamilyIndex() !=
+        core_->GraphicsQueue()->QueueFamilyIndex()) {
+      blas_acquires_.push_back(blas_batch_->mesh_ids[i]);
+    }
+  }
+  vkFreeCommandBuffers(device, blas_command_pool_->Handle(), 1,
+                       &blas_batch_->cmd_buffer);
+  vkDestroyFence(device, blas_batch_->fence, nullptr);
+  vkDestroyQueryPool(device, blas_batch_->query_pool, nullptr);
+  blas_batch_.reset();
+  return true;
+}
+
+void AssetManager::DropBlasBatch() {
+  if (!blas_batch_) {
+    return;
+  }
+  VkDevice device = core_->Device()->Handle();
+  vkWaitForFences(device, 1, &blas_batch_->fence, VK_TRUE, UINT64_MAX);
+  for (auto mesh_id : blas_batch_->mesh_ids) {
+    auto it = meshes_.find(mesh_id);
+    if (it != meshes_.end()) {
+      it->second.second->blas_queued_ = false;
+    }
+  }
+  vkFreeCommandBuffers(device, blas_command_pool_->Handle(), 1,
+                       &blas_batch_->cmd_buffer);
+  vkDestroyFence(device, blas_batch_->fence, nullptr);
+  vkDestroyQueryPool(device, blas_batch_->query_pool, nullptr);
+  blas_batch_.reset();
+}
+
+void AssetManager::AcquireBlases(VkCommandBuffer cmd_buffer) {
+  for (auto mesh_id : blas_acquires_) {
+    auto it = meshes_.find(mesh_id);
+    if (it == meshes_.end() || !it->second.second->blas_) {
+      continue;
+    }
+    RecordBlasOwnershipTransfer(cmd_buffer, *it->second.second->blas_,
+                                blas_queue_->QueueFamilyIndex(),
+                                core_->GraphicsQueue()->QueueFamilyIndex(),
+                                true);
+  }
+  blas_acquires_.clear();
+}
+
+void AssetManager::WaitAsyncLoads() {
+  FinishAsyncLoads(true);
+}
+
+void AssetManager::FinishAsyncLoads(bool wait) {
+  // Loads finish in submission order when waiting, so that the ids do not
+  // depend on which worker was faster.
+  for (auto it = pending_loads_.begin(); it != pending_loads_.end();) {
+    if (!wait && it->prepared.wait_for(std::chrono::seconds(0)) !=
+                     std::future_status::ready) {
+      ++it;
+      continue;
+    }
+    it->result.set_value(it->prepared.get()());
+    it = pending_loads_.erase(it);
+  }
+}
+
+vulkan::StaticBuffer<uint32_t> *AssetManager::GetTextureImportanceBuffer(
+    uint32_t id) {
+  auto texture = GetTexture(id);
+  if (texture->importance_buffer_) {
+    return texture->importance_buffer_.get();
+  }
+
+  EnvmapImportance importance;
+  if (!texture->build_envmap_importance_ ||
+      texture->build_envmap_importance_(importance)) {
+    LogWarning("Failed to build the envmap importance of texture {}",
+               texture->name_);
+    importance.width = 1;
+    importance.height = 1;
+    importance.radiance = {1.0f};
+  }
+  texture->build_envmap_importance_ = nullptr;
+  std::vector<AliasEntry> table;
+  BuildEnvmapAliasTable(importance, table);
+  std::vector<uint32_t> words(2 + table.size() * (sizeof(AliasEntry) / 4));
+  words[0] = importance.width;
+  words[1] = importance.height;
+  std::memcpy(words.data() + 2, table.data(),
+              table.size() * sizeof(AliasEntry));
+  core_->CreateStaticBuffer<uint32_t>(words.size(),
+                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                      &texture->importance_buffer_);
+  texture->importance_buffer_->UploadContents(words.data(), words.size());
+  return texture->importance_buffer_.get();
+}
+
+vulkan::StaticBuffer<AliasEntry> *AssetManager::GetMeshAreaAliasBuffer(
+    uint32_t id) {
+  auto mesh = GetMesh(id);
+  if (mesh->area_alias_buffer_) {
+    return mesh->area_alias_buffer_.get();
+  }
+
+  // Meshes without area are never selected as emitters, a uniform table
+  // keeps the lookup valid.
+  std::vector<AliasEntry> table;
+  if (BuildAliasTable(mesh->triangle_areas_, table)) {
+    BuildAliasTable(std::vector<float>(mesh->triangle_areas_.size(), 1.0f),
+                    table);
+  }
+  if (table.empty()) {
+    return placeholder_alias_buffer_.get();
+  }
+  core_->CreateStaticBuffer<AliasEntry>(table.size(),
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                        &mesh->area_alias_buffer_);
+  mesh->area_alias_buffer_->UploadContents(table.data(), table.size());
+  return mesh->area_alias_buffer_.get();
+}
+
+const std::vector<glm::vec3> &AssetManager::GetMeshLightTriangles(
+    uint32_t id) {
+  auto mesh = GetMesh(id);
+  if (!mesh->light_triangles_.empty() ||
+      mesh->num_indices_ / 3 > kLightBvhMaxMeshTriangles) {
+    return mesh->light_triangles_;
+  }
+
+  // Both vertex formats start with the position.
+  const uint32_t vertex_stride = VertexStride(mesh->vertex_format_) / 4;
+  std::vector<uint32_t> vertex_words(mesh->num_vertices_ * vertex_stride);
+  mesh->vertex_buffer_->DownloadContents(vertex_words.data(),
+                                         vertex_words.size());
+  const bool uint16_indices = mesh->index_format_ == IndexFormat::Uint16;
+  std::vector<uint32_t> index_words(
+      uint16_indices ? (mesh->num_indices_ + 1) / 2 : mesh->num_indices_);
+  mesh->index_buffer_->DownloadContents(index_words.data(),
+                                        index_words.size());
+
+  mesh->light_triangles_.resize(mesh->num_indices_);
+  for (uint32_t i = 0; i < mesh->num_indices_; i++) {
+    uint32_t index = uint16_indices
+                         ? (index_words[i / 2] >> (i % 2 * 16)) & 0xffffu
+                         : index_words[i];
+    std::memcpy(&mesh->light_triangles_[i],
+                vertex_words.data() + size_t(index) * vertex_stride,
+                sizeof(glm::vec3));
+  }
+  return mesh->light_triangles_;
 }
 
 void AssetManager::DestroyTexture(uint32_t id) {
-  textures_.erase(id);
+  auto it = textures_.find(id);
+  if (it == textures_.end() || --it->second.second->ref_count_) {
+    return;
+  }
+  texture_ids_by_hash_.erase(it->second.second->content_hash_);
+  textures_.erase(it);
 }
 
 void AssetManager::DestroyMesh(uint32_t id) {
+  if (meshes_.find(id) == meshes_.end() ||
+      --meshes_[id].second->ref_count_) {
+    return;
+  }
+  // Builds in flight may read the geometry of the mesh or its levels, the
+  // compaction copies only read the builds.
+  if (blas_batch_ && !blas_batch_->compacting) {
+    auto &batch_ids = blas_batch_->mesh_ids;
+    auto in_batch = [&](uint32_t mesh_id) {
+      return std::find(batch_ids.begin(), batch_ids.end(), mesh_id) !=
+             batch_ids.end();
+    };
+    const auto &lod_mesh_ids = meshes_[id].second->lod_mesh_ids_;
+    if (in_batch(id) ||
+        std::any_of(lod_mesh_ids.begin(), lod_mesh_ids.end(), in_batch)) {
+      vkWaitForFences(core_->Device()->Handle(), 1, &blas_batch_->fence,
+                      VK_TRUE, UINT64_MAX);
+    }
+  }
+  for (auto lod_mesh_id : meshes_[id].second->lod_mesh_ids_) {
+    meshes_.erase(lod_mesh_id);
+  }
+  mesh_ids_by_hash_.erase(meshes_[id].second->content_hash_);
   meshes_.erase(id);
 }
 
@@ -223,7 +1226,15 @@ void AssetManager::ImGui() {
 
     ImGui::SeparatorText("Meshes");
     for (const auto &[id, mesh] : meshes_) {
-      ImGui::Text("%s", mesh.second->name_.c_str());
+      if (mesh.second->hidden_) {
+        continue;
+      }
+      if (mesh.second->lod_mesh_ids_.empty()) {
+        ImGui::Text("%s", mesh.second->name_.c_str());
+      } else {
+        ImGui::Text("%s (%d LODs)", mesh.second->name_.c_str(),
+                    int(mesh.second->lod_mesh_ids_.size()));
+      }
     }
   }
   ImGui::End();
@@ -256,7 +1267,8 @@ std::set<uint32_t> AssetManager::GetTextureIds() {
   uint32_t binding_texture_ids = 0;
   for (auto &[id, texture] : textures_) {
     ids.insert(id);
-    texture.first = binding_texture_ids++;
+    texture.first = binding_texture_ids;
+    binding_texture_ids += texture.second->num_binding_slots_;
   }
   return ids;
 }
@@ -276,12 +1288,26 @@ void AssetManager::UpdateMeshDataBindings(uint32_t frame_id) {
 
   std::vector<const vulkan::Buffer *> vertex_buffers;
   std::vector<const vulkan::Buffer *> index_buffers;
-  std::vector<const vulkan::Buffer *> area_cdf_buffers;
+  std::vector<const vulkan::Buffer *> area_alias_buffers;
+  // Written at the binding index, which differs from the mesh id once
+  // meshes have been destroyed.
+  auto write_metadata = [this](uint32_t binding_id, const MeshAsset *mesh) {
+    MeshMetadata metadata{};
+    metadata.num_vertex = mesh->num_vertices_;
+    metadata.num_index = mesh->num_indices_;
+    metadata.vertex_format = uint32_t(mesh->vertex_format_);
+    metadata.index_format = uint32_t(mesh->index_format_);
+    mesh_metadata_buffer_->At(binding_id) = metadata;
+  };
   for (auto mesh_id : GetMeshIds()) {
     auto mesh = GetMesh(mesh_id);
+    write_metadata(GetMeshBindingId(mesh_id), mesh);
     vertex_buffers.push_back(mesh->vertex_buffer_->GetBuffer(frame_id));
     index_buffers.push_back(mesh->index_buffer_->GetBuffer(frame_id));
-    area_cdf_buffers.push_back(mesh->area_cdf_buffer_->GetBuffer(frame_id));
+    auto area_alias_buffer = mesh->area_alias_buffer_
+                                 ? mesh->area_alias_buffer_.get()
+                                 : placeholder_alias_buffer_.get();
+    area_alias_buffers.push_back(area_alias_buffer->GetBuffer(frame_id));
   }
 
   uint32_t last_frame_bound_mesh_num = last_frame_bound_mesh_num_[frame_id];
@@ -289,31 +1315,30 @@ void AssetManager::UpdateMeshDataBindings(uint32_t frame_id) {
   if (last_frame_bound_mesh_num != vertex_buffers.size()) {
     while (vertex_buffers.size() < last_frame_bound_mesh_num ||
            index_buffers.size() < last_frame_bound_mesh_num ||
-           area_cdf_buffers.size() < last_frame_bound_mesh_num) {
+           area_alias_buffers.size() < last_frame_bound_mesh_num) {
       auto mesh = GetMesh(0);
+      write_metadata(vertex_buffers.size(), mesh);
       vertex_buffers.push_back(mesh->vertex_buffer_->GetBuffer(frame_id));
       index_buffers.push_back(mesh->index_buffer_->GetBuffer(frame_id));
-      area_cdf_buffers.push_back(mesh->area_cdf_buffer_->GetBuffer(frame_id));
+      area_alias_buffers.push_back(
+          placeholder_alias_buffer_->GetBuffer(frame_id));
     }
   }
 
   descriptor_set->BindStorageBuffers(0, vertex_buffers);
   descriptor_set->BindStorageBuffers(1, index_buffers);
-  descriptor_set->BindStorageBuffers(2, area_cdf_buffers);
-
-  for (int i = 0; i < vertex_buffers.size(); i++) {
-    MeshMetadata metadata;
-    metadata.num_vertex = GetMesh(i)->vertex_buffer_->Length();
-    metadata.num_index = GetMesh(i)->index_buffer_->Length();
-    mesh_metadata_buffer_->At(i) = metadata;
-  }
+  descriptor_set->BindStorageBuffers(2, area_alias_buffers);
 }
 
 void AssetManager::UpdateTextureBindings(uint32_t frame_id) {
   std::vector<const vulkan::Image *> images;
   for (auto texture_id : GetTextureIds()) {
     auto texture = GetTexture(texture_id);
+    texture_level_buffer_->At(images.size()) = texture->num_binding_slots_;
     images.push_back(texture->image_.get());
+    for (auto &mip_image : texture->mip_images_) {
+      images.push_back(mip_image.get());
+    }
   }
 
   uint32_t last_frame_bound_texture_num =
@@ -331,6 +1356,8 @@ void AssetManager::UpdateTextureBindings(uint32_t frame_id) {
 }
 
 void AssetManager::Update(uint32_t frame_id) {
+  FinishAsyncLoads(false);
+  BuildPendingBlases(false);
   UpdateMeshDataBindings(frame_id);
   UpdateTextureBindings(frame_id);
 }
@@ -361,6 +1388,9 @@ bool AssetManager::ComboForMeshSelection(const char *label, uint32_t *id) {
   std::vector<uint32_t> item_ids;
   int current_selection = 0;
   for (auto &[item_id, item] : meshes_) {
+    if (item.second->hidden_) {
+      continue;
+    }
     items.push_back(item.second->name_.c_str());
     item_ids.push_back(item_id);
     if (item_id == *id) {
@@ -377,11 +1407,19 @@ bool AssetManager::ComboForMeshSelection(const char *label, uint32_t *id) {
 
 void AssetManager::SyncData(VkCommandBuffer cmd_buffer, int frame_id) {
   mesh_metadata_buffer_->SyncData(cmd_buffer, frame_id);
+  texture_level_buffer_->SyncData(cmd_buffer, frame_id);
 }
 
 void AssetManager::Clear() {
+  // Loads issued for the previous scene must not land in the next one.
+  FinishAsyncLoads(true);
+  DropBlasBatch();
   next_mesh_id_ = 0;
   next_texture_id_ = 0;
+  texture_ids_by_hash_.clear();
+  mesh_ids_by_hash_.clear();
+  pending_blas_builds_.clear();
+  blas_acquires_.clear();
   textures_.clear();
   meshes_.clear();
   last_frame_bound_texture_num_ =
@@ -11,14 +11,125 @@ class AssetManager {
 
   ~AssetManager();
 
-  int LoadTexture(const Texture &texture, std::string name = "Unnamed Texture");
+  // The LoadTexture and LoadMesh overloads return the id of the asset, or -1
+  // on failure. Content that is loaded already, compared by a 128-bit hash of
+  // the texels or the vertices and indices together with the settings, returns
+  // the existing asset instead of creating another one. The asset keeps a
+  // reference count and DestroyTexture and DestroyMesh only release it with
+  // the last reference.
+  int LoadTexture(const Texture &texture,
+                  std::string name = "Unnamed Texture",
+                  const TextureAssetSettings &settings = {});
 
-  int LoadMesh(const Mesh &mesh, std::string name = "Unnamed Mesh");
+  // Streams the file into the texture format without keeping a float copy of
+  // the whole image, see EncodeTextureStream. Use Texture::LoadFromFile and
+  // the overload above if the pixels are needed on the host as well. Files
+  // baked by BakeTextureFile (.ktx2) are uploaded as they are, the settings
+  // and ldr_color_space do not apply to them.
+  int LoadTexture(const std::string &file_path,
+                  LDRColorSpace ldr_color_space,
+                  std::string name = "Unnamed Texture",
+                  const TextureAssetSettings &settings = {});
+
+  // Offline counterpart of the overload above: stores the levels it would
+  // upload, and the envmap importance, in a KTX2 file at ktx2_path.
+  static int BakeTextureFile(const std::string &file_path,
+                             LDRColorSpace ldr_color_space,
+                             const TextureAssetSettings &settings,
+                             const std::string &ktx2_path);
+
+  int LoadMesh(const Mesh &mesh,
+               std::string name = "Unnamed Mesh",
+               const MeshAssetSettings &settings = {});
+
+  // Loads a mesh together with precomputed LOD levels, finest first. The
+  // lod_settings are ignored.
+  int LoadMesh(const Mesh &mesh,
+               const std::vector<MeshLod> &lods,
+               std::string name = "Unnamed Mesh",
+               const MeshAssetSettings &settings = {});
+
+  // Asynchronous loading: load runs on the asset worker threads together with
+  // the processing LoadTexture and LoadMesh would do (mip chains, block
+  // compression, LODs). The GPU upload and the registration happen on the
+  // render thread in Update or WaitAsyncLoads, which fulfil the returned
+  // future with the asset id, or -1 on failure. Never block on such a future
+  // from the render thread before calling WaitAsyncLoads.
+  std::shared_future<int> LoadTextureAsync(
+      std::function<int(Texture &)> load,
+      std::string name = "Unnamed Texture",
+      const TextureAssetSettings &settings = {});
+
+  std::shared_future<int> LoadTextureAsync(
+      std::string file_path,
+      LDRColorSpace ldr_color_space,
+      std::string name = "Unnamed Texture",
+      const TextureAssetSettings &settings = {});
+
+  std::shared_future<int> LoadMeshAsync(std::function<int(Mesh &)> load,
+                                        std::string name = "Unnamed Mesh",
+                                        const MeshAssetSettings &settings = {});
+
+  // Uploads every pending asynchronous load, waiting for the worker threads
+  // where needed.
+  void WaitAsyncLoads();
+
+  // BLAS of the mesh, null until it is built and compacted. BLASes are built
+  // only for the meshes ray tracing asks for, LOD levels that are never
+  // selected and the primitive stand-ins never get one.
+  AccelerationStructure *RequestBlas(uint32_t id);
+
+  // Update submits the requested BLASes in request order as one batch on the
+  // transfer queue, adding meshes while their triangles fit the budget (the
+  // first always does). The next batch follows once the device has finished
+  // the previous one, so that scenes with many meshes load without freezing
+  // the viewport.
+  void SetBlasBuildBudget(uint32_t triangles) {
+    blas_build_budget_ = triangles;
+  }
+
+  uint32_t GetBlasBuildBudget() const {
+    return blas_build_budget_;
+  }
+
+  // Builds every requested BLAS.
+  void WaitBlasBuilds();
+
+  // Number of BLASes built so far, grows whenever the ray traced geometry
+  // did.
+  uint64_t NumBuiltBlases() const {
+    return num_built_blases_;
+  }
+
+  // Workers for the asynchronous loads, scene loaders may queue their own
+  // processing here.
+  ThreadPool *LoadThreadPool() {
+    return load_thread_pool_.get();
+  }
 
   TextureAsset *GetTexture(uint32_t id);
 
   MeshAsset *GetMesh(uint32_t id);
 
+  // Hidden mesh the raster preview draws for an analytic primitive.
+  uint32_t GetPrimitiveMeshId(PrimitiveType type) const {
+    return primitive_mesh_ids_[uint32_t(type)];
+  }
+
+  // Derived data below is built the first time it is requested and shared
+  // afterwards.
+
+  // Envmap sampling data of the texture.
+  vulkan::StaticBuffer<uint32_t> *GetTextureImportanceBuffer(uint32_t id);
+
+  // Area alias table of the mesh, needed once the mesh emits light.
+  vulkan::StaticBuffer<AliasEntry> *GetMeshAreaAliasBuffer(uint32_t id);
+
+  // Triangle corners of the mesh for the light BVH, read back from its
+  // buffers. Empty for meshes with more than kLightBvhMaxMeshTriangles
+  // triangles.
+  const std::vector<glm::vec3> &GetMeshLightTriangles(uint32_t id);
+
   uint32_t GetTextureBindingId(uint32_t id);
 
   uint32_t GetMeshBindingId(uint32_t id);
@@ -53,6 +164,11 @@ class AssetManager {
 
   void SyncData(VkCommandBuffer cmd_buffer, int frame_id);
 
+  // Records the queue family ownership transfers of the BLASes built since
+  // the last call, if they were built on another queue family. Must precede
+  // any use of them in the graphics command buffer.
+  void AcquireBlases(VkCommandBuffer cmd_buffer);
+
   void Clear();
 
  private:
@@ -62,10 +178,69 @@ class AssetManager {
   void DestroyDefaultAssets();
   void DestroyDescriptorObjects();
 
+  // Registers the mesh under content_hash, LoadMesh found no duplicate.
+  int CreateMeshWithLods(const Mesh &mesh,
+                         const std::vector<MeshLod> &lods,
+                         std::string name,
+                         const MeshAssetSettings &settings,
+                         const Hash128 &content_hash);
+
+  int CreateMeshAsset(const Mesh &mesh,
+                      std::string name,
+                      const MeshAssetSettings &settings);
+
+  // Host half of LoadTexture, safe to run on any thread. Compressed formats
+  // whose bit is clear in sampled_formats are replaced by the uncompressed
+  // source format.
+  static void PrepareTextureUpload(const Texture &texture,
+                                   const TextureAssetSettings &settings,
+                                   uint32_t sampled_formats,
+                                   TextureUpload &upload);
+
+  static int PrepareTextureUpload(const std::string &file_path,
+                                  LDRColorSpace ldr_color_space,
+                                  const TextureAssetSettings &settings,
+                                  uint32_t sampled_formats,
+                                  TextureUpload &upload);
+
+  // Render thread half of LoadTexture.
+  int CreateTextureAsset(TextureUpload &upload, std::string name);
+
+  // Id of the loaded asset with this content after taking another reference
+  // on it, -1 if there is none.
+  int AcquireTexture(const Hash128 &content_hash);
+  int AcquireMesh(const Hash128 &content_hash);
+
+  // Uploads the pending loads whose worker part is done, or all of them if
+  // wait is set.
+  void FinishAsyncLoads(bool wait);
+
+  // Hands the finished batch to its meshes and submits the next one, or
+  // builds all queued BLASes if wait is set.
+  void BuildPendingBlases(bool wait);
+
+  // Submits the queued BLASes that fit the budget, if any.
+  void SubmitBlasBatch();
+
+  // Moves the BLASes of the batch in flight to their meshes once the device
+  // has built and compacted them. Returns false if it is still running and
+  // wait is not set.
+  bool FinishBlasBatch(bool wait);
+
+  // Copies the built BLASes of the batch into right-sized ones, submitted
+  // behind the same fence.
+  void CompactBlasBatch();
+
+  // Waits for the batch in flight, if any, and throws its BLASes away
+  // without compacting them. For teardown, where nothing will trace them.
+  void DropBlasBatch();
+
   void UpdateMeshDataBindings(uint32_t frame_id);
   void UpdateTextureBindings(uint32_t frame_id);
 
   vulkan::Core *core_;
+  // Bit i is set if the device samples TextureFormat(i) images.
+  uint32_t sampled_formats_{};
   uint32_t next_mesh_id_{};
   uint32_t next_texture_id_{};
 
@@ -75,7 +250,14 @@ class AssetManager {
   std::map<uint32_t, std::pair<uint32_t, std::unique_ptr<TextureAsset>>>
       textures_;
   std::map<uint32_t, std::pair<uint32_t, std::unique_ptr<MeshAsset>>> meshes_;
+  std::map<Hash128, uint32_t> texture_ids_by_hash_;
+  std::map<Hash128, uint32_t> mesh_ids_by_hash_;
+  std::vector<uint32_t> primitive_mesh_ids_;
   std::unique_ptr<vulkan::DynamicBuffer<MeshMetadata>> mesh_metadata_buffer_;
+  // Number of levels of the texture bound at each first slot.
+  std::unique_ptr<vulkan::DynamicBuffer<uint32_t>> texture_level_buffer_;
+  // Bound in place of area alias tables that were never requested.
+  std::unique_ptr<vulkan::StaticBuffer<AliasEntry>> placeholder_alias_buffer_;
 
   std::unique_ptr<vulkan::DescriptorSetLayout> descriptor_set_layout_;
   std::unique_ptr<vulkan::DescriptorPool> descriptor_pool_;
@@ -89,5 +271,40 @@ class AssetManager {
 
   uint32_t max_textures_{};
   uint32_t max_meshes_{};
+
+  struct PendingLoad {
+    // Produced by the worker thread, finishes the load on the render thread.
+    std::future<std::function<int()>> prepared;
+    std::promise<int> result;
+  };
+  std::vector<PendingLoad> pending_loads_;
+  std::unique_ptr<ThreadPool> load_thread_pool_;
+
+  // Mesh ids waiting for their BLAS, oldest request first.
+  std::deque<uint32_t> pending_blas_builds_;
+  uint32_t blas_build_budget_{1u << 20};
+  uint64_t num_built_blases_{};
+
+  // BLAS builds recorded into one command buffer and submitted together,
+  // followed by the copies compacting them.
+  struct BlasBatch {
+    std::vector<uint32_t> mesh_ids;
+    std::vector<std::unique_ptr<AccelerationStructure>> blases;
+    // Null where the build is handed out as is.
+    std::vector<std::unique_ptr<AccelerationStructure>> compacted_blases;
+    bool compacting{false};
+    // Compacted sizes of the builds, one query each.
+    VkQueryPool query_pool{VK_NULL_HANDLE};
+    VkCommandBuffer cmd_buffer{VK_NULL_HANDLE};
+    VkFence fence{VK_NULL_HANDLE};
+  };
+  std::unique_ptr<BlasBatch> blas_batch_;
+  // Shared by all batches, only one is in flight at a time.
+  std::unique_ptr<ScratchBuffer> blas_scratch_buffer_;
+  // Compute capable queue the batches run on, and the pool of its family.
+  vulkan::Queue *blas_queue_{};
+  vulkan::CommandPool *blas_command_pool_{};
+  // Meshes whose BLAS the graphics queue family still has to acquire.
+  std::vector<uint32_t> blas_acquires_;
 };
 }  // namespace sparks
@@ -0,0 +1,27 @@
+#include "sparks/asset_manager/index_format.h"
+
+namespace sparks {
+
+IndexFormat SelectIndexFormat(size_t num_vertices) {
+  if (num_vertices <= 0x10000) {
+    return IndexFormat::Uint16;
+  }
+  return IndexFormat::Uint32;
+}
+
+VkIndexType IndexType(IndexFormat format) {
+  if (format == IndexFormat::Uint16) {
+    return VK_INDEX_TYPE_UINT16;
+  }
+  return VK_INDEX_TYPE_UINT32;
+}
+
+void PackIndices16(const std::vector<uint32_t> &indices,
+                   std::vector<uint32_t> &words) {
+  words.assign((indices.size() + 1) / 2, 0);
+  for (size_t i = 0; i < indices.size(); i++) {
+    words[i / 2] |= (indices[i] & 0xffffu) << ((i & 1) * 16);
+  }
+}
+
+}  // namespace sparks
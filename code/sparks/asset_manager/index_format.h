@@ -0,0 +1,19 @@
+#pragma once
+#include "sparks/asset_manager/asset_manager_utils.h"
+
+namespace sparks {
+
+// Element type of the index buffer of a mesh asset. Uint16 indices are packed
+// two per 32-bit word, the low half holding the even index.
+enum class IndexFormat : uint32_t { Uint32 = 0, Uint16 = 1 };
+
+IndexFormat SelectIndexFormat(size_t num_vertices);
+
+VkIndexType IndexType(IndexFormat format);
+
+// Packs indices as 16-bit values, the last word is padded with zero if the
+// number of indices is odd.
+void PackIndices16(const std::vector<uint32_t> &indices,
+                   std::vector<uint32_t> &words);
+
+}  // namespace sparks
@@ -0,0 +1,415 @@
+#include "sparks/asset_manager/ktx2_file.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace sparks {
+
+namespace {
+
+constexpr uint8_t kKtx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                                         0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+constexpr char kWriterKey[] = "KTXwriter";
+constexpr char kWriterValue[] = "Sparks";
+// Keys without the reserved KTX prefix belong to the application.
+constexpr char kEnvmapImportanceKey[] = "SparksEnvmapImportance";
+
+struct Ktx2Header {
+  uint8_t identifier[12];
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+  uint32_t dfd_byte_offset;
+  uint32_t dfd_byte_length;
+  uint32_t kvd_byte_offset;
+  uint32_t kvd_byte_length;
+  uint64_t sgd_byte_offset;
+  uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+struct Ktx2LevelIndex {
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  uint64_t uncompressed_byte_length;
+};
+
+// Formats a KTX2 file may hold, everything TextureVkFormat maps to.
+constexpr TextureFormat kKtx2Formats[] = {
+    TextureFormat::RGBA8Unorm,  TextureFormat::RGBA8Srgb,
+    TextureFormat::RGBA16Unorm, TextureFormat::RGBA16Float,
+    TextureFormat::RGB9E5Float, TextureFormat::RGBA32Float,
+    TextureFormat::R8Unorm,     TextureFormat::R16Unorm,
+    TextureFormat::BC1Unorm,    TextureFormat::BC1Srgb,
+    TextureFormat::BC4Unorm,    TextureFormat::BC5Unorm,
+    TextureFormat::BC6HUfloat,  TextureFormat::BC7Unorm,
+    TextureFormat::BC7Srgb};
+
+int FindTextureFormat(uint32_t vk_format, TextureFormat &format) {
+  for (auto candidate : kKtx2Formats) {
+    if (uint32_t(TextureVkFormat(candidate)) == vk_format) {
+      format = candidate;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+// Bytes of a texel, or of a 4x4 block for compressed formats.
+uint32_t BlockSize(TextureFormat format) {
+  return IsBlockCompressed(format) ? CompressedBlockSize(format)
+                                   : TexelSize(format);
+}
+
+size_t LevelByteSize(TextureFormat format, uint32_t width, uint32_t height) {
+  if (IsBlockCompressed(format)) {
+    return size_t((width + 3) / 4) * ((height + 3) / 4) *
+           CompressedBlockSize(format);
+  }
+  return size_t(width) * height * TexelSize(format);
+}
+
+// Size of the data type the texels are made of, 1 for compressed formats.
+uint32_t TypeSize(TextureFormat format) {
+  switch (format) {
+    case TextureFormat::RGBA16Unorm:
+    case TextureFormat::RGBA16Float:
+    case TextureFormat::R16Unorm:
+      return 2;
+    case TextureFormat::RGB9E5Float:
+    case TextureFormat::RGBA32Float:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Khronos data format descriptor constants, see the KTX2 specification.
+constexpr uint8_t kModelRGBSDA = 1;
+constexpr uint8_t kModelBC1A = 128;
+constexpr uint8_t kModelBC4 = 131;
+constexpr uint8_t kModelBC5 = 132;
+constexpr uint8_t kModelBC6H = 133;
+constexpr uint8_t kModelBC7 = 134;
+constexpr uint8_t kPrimariesBT709 = 1;
+constexpr uint8_t kTransferLinear = 1;
+constexpr uint8_t kTransferSrgb = 2;
+constexpr uint8_t kChannelAlpha = 15;
+constexpr uint8_t kSampleLinear = 0x10;
+constexpr uint8_t kSampleExponent = 0x20;
+constexpr uint8_t kSampleSigned = 0x40;
+constexpr uint8_t kSampleFloat = 0x80;
+constexpr uint32_t kFloatMinusOne = 0xBF800000u;
+constexpr uint32_t kFloatOne = 0x3F800000u;
+constexpr uint32_t kFloatInfinity = 0x7F800000u;
+
+struct DfdSample {
+  uint32_t bit_offset;
+  uint32_t bit_length;
+  uint8_t channel;
+  uint32_t lower;
+  uint32_t upper;
+};
+
+// Basic data format descriptor of the format, prefixed by its total size.
+std::vector<uint32_t> BuildDfd(TextureFormat format) {
+  uint8_t model = kModelRGBSDA;
+  uint8_t transfer = kTransferLinear;
+  std::vector<DfdSample> samples;
+  auto add_channels = [&](uint32_t num_channels, uint32_t bits, uint8_t flags,
+                          uint32_t lower, uint32_t upper) {
+    const uint8_t channels[] = {0, 1, 2, kChannelAlpha};
+    for (uint32_t c = 0; c < num_channels; c++) {
+      samples.push_back({c * bits, bits, uint8_t(channels[c] | flags), lower,
+                         upper});
+    }
+  };
+  switch (format) {
+    case TextureFormat::RGBA8Unorm:
+      add_channels(4, 8, 0, 0, 255);
+      break;
+    case TextureFormat::RGBA8Srgb:
+      transfer = kTransferSrgb;
+      add_channels(4, 8, 0, 0, 255);
+      samples[3].channel |= kSampleLinear;
+      break;
+    case TextureFormat::RGBA16Unorm:
+      add_channels(4, 16, 0, 0, 65535);
+      break;
+    case TextureFormat::RGBA16Float:
+      add_channels(4, 16, kSampleFloat | kSampleSigned, kFloatMinusOne,
+                   kFloatOne);
+      break;
+    case TextureFormat::RGBA32Float:
+      add_channels(4, 32, kSampleFloat | kSampleSigned, kFloatMinusOne,
+                   kFloatOne);
+      break;
+    case TextureFormat::R8Unorm:
+      add_channels(1, 8, 0, 0, 255);
+      break;
+    case TextureFormat::R16Unorm:
+      add_channels(1, 16, 0, 0, 65535);
+      break;
+    case TextureFormat::RGB9E5Float:
+      // A 9-bit mantissa per channel, all sharing the exponent in bits 27-31.
+      for (uint8_t c = 0; c < 3; c++) {
+        samples.push_back({c * 9u, 9, c, 0, 8448});
+        samples.push_back({27, 5, uint8_t(c | kSampleExponent), 15, 31});
+      }
+      break;
+    case TextureFormat::BC1Unorm:
+    case TextureFormat::BC1Srgb:
+      model = kModelBC1A;
+      transfer = format == TextureFormat::BC1Srgb ? kTransferSrgb
+                                                  : kTransferLinear;
+      samples.push_back({0, 64, 0, 0, 0xFFFFFFFFu});
+      break;
+    case TextureFormat::BC4Unorm:
+      model = kModelBC4;
+      samples.push_back({0, 64, 0, 0, 0xFFFFFFFFu});
+      break;
+    case TextureFormat::BC5Unorm:
+      model = kModelBC5;
+      samples.push_back({0, 64, 0, 0, 0xFFFFFFFFu});
+      samples.push_back({64, 64, 1, 0, 0xFFFFFFFFu});
+      break;
+    case TextureFormat::BC6HUfloat:
+      model = kModelBC6H;
+      samples.push_back({0, 128, kSampleFloat, kFloatMinusOne, kFloatInfinity});
+      break;
+    case TextureFormat::BC7Unorm:
+    case TextureFormat::BC7Srgb:
+      model = kModelBC7;
+      transfer = format == TextureFormat::BC7Srgb ? kTransferSrgb
+                                                  : kTransferLinear;
+      samples.push_back({0, 128, 0, 0, 0xFFFFFFFFu});
+      break;
+    default:
+      break;
+  }
+
+  const uint32_t block_dimension = IsBlockCompressed(format) ? 3 : 0;
+  const uint32_t block_size = 24 + 16 * samples.size();
+  std::vector<uint32_t> words;
+  words.push_back(4 + block_size);
+  // Vendor Khronos, basic descriptor type.
+  words.push_back(0);
+  // Version 1.3 of the data format specification.
+  words.push_back(2 | (block_size << 16));
+  words.push_back(model | (kPrimariesBT709 << 8) | (transfer << 16));
+  words.push_back(block_dimension | (block_dimension << 8));
+  words.push_back(BlockSize(format));
+  words.push_back(0);
+  for (auto &sample : samples) {
+    words.push_back(sample.bit_offset | ((sample.bit_length - 1) << 16) |
+                    (uint32_t(sample.channel) << 24));
+    words.push_back(0);
+    words.push_back(sample.lower);
+    words.push_back(sample.upper);
+  }
+  return words;
+}
+
+void AppendKeyValue(std::vector<uint8_t> &kvd,
+                    const char *key,
+                    const void *value,
+                    size_t value_size) {
+  const uint32_t length = std::strlen(key) + 1 + value_size;
+  const size_t offset = kvd.size();
+  kvd.resize(AlignUp(offset + 4 + length, 4));
+  std::memcpy(kvd.data() + offset, &length, 4);
+  std::memcpy(kvd.data() + offset + 4, key, std::strlen(key) + 1);
+  std::memcpy(kvd.data() + offset + 4 + std::strlen(key) + 1, value,
+              value_size);
+}
+}  // namespace
+
+int Ktx2File::Open(const std::string &path) {
+  levels_.clear();
+  importance_offset_ = 0;
+  importance_size_ = 0;
+  if (file_.Open(path)) {
+    return -1;
+  }
+  const char *data = file_.Data();
+  const size_t size = file_.Size();
+
+  Ktx2Header header{};
+  if (size < sizeof(header)) {
+    LogWarning("Truncated KTX2 file: {}", path);
+    return -1;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.identifier, kKtx2Identifier,
+                  sizeof(kKtx2Identifier))) {
+    LogWarning("Not a KTX2 file: {}", path);
+    return -1;
+  }
+  if (FindTextureFormat(header.vk_format, format_)) {
+    LogWarning("Unsupported KTX2 format {}: {}", header.vk_format, path);
+    return -1;
+  }
+  if (!header.pixel_width || !header.pixel_height || header.pixel_depth ||
+      header.layer_count > 1 || header.face_count != 1) {
+    LogWarning("Only 2D KTX2 textures are supported: {}", path);
+    return -1;
+  }
+  if (header.supercompression_scheme) {
+    LogWarning("Supercompressed KTX2 files are not supported: {}", path);
+    return -1;
+  }
+  width_ = header.pixel_width;
+  height_ = header.pixel_height;
+  const uint32_t num_levels = std::max(header.level_count, 1u);
+  if (num_levels != NumMipLevels(width_, height_)) {
+    LogWarning("KTX2 texture needs a full mip chain: {}", path);
+    return -1;
+  }
+
+  if (sizeof(header) + num_levels * sizeof(Ktx2LevelIndex) > size) {
+    LogWarning("Truncated KTX2 file: {}", path);
+    return -1;
+  }
+  for (uint32_t i = 0; i < num_levels; i++) {
+    Ktx2LevelIndex index{};
+    std::memcpy(&index, data + sizeof(header) + i * sizeof(index),
+                sizeof(index));
+    const size_t expected_size =
+        LevelByteSize(format_, std::max(width_ >> i, 1u),
+                      std::max(height_ >> i, 1u));
+    if (index.byte_length != expected_size ||
+        index.byte_offset + index.byte_length > size) {
+      LogWarning("Malformed level {} in KTX2 file: {}", i, path);
+      levels_.clear();
+      return -1;
+    }
+    levels_.emplace_back(index.byte_offset, index.byte_length);
+  }
+
+  // Entries are a length, a null terminated key and the value, each padded
+  // to 4 bytes.
+  if (size_t(header.kvd_byte_offset) + header.kvd_byte_length <= size) {
+    size_t offset = header.kvd_byte_offset;
+    const size_t end = offset + header.kvd_byte_length;
+    while (offset + 4 <= end) {
+      uint32_t length = 0;
+      std::memcpy(&length, data + offset, 4);
+      const char *entry = data + offset + 4;
+      if (offset + 4 + length > end) {
+        break;
+      }
+      size_t key_length = strnlen(entry, length);
+      if (key_length < length &&
+          !std::strcmp(entry, kEnvmapImportanceKey)) {
+        importance_offset_ = offset + 4 + key_length + 1;
+        importance_size_ = length - key_length - 1;
+      }
+      offset = AlignUp(offset + 4 + length, 4);
+    }
+  }
+  return 0;
+}
+
+int Ktx2File::ReadEnvmapImportance(EnvmapImportance &importance) const {
+  if (importance_size_ < 8) {
+    return -1;
+  }
+  const char *value = file_.Data() + importance_offset_;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::memcpy(&width, value, 4);
+  std::memcpy(&height, value + 4, 4);
+  if (importance_size_ != 8 + size_t(width) * height * sizeof(float)) {
+    return -1;
+  }
+  importance.width = width;
+  importance.height = height;
+  importance.radiance.resize(size_t(width) * height);
+  std::memcpy(importance.radiance.data(), value + 8,
+              importance.radiance.size() * sizeof(float));
+  return 0;
+}
+
+int SaveKtx2File(const std::string &path,
+                 TextureFormat format,
+                 uint32_t width,
+                 uint32_t height,
+                 const std::vector<std::vector<uint8_t>> &levels,
+                 const EnvmapImportance *envmap_importance) {
+  std::vector<uint32_t> dfd = BuildDfd(format);
+
+  // Keys are sorted by their bytes.
+  std::vector<uint8_t> kvd;
+  AppendKeyValue(kvd, kWriterKey, kWriterValue, sizeof(kWriterValue));
+  if (envmap_importance) {
+    std::vector<uint8_t> value(8 + envmap_importance->radiance.size() *
+                                       sizeof(float));
+    std::memcpy(value.data(), &envmap_importance->width, 4);
+    std::memcpy(value.data() + 4, &envmap_importance->height, 4);
+    std::memcpy(value.data() + 8, envmap_importance->radiance.data(),
+                envmap_importance->radiance.size() * sizeof(float));
+    AppendKeyValue(kvd, kEnvmapImportanceKey, value.data(), value.size());
+  }
+
+  Ktx2Header header{};
+  std::memcpy(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier));
+  header.vk_format = uint32_t(TextureVkFormat(format));
+  header.type_size = TypeSize(format);
+  header.pixel_width = width;
+  header.pixel_height = height;
+  header.face_count = 1;
+  header.level_count = levels.size();
+  header.dfd_byte_offset =
+      sizeof(header) + levels.size() * sizeof(Ktx2LevelIndex);
+  header.dfd_byte_length = dfd.size() * 4;
+  header.kvd_byte_offset = header.dfd_byte_offset + header.dfd_byte_length;
+  header.kvd_byte_length = kvd.size();
+
+  // Levels start at multiples of both the texel block and 4 bytes, the
+  // smallest one first.
+  const size_t alignment = std::max<size_t>(AlignUp(BlockSize(format), 4), 4);
+  std::vector<Ktx2LevelIndex> level_index(levels.size());
+  size_t offset = header.kvd_byte_offset + header.kvd_byte_length;
+  for (size_t i = levels.size(); i-- > 0;) {
+    offset = AlignUp(offset, alignment);
+    level_index[i] = {offset, levels[i].size(), levels[i].size()};
+    offset += levels[i].size();
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    LogWarning("Failed to open file: {}", path);
+    return -1;
+  }
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(level_index.data()),
+             level_index.size() * sizeof(Ktx2LevelIndex));
+  file.write(reinterpret_cast<const char *>(dfd.data()), dfd.size() * 4);
+  file.write(reinterpret_cast<const char *>(kvd.data()), kvd.size());
+  size_t position = header.kvd_byte_offset + header.kvd_byte_length;
+  const char padding[16] = {};
+  for (size_t i = levels.size(); i-- > 0;) {
+    file.write(padding, level_index[i].byte_offset - position);
+    file.write(reinterpret_cast<const char *>(levels[i].data()),
+               levels[i].size());
+    position = level_index[i].byte_offset + levels[i].size();
+  }
+  if (!file.good()) {
+    LogWarning("Failed to write KTX2 file: {}", path);
+    return -1;
+  }
+  return 0;
+}
+
+}  // namespace sparks
@@ -0,0 +1,64 @@
+#pragma once
+#include "sparks/asset_manager/texture_format.h"
+
+namespace sparks {
+
+// GPU-ready textures in the KTX2 container. The levels are stored in their
+// Vulkan format, so they are uploaded as they are, straight from the mapped
+// file. Only 2D textures without supercompression are supported, and they
+// need a full mip chain since the shaders expect every level down to 1x1.
+class Ktx2File {
+ public:
+  int Open(const std::string &path);
+
+  TextureFormat Format() const {
+    return format_;
+  }
+
+  uint32_t Width() const {
+    return width_;
+  }
+
+  uint32_t Height() const {
+    return height_;
+  }
+
+  uint32_t NumLevels() const {
+    return levels_.size();
+  }
+
+  // Texels of a level, level 0 is the texture itself.
+  const uint8_t *LevelData(uint32_t level) const {
+    return reinterpret_cast<const uint8_t *>(file_.Data()) +
+           levels_[level].first;
+  }
+
+  size_t LevelSize(uint32_t level) const {
+    return levels_[level].second;
+  }
+
+  // Envmap importance written by SaveKtx2File, -1 if the file has none.
+  int ReadEnvmapImportance(EnvmapImportance &importance) const;
+
+ private:
+  MappedFile file_;
+  TextureFormat format_{};
+  uint32_t width_{};
+  uint32_t height_{};
+  // Offset and size of every level in the file.
+  std::vector<std::pair<size_t, size_t>> levels_;
+  size_t importance_offset_{};
+  size_t importance_size_{};
+};
+
+// Writes the levels, texture first, in the layout the KTX2 specification
+// prescribes: smallest level first, each aligned to its texel block. The
+// envmap importance, if not null, is kept in the key/value data.
+int SaveKtx2File(const std::string &path,
+                 TextureFormat format,
+                 uint32_t width,
+                 uint32_t height,
+                 const std::vector<std::vector<uint8_t>> &levels,
+                 const EnvmapImportance *envmap_importance);
+
+}  // namespace sparks
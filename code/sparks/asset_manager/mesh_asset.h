@@ -1,19 +1,64 @@
 #pragma once
+#include "sparks/asset_manager/acceleration_structure.h"
 #include "sparks/asset_manager/asset_manager_utils.h"
+#include "sparks/asset_manager/index_format.h"
+#include "sparks/asset_manager/vertex_format.h"
 
 namespace sparks {
 
 struct MeshMetadata {
   uint32_t num_vertex;
   uint32_t num_index;
+  uint32_t vertex_format;
+  uint32_t index_format;
+};
+
+struct MeshAssetSettings {
+  VertexFormat vertex_format{VertexFormat::Full};
+  // Stores the indices as 16-bit values if the mesh has few enough vertices.
+  bool allow_16bit_indices{true};
+  // Simplified levels loaded along with the mesh for the raster preview.
+  MeshLodSettings lod_settings{};
 };
 
 struct MeshAsset {
-  std::unique_ptr<vulkan::StaticBuffer<Vertex>> vertex_buffer_;
+  // Raw vertex data laid out as described by vertex_format_.
+  std::unique_ptr<vulkan::StaticBuffer<uint32_t>> vertex_buffer_;
+  // Raw index data laid out as described by index_format_.
   std::unique_ptr<vulkan::StaticBuffer<uint32_t>> index_buffer_;
-  std::unique_ptr<vulkan::StaticBuffer<float>> area_cdf_buffer_;
-  std::unique_ptr<vulkan::AccelerationStructure> blas_;
+  // Alias table selecting triangles proportionally to their area. Only
+  // emissive meshes need it, it is built on first use by
+  // AssetManager::GetMeshAreaAliasBuffer.
+  std::unique_ptr<vulkan::StaticBuffer<AliasEntry>> area_alias_buffer_;
+  std::vector<float> triangle_areas_;
+  // Built on request only, see AssetManager::RequestBlas. Set once the build
+  // has completed on the device.
+  std::unique_ptr<AccelerationStructure> blas_;
+  // Queued or part of the batch in flight.
+  bool blas_queued_{false};
   std::string name_;
   float area_;
+  uint32_t num_vertices_;
+  VertexFormat vertex_format_;
+  uint32_t num_indices_;
+  IndexFormat index_format_;
+  // Object space bounding sphere.
+  glm::vec3 center_;
+  float radius_;
+  // Object space triangle corners for the light BVH, only needed once the
+  // mesh emits light. Built on first use by AssetManager::GetMeshLightTriangles
+  // for meshes with at most kLightBvhMaxMeshTriangles triangles.
+  std::vector<glm::vec3> light_triangles_;
+  // Mesh ids of the simplified levels, finest first. The levels are hidden
+  // mesh assets owned by this one.
+  std::vector<uint32_t> lod_mesh_ids_;
+  // Geometric error against the source mesh if this is a simplified level.
+  float lod_error_{0.0f};
+  bool hidden_{false};
+  // Key of the geometry, the settings and the LODs. Simplified levels have
+  // none, they are never shared on their own.
+  Hash128 content_hash_;
+  // Loads that returned this asset, DestroyMesh releases one of them.
+  uint32_t ref_count_{1};
 };
 }  // namespace sparks
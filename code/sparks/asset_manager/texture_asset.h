@@ -1,10 +1,61 @@
 #pragma once
 #include "sparks/asset_manager/asset_manager_utils.h"
+#include "sparks/asset_manager/ktx2_file.h"
+#include "sparks/asset_manager/texture_format.h"
 
 namespace sparks {
+struct TextureAssetSettings {
+  // Stores the texture block compressed, in the format picked by
+  // CompressedTextureFormat.
+  bool compress{false};
+  // Opaque colour textures use BC1 instead of BC7, halving their size once
+  // more at a visible loss of quality.
+  bool prefer_bc1{false};
+  // Builds the mip chain SampleTextureLod filters. Envmaps are sampled at the
+  // top level only and skip it, their mip slots repeat the texture itself.
+  bool generate_mips{true};
+};
+
+// Host side of a texture asset. Everything in here is computed from the
+// pixels alone, so the asynchronous loaders build it on the worker threads and
+// only the upload is left to the render thread.
+struct TextureUpload {
+  uint32_t width{};
+  uint32_t height{};
+  TextureFormat format;
+  // Levels below the texture itself, down to 1x1.
+  std::vector<Texture> mip_levels;
+  // Encoded texels of every level in format, the texture itself first.
+  std::vector<std::vector<uint8_t>> level_texels;
+  // Reduces the texture to its envmap importance cells. Any texture may be
+  // picked as the envmap later, so this is only run on first use as one.
+  std::function<int(EnvmapImportance &)> build_envmap_importance;
+  // Set for baked KTX2 files, whose levels are uploaded straight from the
+  // mapped file instead of mip_levels and level_texels.
+  std::unique_ptr<Ktx2File> container;
+  // Key of the encoded levels, identical uploads share one asset.
+  Hash128 content_hash;
+};
+
 struct TextureAsset {
   std::unique_ptr<vulkan::Image> image_;
-  std::unique_ptr<vulkan::StaticBuffer<float>> cdf_buffer_;
+  // Mip levels below image_, down to 1x1 unless the texture was loaded
+  // without mips. They are bound to the slots of sampled_textures right after
+  // the one of image_.
+  std::vector<std::unique_ptr<vulkan::Image>> mip_images_;
+  // Slots taken in sampled_textures, one per uploaded level.
+  uint32_t num_binding_slots_{1};
+  TextureFormat format_;
+  // TextureUpload::build_envmap_importance, dropped once the buffer below is
+  // built.
+  std::function<int(EnvmapImportance &)> build_envmap_importance_;
+  // Size of the envmap importance map followed by its alias table, laid out
+  // as the EnvmapImportance buffer of raytracing.rgen. Built on first use by
+  // AssetManager::GetTextureImportanceBuffer.
+  std::unique_ptr<vulkan::StaticBuffer<uint32_t>> importance_buffer_;
   std::string name_;
+  Hash128 content_hash_;
+  // Loads that returned this asset, DestroyTexture releases one of them.
+  uint32_t ref_count_{1};
 };
 }  // namespace sparks
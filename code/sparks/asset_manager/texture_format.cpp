@@ -0,0 +1,243 @@
+#include "sparks/asset_manager/texture_format.h"
+
+#include "algorithm"
+#include "cmath"
+#include "cstring"
+#include "glm/gtc/packing.hpp"
+
+namespace sparks {
+
+namespace {
+
+// Rows decoded at a time by EncodeTextureStream, a multiple of the block
+// height.
+constexpr uint32_t kStreamBandRows = 64;
+
+// Largest finite half float.
+constexpr float kHalfMax = 65504.0f;
+
+uint32_t QuantizeUnorm(float value, float max_value) {
+  // NaN maps to 0.
+  if (!(value > 0.0f)) {
+    return 0;
+  }
+  return static_cast<uint32_t>(std::round(std::min(value, 1.0f) * max_value));
+}
+
+glm::vec4 ClampHalf(const glm::vec4 &value) {
+  return glm::clamp(value, glm::vec4{-kHalfMax}, glm::vec4{kHalfMax});
+}
+
+void EncodeTexel(const glm::vec4 &pixel, TextureFormat format, uint8_t *out) {
+  switch (format) {
+    case TextureFormat::RGBA8Unorm:
+      for (int c = 0; c < 4; c++) {
+        out[c] = uint8_t(QuantizeUnorm(pixel[c], 255.0f));
+      }
+      break;
+    case TextureFormat::RGBA8Srgb:
+      for (int c = 0; c < 3; c++) {
+        out[c] = FloatToByte(pixel[c], LDRColorSpace::SRGB);
+      }
+      out[3] = uint8_t(QuantizeUnorm(pixel.a, 255.0f));
+      break;
+    case TextureFormat::RGBA16Unorm:
+      for (int c = 0; c < 4; c++) {
+        uint16_t value = uint16_t(QuantizeUnorm(pixel[c], 65535.0f));
+        std::memcpy(out + c * 2, &value, sizeof(value));
+      }
+      break;
+    case TextureFormat::RGBA16Float: {
+      glm::uint64 value = glm::packHalf4x16(ClampHalf(pixel));
+      std::memcpy(out, &value, sizeof(value));
+      break;
+    }
+    case TextureFormat::RGB9E5Float: {
+      // The format is unsigned, its largest value is close to the half one.
+      glm::vec3 rgb = glm::clamp(glm::vec3{pixel}, glm::vec3{0.0f},
+                                 glm::vec3{kHalfMax});
+      uint32_t value = glm::packF3x9_E1x5(rgb);
+      std::memcpy(out, &value, sizeof(value));
+      break;
+    }
+    case TextureFormat::R8Unorm:
+      out[0] = uint8_t(QuantizeUnorm(pixel.r, 255.0f));
+      break;
+    case TextureFormat::R16Unorm: {
+      uint16_t value = uint16_t(QuantizeUnorm(pixel.r, 65535.0f));
+      std::memcpy(out, &value, sizeof(value));
+      break;
+    }
+    default:
+      std::memcpy(out, &pixel, sizeof(pixel));
+      break;
+  }
+}
+
+}  // namespace
+
+uint32_t NumMipLevels(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  while (width > 1 || height > 1) {
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+    levels++;
+  }
+  return levels;
+}
+
+VkFormat TextureVkFormat(TextureFormat format) {
+  switch (format) {
+    case TextureFormat::RGBA8Unorm:
+      return VK_FORMAT_R8G8B8A8_UNORM;
+    case TextureFormat::RGBA8Srgb:
+      return VK_FORMAT_R8G8B8A8_SRGB;
+    case TextureFormat::RGBA16Unorm:
+      return VK_FORMAT_R16G16B16A16_UNORM;
+    case TextureFormat::RGBA16Float:
+      return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case TextureFormat::RGB9E5Float:
+      return VK_FORMAT_E5B9G9R9_UFLOAT_PACK32;
+    case TextureFormat::R8Unorm:
+      return VK_FORMAT_R8_UNORM;
+    case TextureFormat::R16Unorm:
+      return VK_FORMAT_R16_UNORM;
+    case TextureFormat::BC1Unorm:
+      return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case TextureFormat::BC1Srgb:
+      return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    case TextureFormat::BC4Unorm:
+      return VK_FORMAT_BC4_UNORM_BLOCK;
+    case TextureFormat::BC5Unorm:
+      return VK_FORMAT_BC5_UNORM_BLOCK;
+    case TextureFormat::BC6HUfloat:
+      return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+    case TextureFormat::BC7Unorm:
+      return VK_FORMAT_BC7_UNORM_BLOCK;
+    case TextureFormat::BC7Srgb:
+      return VK_FORMAT_BC7_SRGB_BLOCK;
+    default:
+      return VK_FORMAT_R32G32B32A32_SFLOAT;
+  }
+}
+
+uint32_t TexelSize(TextureFormat format) {
+  switch (format) {
+    case TextureFormat::RGBA8Unorm:
+    case TextureFormat::RGBA8Srgb:
+    case TextureFormat::RGB9E5Float:
+      return 4;
+    case TextureFormat::RGBA16Unorm:
+    case TextureFormat::RGBA16Float:
+      return 8;
+    case TextureFormat::R8Unorm:
+      return 1;
+    case TextureFormat::R16Unorm:
+      return 2;
+    default:
+      return sizeof(glm::vec4);
+  }
+}
+
+void EncodeTexture(const Texture &texture,
+                   TextureFormat format,
+                   std::vector<uint8_t> &data) {
+  if (IsBlockCompressed(format)) {
+    CompressTexture(texture, format, data);
+    return;
+  }
+  const uint32_t texel_size = TexelSize(format);
+  const uint64_t num_pixels = uint64_t(texture.Width()) * texture.Height();
+  data.resize(num_pixels * texel_size);
+  const glm::vec4 *pixels = texture.Data();
+  ParallelFor(num_pixels, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; i++) {
+      EncodeTexel(pixels[i], format, data.data() + i * texel_size);
+    }
+  });
+}
+
+int EncodeTextureStream(TextureReader &reader,
+                        TextureFormat format,
+                        std::vector<uint8_t> &data,
+                        Texture *first_mip_level) {
+  const uint32_t width = reader.Width();
+  const uint32_t height = reader.Height();
+  if (!width || !height) {
+    return -1;
+  }
+  const bool compressed = IsBlockCompressed(format);
+
+  uint64_t cache_key = 0;
+  bool cached = false;
+  if (compressed && reader.SourceKey()) {
+    cache_key = HashCombine(reader.SourceKey(), uint64_t(format));
+    cached = !LoadTextureCache(cache_key, width, height, format, data);
+  }
+  if (cached && !first_mip_level) {
+    return 0;
+  }
+  if (!cached) {
+    data.clear();
+    data.reserve(compressed ? size_t((width + 3) / 4) * ((height + 3) / 4) *
+                                  CompressedBlockSize(format)
+                            : size_t(width) * height * TexelSize(format));
+  }
+
+  const uint32_t mip_width = std::max(width / 2, 1u);
+  const uint32_t mip_height = std::max(height / 2, 1u);
+  if (first_mip_level) {
+    *first_mip_level = Texture(mip_width, mip_height);
+    first_mip_level->SetFormat(reader.Format());
+  }
+
+  Texture band(width, std::min(kStreamBandRows, height));
+  band.SetFormat(reader.Format());
+  std::vector<uint8_t> band_data;
+  for (uint32_t y = 0; y < height; y += kStreamBandRows) {
+    const uint32_t rows = std::min(kStreamBandRows, height - y);
+    if (rows != band.Height()) {
+      band = Texture(width, rows);
+      band.SetFormat(reader.Format());
+    }
+    if (reader.ReadRows(rows, band.Data())) {
+      return -1;
+    }
+
+    if (!cached) {
+      // Bands start at multiples of the block height, so the blocks are the
+      // ones of the whole image. Only the whole image is cached.
+      if (compressed) {
+        CompressTexture(band, format, band_data, false);
+      } else {
+        EncodeTexture(band, format, band_data);
+      }
+      data.insert(data.end(), band_data.begin(), band_data.end());
+    }
+
+    if (first_mip_level) {
+      // Bands hold whole row pairs, except for a trailing odd row that the
+      // next level drops anyway.
+      Texture &level = *first_mip_level;
+      for (uint32_t r = 0; r < rows; r += 2) {
+        const uint32_t mip_y = (y + r) / 2;
+        if (mip_y >= mip_height) {
+          break;
+        }
+        for (uint32_t x = 0; x < mip_width; x++) {
+          level(x, mip_y) = 0.25f * (band.Fetch(x * 2, r) +
+                                     band.Fetch(x * 2 + 1, r) +
+                                     band.Fetch(x * 2, r + 1) +
+                                     band.Fetch(x * 2 + 1, r + 1));
+        }
+      }
+    }
+  }
+
+  if (compressed && !cached && cache_key) {
+    SaveTextureCache(cache_key, width, height, format, data);
+  }
+  return 0;
+}
+
+}  // namespace sparks
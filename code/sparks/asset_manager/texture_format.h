@@ -0,0 +1,30 @@
+#pragma once
+#include "sparks/asset_manager/asset_manager_utils.h"
+
+namespace sparks {
+
+// Levels of a full mip chain of the size, down to 1x1.
+uint32_t NumMipLevels(uint32_t width, uint32_t height);
+
+VkFormat TextureVkFormat(TextureFormat format);
+
+// Size of a texel of an uncompressed format.
+uint32_t TexelSize(TextureFormat format);
+
+// Converts the float pixels of the texture to the texel layout of format,
+// rows are tightly packed. Block compressed formats go through
+// CompressTexture and its cache.
+void EncodeTexture(const Texture &texture,
+                   TextureFormat format,
+                   std::vector<uint8_t> &data);
+
+// Encodes the image of reader a band of rows at a time, so that it is never
+// held as floats as a whole. On the way, first_mip_level receives the level
+// below the image as BuildMipChain computes it, unless it is null. Compressed
+// results are cached under the source file of the reader.
+int EncodeTextureStream(TextureReader &reader,
+                        TextureFormat format,
+                        std::vector<uint8_t> &data,
+                        Texture *first_mip_level);
+
+}  // namespace sparks
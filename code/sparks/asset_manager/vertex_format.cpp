@@ -0,0 +1,102 @@
+#include "sparks/asset_manager/vertex_format.h"
+
+#include "algorithm"
+#include "cmath"
+#include "cstring"
+#include "glm/gtc/packing.hpp"
+
+namespace sparks {
+
+namespace {
+
+constexpr uint32_t kCompactVertexWords = 6;
+constexpr uint32_t kTangentSignBit = 1u << 16;
+
+glm::vec2 OctahedralWrap(const glm::vec2 &v) {
+  return {(1.0f - std::abs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f),
+          (1.0f - std::abs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f)};
+}
+
+int32_t QuantizeSnorm16(float value) {
+  return static_cast<int32_t>(
+      std::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+uint32_t PackSnorm16x2(int32_t x, int32_t y) {
+  return (uint32_t(x) & 0xffffu) | ((uint32_t(y) & 0xffffu) << 16);
+}
+
+}  // namespace
+
+uint32_t VertexStride(VertexFormat format) {
+  switch (format) {
+    case VertexFormat::Compact:
+      return kCompactVertexWords * sizeof(uint32_t);
+    default:
+      return sizeof(Vertex);
+  }
+}
+
+uint32_t EncodeOctahedral(const glm::vec3 &direction) {
+  float l1_norm =
+      std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+  if (!(l1_norm > 0.0f)) {
+    return PackSnorm16x2(0, 0);
+  }
+  glm::vec3 n = direction / l1_norm;
+  glm::vec2 p{n.x, n.y};
+  if (n.z < 0.0f) {
+    p = OctahedralWrap(p);
+  }
+
+  // Plain rounding is not the closest representable direction, try the four
+  // neighbouring grid points and keep the best one.
+  glm::vec3 target = glm::normalize(direction);
+  float fx = std::floor(glm::clamp(p.x, -1.0f, 1.0f) * 32767.0f);
+  float fy = std::floor(glm::clamp(p.y, -1.0f, 1.0f) * 32767.0f);
+  uint32_t best = 0;
+  float best_dot = -2.0f;
+  for (int i = 0; i < 4; i++) {
+    int32_t x = std::min(int32_t(fx) + (i & 1), 32767);
+    int32_t y = std::min(int32_t(fy) + (i >> 1), 32767);
+    uint32_t encoded = PackSnorm16x2(x, y);
+    float d = glm::dot(DecodeOctahedral(encoded), target);
+    if (d > best_dot) {
+      best_dot = d;
+      best = encoded;
+    }
+  }
+  return best;
+}
+
+glm::vec3 DecodeOctahedral(uint32_t encoded) {
+  glm::vec2 f{std::max(float(int16_t(encoded & 0xffffu)) / 32767.0f, -1.0f),
+              std::max(float(int16_t(encoded >> 16)) / 32767.0f, -1.0f)};
+  glm::vec3 n{f.x, f.y, 1.0f - std::abs(f.x) - std::abs(f.y)};
+  float t = std::max(-n.z, 0.0f);
+  n.x += n.x >= 0.0f ? -t : t;
+  n.y += n.y >= 0.0f ? -t : t;
+  return glm::normalize(n);
+}
+
+void EncodeCompactVertices(const std::vector<Vertex> &vertices,
+                           std::vector<uint32_t> &words) {
+  words.resize(vertices.size() * kCompactVertexWords);
+  ParallelFor(vertices.size(), [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; i++) {
+      const Vertex &vertex = vertices[i];
+      uint32_t *out = &words[i * kCompactVertexWords];
+      std::memcpy(out, &vertex.position, sizeof(glm::vec3));
+      out[3] = EncodeOctahedral(vertex.normal);
+      // The lowest bit of the tangent's y component carries the sign, the
+      // lost precision is far below what octahedral encoding resolves.
+      out[4] = EncodeOctahedral(vertex.tangent) & ~kTangentSignBit;
+      if (vertex.signal < 0.0f) {
+        out[4] |= kTangentSignBit;
+      }
+      out[5] = glm::packHalf2x16(vertex.tex_coord);
+    }
+  });
+}
+
+}  // namespace sparks
@@ -0,0 +1,23 @@
+#pragma once
+#include "sparks/asset_manager/asset_manager_utils.h"
+
+namespace sparks {
+
+// Layout of the vertex buffer of a mesh asset, positions always come first as
+// three floats so the buffer can be fed to the BLAS build directly.
+// Full:    Vertex as is, 48 bytes.
+// Compact: float3 position, octahedral normal (snorm16x2), octahedral tangent
+//          (snorm16x2, bit 16 holds the sign of the bitangent) and half2
+//          texture coordinate, 24 bytes.
+enum class VertexFormat : uint32_t { Full = 0, Compact = 1 };
+
+uint32_t VertexStride(VertexFormat format);
+
+uint32_t EncodeOctahedral(const glm::vec3 &direction);
+
+glm::vec3 DecodeOctahedral(uint32_t encoded);
+
+void EncodeCompactVertices(const std::vector<Vertex> &vertices,
+                           std::vector<uint32_t> &words);
+
+}  // namespace sparks
@@ -1,5 +1,11 @@
 #pragma once
+#include "sparks/assets/envmap_importance.h"
 #include "sparks/assets/mesh.h"
+#include "sparks/assets/mesh_lod.h"
+#include "sparks/assets/primitive.h"
+#include "sparks/assets/terrain.h"
 #include "sparks/assets/texture.h"
+#include "sparks/assets/texture_compression.h"
+#include "sparks/assets/texture_reader.h"
 
 namespace sparks {}
@@ -0,0 +1,148 @@
+#include "sparks/assets/envmap_importance.h"
+
+#include "algorithm"
+#include "cmath"
+#include "glm/gtc/constants.hpp"
+
+namespace sparks {
+
+namespace {
+// Pixel range of cell c out of n along an axis of the given size, see
+// EnvmapImportance::radiance. Along u the range may reach one pixel past
+// either edge and wraps around.
+int CellBegin(uint32_t c, uint32_t n, uint32_t size) {
+  return int(uint64_t(c) * size / n) - 1;
+}
+
+int CellEnd(uint32_t c, uint32_t n, uint32_t size) {
+  return int((uint64_t(c + 1) * size + n - 1) / n) + 1;
+}
+
+constexpr uint32_t kReaderBandRows = 64;
+}  // namespace
+
+int BuildEnvmapImportance(const Texture &envmap, EnvmapImportance &importance) {
+  EnvmapImportanceBuilder builder(envmap.Width(), envmap.Height());
+  for (uint32_t y = 0; y < envmap.Height(); y++) {
+    builder.AddRow(y, envmap.Data() + size_t(y) * envmap.Width());
+  }
+  return builder.Finish(importance);
+}
+
+int BuildEnvmapImportance(TextureReader &reader, EnvmapImportance &importance) {
+  const uint32_t width = reader.Width();
+  const uint32_t height = reader.Height();
+  EnvmapImportanceBuilder builder(width, height);
+  std::vector<glm::vec4> band(size_t(width) * kReaderBandRows);
+  for (uint32_t y = 0; y < height; y += kReaderBandRows) {
+    const uint32_t rows = std::min(kReaderBandRows, height - y);
+    if (reader.ReadRows(rows, band.data())) {
+      return -1;
+    }
+    for (uint32_t r = 0; r < rows; r++) {
+      builder.AddRow(y + r, band.data() + size_t(r) * width);
+    }
+  }
+  return builder.Finish(importance);
+}
+
+EnvmapImportanceBuilder::EnvmapImportanceBuilder(uint32_t width,
+                                                 uint32_t height)
+    : width_(width),
+      height_(height),
+      cells_x_(std::min<uint32_t>(width, kEnvmapImportanceMaxWidth)),
+      cells_y_(std::min<uint32_t>(height, kEnvmapImportanceMaxHeight)) {
+  sums_.assign(size_t(cells_x_) * cells_y_, 0.0);
+  row_prefix_.resize(width_ + 1);
+}
+
+void EnvmapImportanceBuilder::AddRow(uint32_t y, const glm::vec4 *pixels) {
+  row_prefix_[0] = 0.0;
+  for (uint32_t x = 0; x < width_; x++) {
+    const glm::vec4 &pixel = pixels[x];
+    row_prefix_[x + 1] =
+        row_prefix_[x] + std::max(pixel.x, std::max(pixel.y, pixel.z));
+  }
+  auto radiance = [&](int x) {
+    return row_prefix_[x + 1] - row_prefix_[x];
+  };
+
+  // Cells are at least a pixel high, only the two cell rows on either side
+  // of the one holding y may overlap it.
+  const int center = int(uint64_t(y) * cells_y_ / height_);
+  const int cy_begin = std::max(center - 2, 0);
+  const int cy_end = std::min(center + 3, int(cells_y_));
+  for (int cy = cy_begin; cy < cy_end; cy++) {
+    if (int(y) < CellBegin(cy, cells_y_, height_) ||
+        int(y) >= CellEnd(cy, cells_y_, height_)) {
+      continue;
+    }
+    for (uint32_t cx = 0; cx < cells_x_; cx++) {
+      int x0 = CellBegin(cx, cells_x_, width_);
+      int x1 = CellEnd(cx, cells_x_, width_);
+      double sum = row_prefix_[std::min(x1, int(width_))] -
+                   row_prefix_[std::max(x0, 0)];
+      if (x0 < 0) {
+        sum += radiance(width_ - 1);
+      }
+      if (x1 > int(width_)) {
+        sum += radiance(0);
+      }
+      sums_[cy * cells_x_ + cx] += sum;
+    }
+  }
+}
+
+int EnvmapImportanceBuilder::Finish(EnvmapImportance &importance) const {
+  importance.radiance.clear();
+  if (!width_ || !height_) {
+    return -1;
+  }
+  importance.width = cells_x_;
+  importance.height = cells_y_;
+  importance.radiance.resize(sums_.size());
+  for (uint32_t cy = 0; cy < cells_y_; cy++) {
+    int y0 = std::max(CellBegin(cy, cells_y_, height_), 0);
+    int y1 = std::min(CellEnd(cy, cells_y_, height_), int(height_));
+    for (uint32_t cx = 0; cx < cells_x_; cx++) {
+      int x0 = CellBegin(cx, cells_x_, width_);
+      int x1 = CellEnd(cx, cells_x_, width_);
+      importance.radiance[cy * cells_x_ + cx] = float(
+          sums_[cy * cells_x_ + cx] / (double(x1 - x0) * double(y1 - y0)));
+    }
+  }
+  return 0;
+}
+
+void BuildEnvmapAliasTable(const EnvmapImportance &importance,
+                           std::vector<AliasEntry> &table) {
+  const uint32_t cells_x = importance.width;
+  const uint32_t cells_y = importance.height;
+  // Relative solid angle of the cells in each row, the band between the two
+  // polar angles divided into cells_x sectors.
+  std::vector<float> solid_angles(cells_y);
+  for (uint32_t cy = 0; cy < cells_y; cy++) {
+    float v0 = float(cy) / float(cells_y);
+    float v1 = float(cy + 1) / float(cells_y);
+    solid_angles[cy] = (std::cos(v0 * glm::pi<float>()) -
+                        std::cos(v1 * glm::pi<float>())) /
+                       float(cells_x);
+  }
+
+  std::vector<float> weights(importance.radiance.size());
+  for (uint32_t cy = 0; cy < cells_y; cy++) {
+    for (uint32_t cx = 0; cx < cells_x; cx++) {
+      uint32_t index = cy * cells_x + cx;
+      weights[index] = importance.radiance[index] * solid_angles[cy];
+    }
+  }
+  if (BuildAliasTable(weights, table)) {
+    for (uint32_t cy = 0; cy < cells_y; cy++) {
+      std::fill(weights.begin() + cy * cells_x,
+                weights.begin() + (cy + 1) * cells_x, solid_angles[cy]);
+    }
+    BuildAliasTable(weights, table);
+  }
+}
+
+}  // namespace sparks
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "sparks/assets/texture.h"
+#include "sparks/assets/texture_reader.h"
+
+namespace sparks {
+
+// Resolution limits of the importance map. Equirectangular envmaps are twice
+// as wide as high, so the cells stay roughly square.
+constexpr uint32_t kEnvmapImportanceMaxWidth = 512;
+constexpr uint32_t kEnvmapImportanceMaxHeight = 256;
+
+// Piecewise constant distribution over the directions of an equirectangular
+// envmap. The uv square is split into width x height cells of equal extent,
+// sampled proportionally to the radiance arriving through them, see
+// envmap_direct_lighting.glsl.
+struct EnvmapImportance {
+  uint32_t width{};
+  uint32_t height{};
+  // Mean radiance of the pixels each cell overlaps, widened by one pixel so
+  // that the bilinear footprint of a bright pixel is never left out.
+  std::vector<float> radiance;
+};
+
+// Reduces the envmap to its importance cells. Returns -1 for empty textures.
+int BuildEnvmapImportance(const Texture &envmap, EnvmapImportance &importance);
+
+// Same reduction over the remaining rows of reader, decoded a band at a time.
+// Returns -1 if the image cannot be read to the end.
+int BuildEnvmapImportance(TextureReader &reader, EnvmapImportance &importance);
+
+// Same reduction as BuildEnvmapImportance, fed one row at a time by loaders
+// that never hold the whole envmap.
+class EnvmapImportanceBuilder {
+ public:
+  EnvmapImportanceBuilder(uint32_t width, uint32_t height);
+
+  // Adds row y of the envmap, rows may come in any order.
+  void AddRow(uint32_t y, const glm::vec4 *pixels);
+
+  int Finish(EnvmapImportance &importance) const;
+
+ private:
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t cells_x_;
+  uint32_t cells_y_;
+  // Summed radiance of the pixels each cell overlaps.
+  std::vector<double> sums_;
+  std::vector<double> row_prefix_;
+};
+
+// Builds the alias table over the cells, weighting them by their solid angle.
+// Black envmaps fall back to uniform directions.
+void BuildEnvmapAliasTable(const EnvmapImportance &importance,
+                           std::vector<AliasEntry> &table);
+
+}  // namespace sparks
@@ -0,0 +1,171 @@
+#include "sparks/assets/height_field.h"
+
+#include "algorithm"
+#include "cmath"
+#include "sparks/utils/parallel.h"
+
+namespace sparks {
+
+namespace {
+
+// Grid coordinates of a patch: every step-th point plus the end point.
+std::vector<uint32_t> PatchCoordinates(uint32_t begin,
+                                       uint32_t end,
+                                       uint32_t step) {
+  std::vector<uint32_t> coordinates;
+  for (uint32_t i = begin; i < end; i += step) {
+    coordinates.push_back(i);
+  }
+  coordinates.push_back(end);
+  return coordinates;
+}
+
+}  // namespace
+
+HeightField::HeightField(const Texture &height_map,
+                         float precision,
+                         float height_scale,
+                         float height_offset) {
+  width_ = std::max(1u, uint32_t(height_map.Width() * precision));
+  height_ = std::max(1u, uint32_t(height_map.Height() * precision));
+  heights_.resize(size_t(width_ + 1) * (height_ + 1));
+  float inv_width = 1.0f / width_;
+  float inv_height = 1.0f / height_;
+  ParallelFor(
+      height_ + 1,
+      [&](uint64_t begin, uint64_t end) {
+        for (uint32_t j = begin; j < end; j++) {
+          for (uint32_t i = 0; i <= width_; i++) {
+            glm::vec4 color =
+                height_map.Sample(float(i) * inv_width, float(j) * inv_height,
+                                  AddressMode::BlackBorder);
+            float h = color.r * 0.299f + color.g * 0.587f + color.b * 0.114f;
+            heights_[j * (width_ + 1) + i] = h * height_scale + height_offset;
+          }
+        }
+      },
+      16);
+}
+
+Vertex HeightField::GetVertex(uint32_t i, uint32_t j) const {
+  float inv_width = 1.0f / width_;
+  float inv_height = 1.0f / height_;
+  uint32_t i0 = i ? i - 1 : i;
+  uint32_t i1 = std::min(i + 1, width_);
+  uint32_t j0 = j ? j - 1 : j;
+  uint32_t j1 = std::min(j + 1, height_);
+
+  glm::vec3 du{float(i1 - i0) * inv_width, At(i1, j) - At(i0, j), 0.0f};
+  glm::vec3 dv{0.0f, At(i, j1) - At(i, j0), float(j1 - j0) * inv_height};
+
+  Vertex vertex;
+  vertex.position = {float(i) * inv_width, At(i, j), float(j) * inv_height};
+  vertex.normal = glm::normalize(glm::cross(dv, du));
+  vertex.tangent = glm::normalize(du);
+  vertex.tex_coord = {float(i) * inv_width, float(j) * inv_height};
+  vertex.signal =
+      glm::dot(glm::cross(vertex.normal, vertex.tangent), dv) < 0.0f ? -1.0f
+                                                                     : 1.0f;
+  return vertex;
+}
+
+void HeightField::BuildPatch(uint32_t x0,
+                             uint32_t y0,
+                             uint32_t x1,
+                             uint32_t y1,
+                             uint32_t step,
+                             float skirt_depth,
+                             std::vector<Vertex> &vertices,
+                             std::vector<uint32_t> &indices) const {
+  std::vector<uint32_t> xs = PatchCoordinates(x0, x1, step);
+  std::vector<uint32_t> ys = PatchCoordinates(y0, y1, step);
+  const uint32_t nx = xs.size();
+  const uint32_t ny = ys.size();
+
+  vertices.clear();
+  indices.clear();
+  vertices.reserve(nx * ny);
+  for (uint32_t j : ys) {
+    for (uint32_t i : xs) {
+      vertices.push_back(GetVertex(i, j));
+    }
+  }
+
+  // Same triangulation as Mesh::LoadFromHeightMap always used.
+  indices.reserve((nx - 1) * (ny - 1) * 6);
+  for (uint32_t b = 0; b + 1 < ny; b++) {
+    for (uint32_t a = 0; a + 1 < nx; a++) {
+      uint32_t v00 = b * nx + a;
+      uint32_t v01 = (b + 1) * nx + a;
+      indices.insert(indices.end(),
+                     {v00, v01, v00 + 1, v01 + 1, v00 + 1, v01});
+    }
+  }
+
+  if (skirt_depth <= 0.0f) {
+    return;
+  }
+
+  // Walks the patch border so that the walls face away from the patch.
+  std::vector<uint32_t> border;
+  for (uint32_t a = 0; a + 1 < nx; a++) {
+    border.push_back(a);
+  }
+  for (uint32_t b = 0; b + 1 < ny; b++) {
+    border.push_back(b * nx + nx - 1);
+  }
+  for (uint32_t a = nx - 1; a > 0; a--) {
+    border.push_back((ny - 1) * nx + a);
+  }
+  for (uint32_t b = ny - 1; b > 0; b--) {
+    border.push_back(b * nx);
+  }
+
+  const uint32_t skirt_begin = vertices.size();
+  for (uint32_t index : border) {
+    Vertex vertex = vertices[index];
+    vertex.position.y -= skirt_depth;
+    vertices.push_back(vertex);
+  }
+  for (uint32_t k = 0; k < border.size(); k++) {
+    uint32_t next = (k + 1) % border.size();
+    uint32_t a = border[k];
+    uint32_t b = border[next];
+    uint32_t qa = skirt_begin + k;
+    uint32_t qb = skirt_begin + next;
+    indices.insert(indices.end(), {a, b, qa, qa, b, qb});
+  }
+}
+
+float HeightField::PatchError(uint32_t x0,
+                              uint32_t y0,
+                              uint32_t x1,
+                              uint32_t y1,
+                              uint32_t step) const {
+  std::vector<uint32_t> xs = PatchCoordinates(x0, x1, step);
+  std::vector<uint32_t> ys = PatchCoordinates(y0, y1, step);
+  float error = 0.0f;
+  for (uint32_t b = 0; b + 1 < ys.size(); b++) {
+    for (uint32_t a = 0; a + 1 < xs.size(); a++) {
+      uint32_t i0 = xs[a], i1 = xs[a + 1];
+      uint32_t j0 = ys[b], j1 = ys[b + 1];
+      float h00 = At(i0, j0), h10 = At(i1, j0);
+      float h01 = At(i0, j1), h11 = At(i1, j1);
+      for (uint32_t j = j0; j <= j1; j++) {
+        for (uint32_t i = i0; i <= i1; i++) {
+          // The cell is split along the diagonal from (i1, j0) to (i0, j1).
+          float u = float(i - i0) / float(i1 - i0);
+          float v = float(j - j0) / float(j1 - j0);
+          float h = u + v <= 1.0f
+                        ? h00 + u * (h10 - h00) + v * (h01 - h00)
+                        : h11 + (1.0f - u) * (h01 - h11) +
+                              (1.0f - v) * (h10 - h11);
+          error = std::max(error, std::abs(At(i, j) - h));
+        }
+      }
+    }
+  }
+  return error;
+}
+
+}  // namespace sparks
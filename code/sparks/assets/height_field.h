@@ -0,0 +1,60 @@
+#pragma once
+
+#include "sparks/assets/texture.h"
+#include "sparks/assets/vertex.h"
+#include "vector"
+
+namespace sparks {
+
+// Heights of a heightmap sampled on a regular grid of Width() x Height()
+// quads spanning [0, 1] in x and z. Normals and tangents are derived from
+// central differences of the heights, so no mesh processing is needed.
+class HeightField {
+ public:
+  HeightField(const Texture &height_map,
+              float precision = 1.0f,
+              float height_scale = 1.0f,
+              float height_offset = 0.0f);
+
+  uint32_t Width() const {
+    return width_;
+  }
+
+  uint32_t Height() const {
+    return height_;
+  }
+
+  float At(uint32_t i, uint32_t j) const {
+    return heights_[j * (width_ + 1) + i];
+  }
+
+  Vertex GetVertex(uint32_t i, uint32_t j) const;
+
+  // Triangulates the quads [x0, x1) x [y0, y1) with a vertex every step grid
+  // points, the patch edges are always included. A positive skirt_depth adds
+  // outward facing walls of that depth below the patch edges, which hide the
+  // cracks between neighbouring patches of different steps.
+  void BuildPatch(uint32_t x0,
+                  uint32_t y0,
+                  uint32_t x1,
+                  uint32_t y1,
+                  uint32_t step,
+                  float skirt_depth,
+                  std::vector<Vertex> &vertices,
+                  std::vector<uint32_t> &indices) const;
+
+  // Largest vertical distance between the grid points of [x0, x1] x [y0, y1]
+  // and the patch built with the given step.
+  float PatchError(uint32_t x0,
+                   uint32_t y0,
+                   uint32_t x1,
+                   uint32_t y1,
+                   uint32_t step) const;
+
+ private:
+  uint32_t width_{};
+  uint32_t height_{};
+  std::vector<float> heights_;
+};
+
+}  // namespace sparks
@@ -1,37 +1,71 @@
 #include "sparks/assets/mesh.h"
 
-#include "map"
-#include "mikktspace.h"
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
+#include "cstring"
+#include "fstream"
 
 namespace sparks {
 
+namespace {
+uint64_t HashFloatBits(uint64_t seed, float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return HashCombine(seed, bits);
+}
+
+// Hashes every option that affects the processed output.
+uint64_t HashBuildOptions(const MeshBuildOptions &options) {
+  uint64_t hash = HashCombine(kMeshCacheVersion, options.has_normals);
+  hash = HashCombine(hash, options.has_tangents);
+  hash = HashCombine(hash, options.build_normals);
+  hash = HashCombine(hash, options.build_tangents);
+  hash = HashCombine(hash, options.merge_vertices);
+  hash = HashCombine(hash, options.optimize_locality);
+  hash = HashCombine(hash, options.optimize_vertex_cache);
+  hash = HashFloatBits(hash, options.weld_settings.position_epsilon);
+  return HashFloatBits(hash, options.weld_settings.normal_epsilon);
+}
+}  // namespace
+
 Mesh::Mesh(const std::vector<Vertex> &vertices,
-           const std::vector<uint32_t> &indices)
+           const std::vector<uint32_t> &indices,
+           const MeshBuildOptions &options)
     : vertices_(vertices), indices_(indices) {
-  BuildTangent();
+  Build(options);
 }
 
-void Mesh::MergeVertices() {
-  std::vector<Vertex> vertices;
-  std::vector<uint32_t> indices;
-  std::map<Vertex, uint32_t> vertex_index_map;
-  auto index_func = [&vertices, &vertex_index_map](const Vertex &v) {
-    if (vertex_index_map.count(v)) {
-      return vertex_index_map.at(v);
-    }
-    uint32_t res = vertices.size();
-    vertex_index_map[v] = res;
-    vertices.push_back(v);
-    return res;
-  };
-  for (auto ind : indices_) {
-    indices.push_back(index_func(vertices_[ind]));
+void Mesh::Build(const MeshBuildOptions &options) {
+  if (!indices_.size() || !vertices_.size()) {
+    return;
+  }
+
+  if (!options.has_normals && options.build_normals) {
+    BuildNormal();
+  }
+
+  if (!options.has_tangents && options.build_tangents) {
+    BuildTangent(options);
+  } else if (options.merge_vertices) {
+    MergeVertices(options.weld_settings);
+  }
+
+  if (options.optimize_locality) {
+    OptimizeLayout(options);
   }
-  vertices_ = vertices;
-  indices_ = indices;
+}
+
+void Mesh::OptimizeLayout(const MeshBuildOptions &options) {
+  SortTrianglesByMorton(vertices_, indices_);
+  ReorderVerticesByFirstUse(vertices_, indices_);
+  if (options.optimize_vertex_cache) {
+    // Tipsify walks the vertices in index order at dead ends, the renumbering
+    // above keeps that walk spatially coherent.
+    OptimizeVertexCache(indices_, vertices_.size());
+    ReorderVerticesByFirstUse(vertices_, indices_);
+  }
+}
+
+void Mesh::MergeVertices(const VertexWeldSettings &settings) {
+  WeldVertices(vertices_, indices_, vertices_, indices_, settings);
 }
 
 void Mesh::BuildNormal() {
@@ -83,190 +117,47 @@ void Mesh::BuildNormal() {
   }
 }
 
-void Mesh::BuildTangent() {
-  if (!indices_.size() || !vertices_.size()) {
-    return;
-  }
-
-  BuildNormal();
-
-  std::vector<Vertex> vertices(indices_.size());
-  for (int i = 0; i < indices_.size(); i++) {
-    vertices[i] = vertices_[indices_[i]];
-    indices_[i] = i;
+void Mesh::BuildTangent(const MeshBuildOptions &options) {
+  // Tangents are generated on the indexed mesh, so equal vertices have to be
+  // welded first. Stale tangents must not keep them apart.
+  for (auto &vertex : vertices_) {
+    vertex.tangent = glm::vec3{0.0f};
+    vertex.signal = 1.0f;
   }
-  vertices_ = vertices;
-
-  SMikkTSpaceInterface interface {};
-
-  interface.m_getNumFaces = [](const SMikkTSpaceContext *context) {
-    auto mesh = reinterpret_cast<Mesh *>(context->m_pUserData);
-    return int(mesh->indices_.size() / 3);
-  };
-
-  interface.m_getNumVerticesOfFace = [](const SMikkTSpaceContext *context,
-                                        const int i_face) { return 3; };
-
-  interface.m_getNormal = [](const SMikkTSpaceContext *context,
-                             float normal_out[], const int i_face,
-                             const int i_vert) {
-    auto mesh = reinterpret_cast<Mesh *>(context->m_pUserData);
-    auto normal = mesh->vertices_[mesh->indices_[i_face * 3 + i_vert]].normal;
-    normal_out[0] = normal.x;
-    normal_out[1] = normal.y;
-    normal_out[2] = normal.z;
-  };
-
-  interface.m_getPosition = [](const SMikkTSpaceContext *context,
-                               float position_out[], const int i_face,
-                               const int i_vert) {
-    auto mesh = reinterpret_cast<Mesh *>(context->m_pUserData);
-    auto position =
-        mesh->vertices_[mesh->indices_[i_face * 3 + i_vert]].position;
-    position_out[0] = position.x;
-    position_out[1] = position.y;
-    position_out[2] = position.z;
-  };
-
-  interface.m_getTexCoord = [](const SMikkTSpaceContext *context,
-                               float texcoord_out[], const int i_face,
-                               const int i_vert) {
-    auto mesh = reinterpret_cast<Mesh *>(context->m_pUserData);
-    auto tex_coord =
-        mesh->vertices_[mesh->indices_[i_face * 3 + i_vert]].tex_coord;
-    texcoord_out[0] = tex_coord.x;
-    texcoord_out[1] = tex_coord.y;
-  };
-
-  interface.m_setTSpaceBasic = [](const SMikkTSpaceContext *context,
-                                  const float tangent[], const float sign,
-                                  const int i_face, const int i_vert) {
-    auto mesh = reinterpret_cast<Mesh *>(context->m_pUserData);
-    auto &vert = mesh->vertices_[i_face * 3 + i_vert];
-    vert.tangent = glm::vec3{tangent[0], tangent[1], tangent[2]};
-    vert.signal = sign;
-  };
-
-  SMikkTSpaceContext context{};
-  context.m_pInterface = &interface;
-  context.m_pUserData = reinterpret_cast<void *>(this);
-
-  if (!genTangSpaceDefault(&context)) {
-    LogWarning("Build MikkTSpace failed.");
+  if (options.merge_vertices) {
+    MergeVertices(options.weld_settings);
   }
 
-  for (auto &vertex : vertices_) {
-    if (std::abs(glm::dot(vertex.normal, vertex.tangent)) > 1e-4f) {
-      vertex.tangent = glm::cross(vertex.normal, glm::vec3{1.0f, 0.0f, 0.0f});
-      if (glm::length(vertex.tangent) < 1e-4f) {
-        vertex.tangent = glm::cross(vertex.normal, glm::vec3{0.0f, 1.0f, 0.0f});
-      }
-      vertex.tangent = glm::normalize(vertex.tangent);
-    }
+  if (GenerateTangents(vertices_, indices_)) {
+    LogWarning("Build MikkTSpace failed.");
   }
-
-  MergeVertices();
 }
 
-int Mesh::LoadObjFile(const std::string &obj_file_path) {
-  tinyobj::ObjReaderConfig reader_config;
-  reader_config.mtl_search_path = "./";  // Path to material files
-
-  tinyobj::ObjReader reader;
-
-  if (!reader.ParseFromFile(obj_file_path, reader_config)) {
-    if (!reader.Error().empty()) {
-      LogWarning("[Load obj, ERROR]: {}", reader.Error());
+int Mesh::LoadObjFile(const std::string &obj_file_path,
+                      const MeshBuildOptions &options) {
+  uint64_t cache_key = 0;
+  const bool use_cache =
+      options.use_cache && !SourceFileKey(obj_file_path, cache_key);
+  if (use_cache) {
+    cache_key = HashCombine(cache_key, HashBuildOptions(options));
+    if (!LoadMeshCache(cache_key, vertices_, indices_)) {
+      return 0;
     }
-    return -1;
   }
 
-  if (!reader.Warning().empty()) {
-    LogWarning("{}", reader.Warning());
-  }
-
-  auto &attrib = reader.GetAttrib();
-  auto &shapes = reader.GetShapes();
-  auto &materials = reader.GetMaterials();
-
   std::vector<Vertex> vertices;
   std::vector<uint32_t> indices;
+  if (ParseObjFile(obj_file_path, vertices, indices)) {
+    return -1;
+  }
 
-  // Loop over shapes
-  for (size_t s = 0; s < shapes.size(); s++) {
-    // Loop over faces(polygon)
-    size_t index_offset = 0;
-    for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-      size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
-
-      // Loop over vertices in the face.
-      std::vector<Vertex> face_vertices;
-      for (size_t v = 0; v < fv; v++) {
-        Vertex vertex{};
-        // access to vertex
-        tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-        tinyobj::real_t vx = attrib.vertices[3 * size_t(idx.vertex_index) + 0];
-        tinyobj::real_t vy = attrib.vertices[3 * size_t(idx.vertex_index) + 1];
-        tinyobj::real_t vz = attrib.vertices[3 * size_t(idx.vertex_index) + 2];
-        vertex.position = {vx, vy, vz};
-        // Check if `normal_index` is zero or positive. negative = no normal
-        // data
-        if (idx.normal_index >= 0) {
-          tinyobj::real_t nx = attrib.normals[3 * size_t(idx.normal_index) + 0];
-          tinyobj::real_t ny = attrib.normals[3 * size_t(idx.normal_index) + 1];
-          tinyobj::real_t nz = attrib.normals[3 * size_t(idx.normal_index) + 2];
-          vertex.normal = {nx, ny, nz};
-        } else {
-          vertex.normal = {0.0f, 0.0f, 0.0f};
-        }
-
-        // Check if `texcoord_index` is zero or positive. negative = no texcoord
-        // data
-        if (idx.texcoord_index >= 0) {
-          tinyobj::real_t tx =
-              attrib.texcoords[2 * size_t(idx.texcoord_index) + 0];
-          tinyobj::real_t ty =
-              attrib.texcoords[2 * size_t(idx.texcoord_index) + 1];
-          vertex.tex_coord = {tx, ty};
-        }
-        face_vertices.push_back(vertex);
-      }
+  vertices_ = std::move(vertices);
+  indices_ = std::move(indices);
+  Build(options);
 
-      for (int i = 1; i < face_vertices.size() - 1; i++) {
-        Vertex v0 = face_vertices[0];
-        Vertex v1 = face_vertices[i];
-        Vertex v2 = face_vertices[i + 1];
-        auto geometry_normal = glm::normalize(
-            glm::cross(v1.position - v0.position, v2.position - v0.position));
-        if (v0.normal == glm::vec3{0.0f, 0.0f, 0.0f}) {
-          v0.normal = geometry_normal;
-        } else if (glm::dot(geometry_normal, v0.normal) < 0.0f) {
-          v0.normal = -v0.normal;
-        }
-        if (v1.normal == glm::vec3{0.0f, 0.0f, 0.0f}) {
-          v1.normal = geometry_normal;
-        } else if (glm::dot(geometry_normal, v1.normal) < 0.0f) {
-          v1.normal = -v1.normal;
-        }
-        if (v2.normal == glm::vec3{0.0f, 0.0f, 0.0f}) {
-          v2.normal = geometry_normal;
-        } else if (glm::dot(geometry_normal, v2.normal) < 0.0f) {
-          v2.normal = -v2.normal;
-        }
-        indices.push_back(vertices.size());
-        indices.push_back(vertices.size() + 1);
-        indices.push_back(vertices.size() + 2);
-        vertices.push_back(v0);
-        vertices.push_back(v1);
-        vertices.push_back(v2);
-      }
-
-      index_offset += fv;
-    }
+  if (use_cache) {
+    SaveMeshCache(cache_key, vertices_, indices_);
   }
-  vertices_ = vertices;
-  indices_ = indices;
-  BuildTangent();
   return 0;
 }
 
@@ -303,45 +194,20 @@ int Mesh::SaveObjFile(const std::string &obj_file_path) const {
 int Mesh::LoadFromHeightMap(const Texture &height_map,
                             float precision,
                             float height_scale,
-                            float height_offset) {
-  int width = height_map.Width() * precision;
-  int height = height_map.Height() * precision;
-  float inv_width = 1.0f / width;
-  float inv_height = 1.0f / height;
-  glm::vec3 scale = {inv_width, height_scale, inv_height};
-  std::vector<Vertex> vertices((width + 1) * (height + 1), Vertex{});
-  std::vector<uint32_t> indices(width * height * 6, 0);
-
-  for (int i = 0; i <= width; i++) {
-    for (int j = 0; j <= height; j++) {
-      glm::vec4 color =
-          height_map.Sample((float(i)) * inv_width, (float(j)) * inv_height,
-                            AddressMode::BlackBorder);
-      float h = color.r * 0.299f + color.g * 0.587f + color.b * 0.114f;
-      vertices[j * (width + 1) + i].position =
-          glm::vec3{float(i), h, float(j)} * scale +
-          glm::vec3{0.0f, height_offset, 0.0f};
-      vertices[j * (width + 1) + i].tex_coord = {float(i) * inv_width,
-                                                 float(j) * inv_height};
-    }
-  }
-
-  for (int i = 0; i < width; i++) {
-    for (int j = 0; j < height; j++) {
-      indices[(j * width + i) * 6] = j * (width + 1) + i;
-      indices[(j * width + i) * 6 + 1] = (j + 1) * (width + 1) + i;
-      indices[(j * width + i) * 6 + 2] = j * (width + 1) + i + 1;
-      indices[(j * width + i) * 6 + 3] = (j + 1) * (width + 1) + i + 1;
-      indices[(j * width + i) * 6 + 4] = j * (width + 1) + i + 1;
-      indices[(j * width + i) * 6 + 5] = (j + 1) * (width + 1) + i;
-    }
-  }
-
-  CalculateNormals(vertices, indices);
-
-  vertices_ = vertices;
-  indices_ = indices;
-  BuildTangent();
+                            float height_offset,
+                            const MeshBuildOptions &options) {
+  HeightField height_field(height_map, precision, height_scale,
+                           height_offset);
+  height_field.BuildPatch(0, 0, height_field.Width(), height_field.Height(), 1,
+                          0.0f, vertices_, indices_);
+
+  // The height field already provides smooth normals and tangents, and its
+  // grid has no duplicated vertices to weld.
+  MeshBuildOptions build_options = options;
+  build_options.has_normals = true;
+  build_options.has_tangents = true;
+  build_options.merge_vertices = false;
+  Build(build_options);
 
   return 0;
 }
@@ -1,23 +1,60 @@
 #pragma once
 
+#include "sparks/assets/height_field.h"
+#include "sparks/assets/mesh_cache.h"
+#include "sparks/assets/mesh_optimizer.h"
+#include "sparks/assets/obj_parser.h"
+#include "sparks/assets/tangent_space.h"
 #include "sparks/assets/texture.h"
 #include "sparks/assets/vertex.h"
+#include "sparks/assets/vertex_weld.h"
 #include "vector"
 
 namespace sparks {
+
+// Declares which vertex attributes the caller already provides and which
+// processing stages a Mesh runs on construction or load. The defaults treat
+// every attribute as missing and run the whole pipeline.
+struct MeshBuildOptions {
+  bool has_normals{false};
+  bool has_tangents{false};
+  // Fills in normals of zero length with the averaged face normals. Ignored
+  // if has_normals is set.
+  bool build_normals{true};
+  // Generates MikkTSpace tangents. Ignored if has_tangents is set.
+  bool build_tangents{true};
+  // Welds equal vertices. Tangent generation relies on welded input to
+  // process connected components independently.
+  bool merge_vertices{true};
+  VertexWeldSettings weld_settings{};
+  // Sorts triangles along a Morton curve and renumbers vertices by first use,
+  // so that neighbouring triangles share cache lines during hit shading and
+  // BLAS traversal.
+  bool optimize_locality{true};
+  // Additionally reorders the triangles for the post-transform vertex cache
+  // of the raster pipeline. Requires optimize_locality.
+  bool optimize_vertex_cache{false};
+  // Loaders keep their processed output in the disk cache and reuse it as
+  // long as the source file and the options above are unchanged.
+  bool use_cache{true};
+};
+
 class Mesh {
  public:
   Mesh(const std::vector<Vertex> &vertices = {},
-       const std::vector<uint32_t> &indices = {});
+       const std::vector<uint32_t> &indices = {},
+       const MeshBuildOptions &options = {});
 
-  int LoadObjFile(const std::string &obj_file_path);
+  int LoadObjFile(const std::string &obj_file_path,
+                  const MeshBuildOptions &options = {});
 
   int SaveObjFile(const std::string &obj_file_path) const;
 
   int LoadFromHeightMap(const Texture &height_map,
                         float precision = 1.0f,
                         float height_scale = 1.0f,
-                        float height_offset = 0.0f);
+                        float height_offset = 0.0f,
+                        const MeshBuildOptions &options = {});
 
   const std::vector<Vertex> &Vertices() const {
     return vertices_;
@@ -27,12 +64,16 @@ class Mesh {
     return indices_;
   }
 
+  void MergeVertices(const VertexWeldSettings &settings = {});
+
  private:
-  void MergeVertices();
+  void Build(const MeshBuildOptions &options);
 
   void BuildNormal();
 
-  void BuildTangent();
+  void BuildTangent(const MeshBuildOptions &options);
+
+  void OptimizeLayout(const MeshBuildOptions &options);
 
   std::vector<Vertex> vertices_;
   std::vector<uint32_t> indices_;
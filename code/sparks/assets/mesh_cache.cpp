@@ -0,0 +1,79 @@
+#include "sparks/assets/mesh_cache.h"
+
+#include "cstring"
+#include "filesystem"
+
+namespace sparks {
+
+namespace {
+
+constexpr uint32_t kMeshCacheMagic = 0x4d4b5053;  // "SPKM"
+
+struct MeshCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint32_t vertex_size;
+  uint32_t reserved;
+  uint64_t num_vertices;
+  uint64_t num_indices;
+};
+
+std::string MeshCachePath(uint64_t key) {
+  return CacheFilePath("mesh", key);
+}
+
+}  // namespace
+
+int LoadMeshCache(uint64_t key,
+                  std::vector<Vertex> &vertices,
+                  std::vector<uint32_t> &indices) {
+  std::string path = MeshCachePath(key);
+  MappedFile file;
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec) || file.Open(path)) {
+    return -1;
+  }
+
+  MeshCacheHeader header{};
+  if (file.Size() < sizeof(header)) {
+    return -1;
+  }
+  std::memcpy(&header, file.Data(), sizeof(header));
+  if (header.magic != kMeshCacheMagic ||
+      header.version != kMeshCacheVersion || header.key != key ||
+      header.vertex_size != sizeof(Vertex)) {
+    return -1;
+  }
+  const uint64_t vertex_bytes = header.num_vertices * sizeof(Vertex);
+  const uint64_t index_bytes = header.num_indices * sizeof(uint32_t);
+  if (file.Size() != sizeof(header) + vertex_bytes + index_bytes) {
+    LogWarning("Ignoring truncated mesh cache: {}", path);
+    return -1;
+  }
+
+  const char *data = file.Data() + sizeof(header);
+  vertices.resize(header.num_vertices);
+  std::memcpy(vertices.data(), data, vertex_bytes);
+  indices.resize(header.num_indices);
+  std::memcpy(indices.data(), data + vertex_bytes, index_bytes);
+  return 0;
+}
+
+int SaveMeshCache(uint64_t key,
+                  const std::vector<Vertex> &vertices,
+                  const std::vector<uint32_t> &indices) {
+  MeshCacheHeader header{};
+  header.magic = kMeshCacheMagic;
+  header.version = kMeshCacheVersion;
+  header.key = key;
+  header.vertex_size = sizeof(Vertex);
+  header.num_vertices = vertices.size();
+  header.num_indices = indices.size();
+  return WriteCacheFile(MeshCachePath(key),
+                        {{&header, sizeof(header)},
+                         {vertices.data(), vertices.size() * sizeof(Vertex)},
+                         {indices.data(), indices.size() * sizeof(uint32_t)}});
+}
+
+}  // namespace sparks
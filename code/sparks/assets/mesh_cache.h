@@ -0,0 +1,22 @@
+#pragma once
+
+#include "sparks/assets/vertex.h"
+#include "vector"
+
+namespace sparks {
+
+// Bump whenever mesh processing changes its output, stale entries are then
+// ignored.
+constexpr uint32_t kMeshCacheVersion = 2;
+
+// Reads the processed vertex and index arrays stored under key. Returns -1 if
+// there is no valid entry.
+int LoadMeshCache(uint64_t key,
+                  std::vector<Vertex> &vertices,
+                  std::vector<uint32_t> &indices);
+
+int SaveMeshCache(uint64_t key,
+                  const std::vector<Vertex> &vertices,
+                  const std::vector<uint32_t> &indices);
+
+}  // namespace sparks
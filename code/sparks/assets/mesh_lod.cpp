@@ -0,0 +1,70 @@
+#include "sparks/assets/mesh_lod.h"
+
+#include "algorithm"
+
+namespace sparks {
+
+namespace {
+// A level that keeps more than this fraction of the triangles of the previous
+// one is not worth its memory.
+constexpr float kMinReduction = 0.85f;
+}  // namespace
+
+void BuildMeshLods(const Mesh &mesh,
+                   const MeshLodSettings &settings,
+                   std::vector<MeshLod> &lods) {
+  lods.clear();
+  if (!settings.max_levels ||
+      mesh.Indices().size() / 3 <= settings.min_triangles) {
+    return;
+  }
+
+  glm::vec3 lower{mesh.Vertices()[0].position};
+  glm::vec3 upper{lower};
+  for (auto &vertex : mesh.Vertices()) {
+    lower = glm::min(lower, vertex.position);
+    upper = glm::max(upper, vertex.position);
+  }
+  glm::vec3 extent = upper - lower;
+  float max_extent = std::max(extent.x, std::max(extent.y, extent.z));
+  if (max_extent <= 0.0f) {
+    return;
+  }
+
+  // The levels reference a subset of the source attributes, nothing has to be
+  // rebuilt besides the memory layout.
+  MeshBuildOptions options;
+  options.has_normals = true;
+  options.has_tangents = true;
+  options.merge_vertices = false;
+
+  std::vector<Vertex> vertices = mesh.Vertices();
+  std::vector<uint32_t> indices = mesh.Indices();
+  float error = 0.0f;
+  for (uint32_t level = 0; level < settings.max_levels; level++) {
+    size_t num_triangles = indices.size() / 3;
+    float remaining_error = settings.max_error - error / max_extent;
+    if (num_triangles <= settings.min_triangles || remaining_error <= 0.0f) {
+      break;
+    }
+
+    MeshSimplifySettings simplify_settings;
+    simplify_settings.target_index_count =
+        size_t(num_triangles * settings.reduction) * 3;
+    simplify_settings.max_error = remaining_error;
+    std::vector<uint32_t> simplified;
+    float level_error = 0.0f;
+    SimplifyMesh(vertices, indices, simplify_settings, simplified,
+                 &level_error);
+    if (simplified.size() / 3 > num_triangles * kMinReduction) {
+      break;
+    }
+
+    ReorderVerticesByFirstUse(vertices, simplified);
+    indices = std::move(simplified);
+    error += level_error;
+    lods.push_back({Mesh(vertices, indices, options), error});
+  }
+}
+
+}  // namespace sparks
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "sparks/assets/mesh.h"
+#include "sparks/assets/mesh_simplifier.h"
+#include "vector"
+
+namespace sparks {
+
+struct MeshLodSettings {
+  // Number of simplified levels generated below the source mesh, 0 disables
+  // the LOD chain.
+  uint32_t max_levels{4};
+  // Triangle count of every level relative to the previous one.
+  float reduction{0.5f};
+  // Levels are only generated for meshes with more triangles than this.
+  uint32_t min_triangles{4096};
+  // Largest accumulated geometric error, relative to the mesh extent.
+  float max_error{0.05f};
+};
+
+struct MeshLod {
+  Mesh mesh;
+  // Geometric error against the source mesh in object space units.
+  float error;
+};
+
+// Builds progressively simplified levels of a mesh, finest first. Every level
+// is simplified from the previous one, the chain ends early once the error
+// budget is spent or a level cannot be reduced any further.
+void BuildMeshLods(const Mesh &mesh,
+                   const MeshLodSettings &settings,
+                   std::vector<MeshLod> &lods);
+
+}  // namespace sparks
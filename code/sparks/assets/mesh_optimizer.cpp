@@ -0,0 +1,191 @@
+#include "sparks/assets/mesh_optimizer.h"
+
+#include "algorithm"
+#include "sparks/utils/parallel.h"
+
+namespace sparks {
+
+namespace {
+
+// Spreads the lower 21 bits of value so that two zero bits follow each one.
+uint64_t SpreadBits3(uint64_t value) {
+  value &= 0x1fffffull;
+  value = (value | (value << 32)) & 0x001f00000000ffffull;
+  value = (value | (value << 16)) & 0x001f0000ff0000ffull;
+  value = (value | (value << 8)) & 0x100f00f00f00f00full;
+  value = (value | (value << 4)) & 0x10c30c30c30c30c3ull;
+  value = (value | (value << 2)) & 0x1249249249249249ull;
+  return value;
+}
+
+uint64_t MortonCode(const glm::vec3 &unit_position) {
+  const float kScale = float((1u << 21) - 1);
+  glm::vec3 p = glm::clamp(unit_position, 0.0f, 1.0f) * kScale;
+  return SpreadBits3(uint64_t(p.x)) | (SpreadBits3(uint64_t(p.y)) << 1) |
+         (SpreadBits3(uint64_t(p.z)) << 2);
+}
+
+}  // namespace
+
+void SortTrianglesByMorton(const std::vector<Vertex> &vertices,
+                           std::vector<uint32_t> &indices) {
+  const size_t num_triangles = indices.size() / 3;
+  if (num_triangles < 2) {
+    return;
+  }
+
+  glm::vec3 lower{vertices[indices[0]].position};
+  glm::vec3 upper{lower};
+  for (uint32_t index : indices) {
+    lower = glm::min(lower, vertices[index].position);
+    upper = glm::max(upper, vertices[index].position);
+  }
+  glm::vec3 extent = upper - lower;
+  glm::vec3 inv_extent{extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+                       extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+                       extent.z > 0.0f ? 1.0f / extent.z : 0.0f};
+
+  // Ties are broken by the original order, so the result is deterministic.
+  std::vector<std::pair<uint64_t, uint32_t>> keys(num_triangles);
+  ParallelFor(num_triangles, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; i++) {
+      glm::vec3 centroid = (vertices[indices[i * 3]].position +
+                            vertices[indices[i * 3 + 1]].position +
+                            vertices[indices[i * 3 + 2]].position) *
+                           (1.0f / 3.0f);
+      keys[i] = {MortonCode((centroid - lower) * inv_extent), uint32_t(i)};
+    }
+  });
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<uint32_t> sorted_indices(num_triangles * 3);
+  ParallelFor(num_triangles, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; i++) {
+      uint32_t triangle = keys[i].second;
+      for (int j = 0; j < 3; j++) {
+        sorted_indices[i * 3 + j] = indices[triangle * 3 + j];
+      }
+    }
+  });
+  indices = std::move(sorted_indices);
+}
+
+void OptimizeVertexCache(std::vector<uint32_t> &indices,
+                         size_t num_vertices,
+                         uint32_t cache_size) {
+  const size_t num_triangles = indices.size() / 3;
+  if (num_triangles < 2 || !num_vertices) {
+    return;
+  }
+
+  // Vertex to triangle adjacency in compressed rows.
+  std::vector<uint32_t> live_triangles(num_vertices, 0);
+  for (size_t i = 0; i < num_triangles * 3; i++) {
+    live_triangles[indices[i]]++;
+  }
+  std::vector<uint32_t> adjacency_offsets(num_vertices + 1, 0);
+  for (size_t v = 0; v < num_vertices; v++) {
+    adjacency_offsets[v + 1] = adjacency_offsets[v] + live_triangles[v];
+  }
+  std::vector<uint32_t> adjacency(adjacency_offsets[num_vertices]);
+  {
+    std::vector<uint32_t> cursor(adjacency_offsets.begin(),
+                                 adjacency_offsets.end() - 1);
+    for (size_t i = 0; i < num_triangles * 3; i++) {
+      adjacency[cursor[indices[i]]++] = uint32_t(i / 3);
+    }
+  }
+
+  std::vector<uint32_t> cache_time(num_vertices, 0);
+  std::vector<bool> emitted(num_triangles, false);
+  std::vector<uint32_t> dead_end_stack;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> output;
+  output.reserve(num_triangles * 3);
+
+  uint32_t time = cache_size + 1;
+  size_t cursor = 0;
+  int64_t fanning_vertex = 0;
+  while (fanning_vertex >= 0) {
+    candidates.clear();
+    for (uint32_t a = adjacency_offsets[fanning_vertex];
+         a < adjacency_offsets[fanning_vertex + 1]; a++) {
+      uint32_t triangle = adjacency[a];
+      if (emitted[triangle]) {
+        continue;
+      }
+      for (int j = 0; j < 3; j++) {
+        uint32_t v = indices[triangle * 3 + j];
+        output.push_back(v);
+        dead_end_stack.push_back(v);
+        candidates.push_back(v);
+        live_triangles[v]--;
+        if (time - cache_time[v] > cache_size) {
+          cache_time[v] = time++;
+        }
+      }
+      emitted[triangle] = true;
+    }
+
+    // Prefers the candidate that stays longest in the cache while all of its
+    // remaining triangles are emitted.
+    fanning_vertex = -1;
+    int64_t best_priority = -1;
+    for (uint32_t v : candidates) {
+      if (!live_triangles[v]) {
+        continue;
+      }
+      int64_t priority = 0;
+      if (time - cache_time[v] + 2 * live_triangles[v] <= cache_size) {
+        priority = time - cache_time[v];
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        fanning_vertex = v;
+      }
+    }
+
+    if (fanning_vertex < 0) {
+      while (!dead_end_stack.empty()) {
+        uint32_t v = dead_end_stack.back();
+        dead_end_stack.pop_back();
+        if (live_triangles[v]) {
+          fanning_vertex = v;
+          break;
+        }
+      }
+    }
+
+    if (fanning_vertex < 0) {
+      while (cursor < num_vertices && !live_triangles[cursor]) {
+        cursor++;
+      }
+      if (cursor < num_vertices) {
+        fanning_vertex = int64_t(cursor);
+      }
+    }
+  }
+
+  // Degenerate leftovers (e.g. a trailing partial triangle) are kept as is.
+  output.insert(output.end(), indices.begin() + num_triangles * 3,
+                indices.end());
+  indices = std::move(output);
+}
+
+void ReorderVerticesByFirstUse(std::vector<Vertex> &vertices,
+                               std::vector<uint32_t> &indices) {
+  const uint32_t kUnassigned = ~0u;
+  std::vector<uint32_t> remap(vertices.size(), kUnassigned);
+  std::vector<Vertex> reordered_vertices;
+  reordered_vertices.reserve(vertices.size());
+  for (auto &index : indices) {
+    if (remap[index] == kUnassigned) {
+      remap[index] = uint32_t(reordered_vertices.size());
+      reordered_vertices.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices = std::move(reordered_vertices);
+}
+
+}  // namespace sparks
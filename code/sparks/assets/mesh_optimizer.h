@@ -0,0 +1,26 @@
+#pragma once
+
+#include "sparks/assets/vertex.h"
+#include "vector"
+
+namespace sparks {
+
+// Reorders the triangles along a Morton curve over their centroids so that
+// spatially adjacent triangles are close in the index buffer.
+void SortTrianglesByMorton(const std::vector<Vertex> &vertices,
+                           std::vector<uint32_t> &indices);
+
+// Reorders the triangles for the post-transform vertex cache of the raster
+// pipeline with Tipsify (Sander et al. 2007). Vertices are expected to be
+// numbered by first use, the walk restarts from the lowest index with
+// remaining triangles at dead ends so the input locality is preserved.
+void OptimizeVertexCache(std::vector<uint32_t> &indices,
+                         size_t num_vertices,
+                         uint32_t cache_size = 16);
+
+// Renumbers the vertices in the order of their first reference in indices,
+// unreferenced vertices are dropped.
+void ReorderVerticesByFirstUse(std::vector<Vertex> &vertices,
+                               std::vector<uint32_t> &indices);
+
+}  // namespace sparks
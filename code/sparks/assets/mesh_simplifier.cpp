@@ -0,0 +1,498 @@
+#include "sparks/assets/mesh_simplifier.h"
+
+#include "algorithm"
+#include "cmath"
+#include "limits"
+#include "sparks/assets/vertex_weld.h"
+
+namespace sparks {
+
+namespace {
+
+// Border and seam edges add a plane perpendicular to their triangle, so that
+// sliding along them is free while moving away from them is not.
+constexpr double kBorderWeight = 10.0;
+constexpr double kSeamWeight = 1.0;
+// A collapse is rejected if it turns a triangle by more than ~75 degrees.
+constexpr float kMinNormalCosine = 0.25f;
+
+enum class VertexKind : uint8_t { Manifold, Border, Seam, Locked };
+
+struct Quadric {
+  double a00{}, a01{}, a02{}, a11{}, a12{}, a22{};
+  double b0{}, b1{}, b2{};
+  double c{};
+  double weight{};
+
+  void AddPlane(const glm::vec3 &normal, float distance, double w) {
+    double x = normal.x, y = normal.y, z = normal.z, d = distance;
+    a00 += w * x * x;
+    a01 += w * x * y;
+    a02 += w * x * z;
+    a11 += w * y * y;
+    a12 += w * y * z;
+    a22 += w * z * z;
+    b0 += w * x * d;
+    b1 += w * y * d;
+    b2 += w * z * d;
+    c += w * d * d;
+    weight += w;
+  }
+
+  Quadric &operator+=(const Quadric &q) {
+    a00 += q.a00;
+    a01 += q.a01;
+    a02 += q.a02;
+    a11 += q.a11;
+    a12 += q.a12;
+    a22 += q.a22;
+    b0 += q.b0;
+    b1 += q.b1;
+    b2 += q.b2;
+    c += q.c;
+    weight += q.weight;
+    return *this;
+  }
+
+  // Weighted mean of the squared distances to the accumulated planes.
+  double Error(const glm::vec3 &p) const {
+    if (weight <= 0.0) {
+      return 0.0;
+    }
+    double x = p.x, y = p.y, z = p.z;
+    double e = a00 * x * x + a11 * y * y + a22 * z * z +
+               2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+               2.0 * (b0 * x + b1 * y + b2 * z) + c;
+    return std::abs(e) / weight;
+  }
+};
+
+struct Collapse {
+  double cost{std::numeric_limits<double>::infinity()};
+  // Positional part of cost, the geometric error the collapse introduces.
+  double error{};
+  uint32_t from{};
+  uint32_t to{};
+  // The sibling wedge moved along for seam collapses, equal to from/to
+  // otherwise.
+  uint32_t sibling_from{};
+  uint32_t sibling_to{};
+};
+
+uint64_t EdgeKey(uint32_t a, uint32_t b) {
+  return (uint64_t(a) << 32) | b;
+}
+
+// Open-addressing set of directed edges, rebuilt on every pass.
+class EdgeSet {
+ public:
+  void Reset(size_t num_edges) {
+    size_t capacity = 16;
+    while (capacity < num_edges * 2) {
+      capacity *= 2;
+    }
+    slots_.assign(capacity, kEmptySlot);
+  }
+
+  // Returns false if the edge was present already.
+  bool Insert(uint32_t a, uint32_t b) {
+    uint64_t key = EdgeKey(a, b);
+    size_t mask = slots_.size() - 1;
+    for (size_t slot = HashMix64(key) & mask;; slot = (slot + 1) & mask) {
+      if (slots_[slot] == kEmptySlot) {
+        slots_[slot] = key;
+        return true;
+      }
+      if (slots_[slot] == key) {
+        return false;
+      }
+    }
+  }
+
+  bool Contains(uint32_t a, uint32_t b) const {
+    uint64_t key = EdgeKey(a, b);
+    size_t mask = slots_.size() - 1;
+    for (size_t slot = HashMix64(key) & mask;; slot = (slot + 1) & mask) {
+      if (slots_[slot] == kEmptySlot) {
+        return false;
+      }
+      if (slots_[slot] == key) {
+        return true;
+      }
+    }
+  }
+
+ private:
+  // Vertex indices never reach 0xffffffff, so this key is never inserted.
+  static constexpr uint64_t kEmptySlot = ~0ull;
+  std::vector<uint64_t> slots_;
+};
+
+void AddEdgeQuadric(const glm::vec3 &p0,
+                    const glm::vec3 &p1,
+                    const glm::vec3 &p2,
+                    double weight,
+                    Quadric &q0,
+                    Quadric &q1) {
+  glm::vec3 edge = p1 - p0;
+  glm::vec3 face_normal = glm::cross(edge, p2 - p0);
+  glm::vec3 normal = glm::cross(edge, face_normal);
+  float length = glm::length(normal);
+  if (length == 0.0f) {
+    return;
+  }
+  normal /= length;
+  double w = weight * glm::dot(edge, edge);
+  q0.AddPlane(normal, -glm::dot(normal, p0), w);
+  q1.AddPlane(normal, -glm::dot(normal, p0), w);
+}
+
+}  // namespace
+
+size_t SimplifyMesh(const std::vector<Vertex> &vertices,
+                    const std::vector<uint32_t> &indices,
+                    const MeshSimplifySettings &settings,
+                    std::vector<uint32_t> &result,
+                    float *result_error) {
+  result.assign(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+  if (result_error) {
+    *result_error = 0.0f;
+  }
+  const uint32_t num_vertices = vertices.size();
+  if (result.size() <= settings.target_index_count || !num_vertices) {
+    return result.size();
+  }
+
+  // Errors are measured in the unit cube, i.e. relative to the mesh extent.
+  glm::vec3 lower{vertices[0].position};
+  glm::vec3 upper{lower};
+  for (auto &vertex : vertices) {
+    lower = glm::min(lower, vertex.position);
+    upper = glm::max(upper, vertex.position);
+  }
+  glm::vec3 extent = upper - lower;
+  float max_extent = std::max(extent.x, std::max(extent.y, extent.z));
+  float scale = max_extent > 0.0f ? 1.0f / max_extent : 1.0f;
+  std::vector<glm::vec3> positions(num_vertices);
+  std::vector<uint64_t> position_hashes(num_vertices);
+  for (uint32_t i = 0; i < num_vertices; i++) {
+    positions[i] = (vertices[i].position - lower) * scale;
+    // Adding zero turns -0.0f into 0.0f, the two compare equal.
+    glm::vec3 position = vertices[i].position + glm::vec3{0.0f};
+    position_hashes[i] = HashBytes(&position, sizeof(position));
+  }
+
+  // Vertices sharing a position form a group represented by its first
+  // vertex. Topology is evaluated on groups, attributes on vertices.
+  std::vector<uint32_t> group = FindFirstEqualKeys(
+      position_hashes, [&vertices](uint32_t a, uint32_t b) {
+        return vertices[a].position == vertices[b].position;
+      });
+
+  // Classifies the edge leaving every corner: border edges have no opposite
+  // edge between the same positions, seam edges have one between different
+  // vertices only.
+  const uint8_t kBorderEdge = 1;
+  const uint8_t kSeamEdge = 2;
+  EdgeSet index_edges;
+  EdgeSet position_edges;
+  std::vector<uint8_t> corner_edges;
+  std::vector<uint8_t> non_manifold(num_vertices);
+  auto build_edges = [&]() {
+    index_edges.Reset(result.size());
+    position_edges.Reset(result.size());
+    std::fill(non_manifold.begin(), non_manifold.end(), 0);
+    for (size_t i = 0; i < result.size(); i++) {
+      uint32_t a = result[i];
+      uint32_t b = result[i - i % 3 + (i + 1) % 3];
+      index_edges.Insert(a, b);
+      if (!position_edges.Insert(group[a], group[b])) {
+        non_manifold[group[a]] = 1;
+        non_manifold[group[b]] = 1;
+      }
+    }
+    corner_edges.assign(result.size(), 0);
+    for (size_t i = 0; i < result.size(); i++) {
+      uint32_t a = result[i];
+      uint32_t b = result[i - i % 3 + (i + 1) % 3];
+      if (!position_edges.Contains(group[b], group[a])) {
+        corner_edges[i] = kBorderEdge;
+      } else if (!index_edges.Contains(b, a)) {
+        corner_edges[i] = kSeamEdge;
+      }
+    }
+  };
+
+  std::vector<Quadric> quadrics(num_vertices);
+  build_edges();
+  for (size_t i = 0; i < result.size(); i += 3) {
+    for (int j = 0; j < 3; j++) {
+      uint32_t a = result[i + j];
+      uint32_t b = result[i + (j + 1) % 3];
+      uint32_t c = result[i + (j + 2) % 3];
+      if (j == 0) {
+        glm::vec3 normal = glm::cross(positions[b] - positions[a],
+                                      positions[c] - positions[a]);
+        float area = glm::length(normal);
+        if (area > 0.0f) {
+          normal /= area;
+          float distance = -glm::dot(normal, positions[a]);
+          for (int k = 0; k < 3; k++) {
+            quadrics[group[result[i + k]]].AddPlane(normal, distance,
+                                                    area * 0.5);
+          }
+        }
+      }
+      if (corner_edges[i + j] == kBorderEdge) {
+        AddEdgeQuadric(positions[a], positions[b], positions[c], kBorderWeight,
+                       quadrics[group[a]], quadrics[group[b]]);
+      } else if (corner_edges[i + j] == kSeamEdge) {
+        AddEdgeQuadric(positions[a], positions[b], positions[c], kSeamWeight,
+                       quadrics[group[a]], quadrics[group[b]]);
+      }
+    }
+  }
+
+  const double max_error_sq = double(settings.max_error) * settings.max_error;
+  const size_t target_triangles = settings.target_index_count / 3;
+  double result_error_sq = 0.0;
+
+  std::vector<VertexKind> kinds(num_vertices);
+  std::vector<uint32_t> open_out(num_vertices), open_in(num_vertices);
+  std::vector<uint32_t> seam_out(num_vertices), seam_in(num_vertices);
+  std::vector<uint32_t> wedge_count(num_vertices);
+  std::vector<uint32_t> wedges(num_vertices * 2);
+  std::vector<uint32_t> group_triangle_offsets(num_vertices + 1);
+  std::vector<uint32_t> group_triangles;
+  std::vector<Collapse> best(num_vertices);
+  std::vector<uint8_t> locked(num_vertices);
+  std::vector<uint32_t> collapse_remap(num_vertices);
+
+  while (result.size() / 3 > target_triangles) {
+    const size_t num_triangles = result.size() / 3;
+    build_edges();
+
+    std::fill(open_out.begin(), open_out.end(), 0);
+    std::fill(open_in.begin(), open_in.end(), 0);
+    std::fill(seam_out.begin(), seam_out.end(), 0);
+    std::fill(seam_in.begin(), seam_in.end(), 0);
+    std::fill(wedge_count.begin(), wedge_count.end(), 0);
+
+    std::fill(group_triangle_offsets.begin(), group_triangle_offsets.end(), 0);
+    std::vector<uint8_t> used(num_vertices, 0);
+    for (size_t i = 0; i < result.size(); i++) {
+      uint32_t a = result[i];
+      uint32_t b = result[i - i % 3 + (i + 1) % 3];
+      if (corner_edges[i] == kBorderEdge) {
+        open_out[group[a]]++;
+        open_in[group[b]]++;
+      } else if (corner_edges[i] == kSeamEdge) {
+        seam_out[a]++;
+        seam_in[b]++;
+      }
+      if (!used[a]) {
+        used[a] = 1;
+        uint32_t g = group[a];
+        if (wedge_count[g] < 2) {
+          wedges[g * 2 + wedge_count[g]] = a;
+        }
+        wedge_count[g]++;
+      }
+      // A triangle touches a group at most once unless it is degenerate,
+      // those were removed at the end of the previous pass.
+      group_triangle_offsets[group[a] + 1]++;
+    }
+    for (uint32_t g = 0; g < num_vertices; g++) {
+      group_triangle_offsets[g + 1] += group_triangle_offsets[g];
+    }
+    group_triangles.resize(result.size());
+    {
+      std::vector<uint32_t> cursor(group_triangle_offsets.begin(),
+                                   group_triangle_offsets.end() - 1);
+      for (size_t i = 0; i < result.size(); i++) {
+        group_triangles[cursor[group[result[i]]]++] = uint32_t(i / 3);
+      }
+    }
+
+    for (uint32_t g = 0; g < num_vertices; g++) {
+      if (!wedge_count[g] || group[g] != g) {
+        continue;
+      }
+      VertexKind kind = VertexKind::Locked;
+      if (non_manifold[g]) {
+        kind = VertexKind::Locked;
+      } else if (open_out[g] || open_in[g]) {
+        if (open_out[g] == 1 && open_in[g] == 1 && wedge_count[g] == 1) {
+          kind = VertexKind::Border;
+        }
+      } else if (wedge_count[g] == 1) {
+        kind = VertexKind::Manifold;
+      } else if (wedge_count[g] == 2) {
+        uint32_t w0 = wedges[g * 2];
+        uint32_t w1 = wedges[g * 2 + 1];
+        if (seam_out[w0] == 1 && seam_in[w0] == 1 && seam_out[w1] == 1 &&
+            seam_in[w1] == 1) {
+          kind = VertexKind::Seam;
+        }
+      }
+      kinds[g] = kind;
+    }
+
+    auto consider = [&](uint32_t a, uint32_t b, bool border, bool seam) {
+      uint32_t ga = group[a];
+      uint32_t gb = group[b];
+      VertexKind kind = kinds[ga];
+      if (kind == VertexKind::Locked ||
+          (kind == VertexKind::Border && !border) ||
+          (kind == VertexKind::Seam && !seam)) {
+        return;
+      }
+      Collapse collapse;
+      collapse.from = collapse.sibling_from = a;
+      collapse.to = collapse.sibling_to = b;
+      if (kind == VertexKind::Seam) {
+        uint32_t sibling = wedges[ga * 2] == a ? wedges[ga * 2 + 1]
+                                               : wedges[ga * 2];
+        collapse.sibling_from = sibling;
+        if (wedge_count[gb] == 1) {
+          collapse.sibling_to = b;
+        } else if (wedge_count[gb] == 2) {
+          uint32_t other = wedges[gb * 2] == b ? wedges[gb * 2 + 1]
+                                               : wedges[gb * 2];
+          if (!index_edges.Contains(sibling, other) &&
+              !index_edges.Contains(other, sibling)) {
+            return;
+          }
+          collapse.sibling_to = other;
+        } else {
+          return;
+        }
+      }
+      double error = quadrics[ga].Error(positions[b]);
+      double cost = error;
+      glm::vec3 edge = positions[b] - positions[a];
+      float normal_deviation = std::max(
+          1.0f - glm::dot(vertices[a].normal, vertices[b].normal),
+          1.0f - glm::dot(vertices[collapse.sibling_from].normal,
+                          vertices[collapse.sibling_to].normal));
+      cost += settings.attribute_weight * glm::dot(edge, edge) *
+              std::max(normal_deviation, 0.0f);
+      collapse.cost = cost;
+      collapse.error = error;
+      if (cost < best[ga].cost) {
+        best[ga] = collapse;
+      }
+    };
+
+    std::fill(best.begin(), best.end(), Collapse{});
+    for (size_t i = 0; i < result.size(); i++) {
+      uint32_t a = result[i];
+      uint32_t b = result[i - i % 3 + (i + 1) % 3];
+      if (group[a] == group[b]) {
+        continue;
+      }
+      bool border = corner_edges[i] == kBorderEdge;
+      bool seam = corner_edges[i] == kSeamEdge;
+      consider(a, b, border, seam);
+      consider(b, a, border, seam);
+    }
+
+    std::vector<uint32_t> order;
+    for (uint32_t g = 0; g < num_vertices; g++) {
+      if (best[g].cost <= max_error_sq) {
+        order.push_back(g);
+      }
+    }
+    std::sort(order.begin(), order.end(), [&best](uint32_t a, uint32_t b) {
+      return best[a].cost < best[b].cost;
+    });
+
+    // Rejects collapses that flip or degenerate any remaining triangle.
+    auto flips = [&](uint32_t ga, uint32_t gb, const glm::vec3 &target) {
+      for (uint32_t k = group_triangle_offsets[ga];
+           k < group_triangle_offsets[ga + 1]; k++) {
+        const uint32_t *triangle = &result[group_triangles[k] * 3];
+        glm::vec3 p[3];
+        glm::vec3 q[3];
+        bool collapsed = false;
+        for (int j = 0; j < 3; j++) {
+          uint32_t g = group[triangle[j]];
+          collapsed |= g == gb;
+          p[j] = positions[triangle[j]];
+          q[j] = g == ga ? target : p[j];
+        }
+        if (collapsed) {
+          continue;
+        }
+        glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+        float l0 = glm::length(n0);
+        if (l0 > 0.0f &&
+            glm::dot(n0, n1) <= kMinNormalCosine * l0 * glm::length(n1)) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+    std::fill(locked.begin(), locked.end(), 0);
+    for (uint32_t i = 0; i < num_vertices; i++) {
+      collapse_remap[i] = i;
+    }
+    size_t removed_triangles = 0;
+    size_t num_collapses = 0;
+    for (uint32_t ga : order) {
+      const Collapse &collapse = best[ga];
+      uint32_t gb = group[collapse.to];
+      if (locked[ga] || locked[gb] || flips(ga, gb, positions[collapse.to])) {
+        continue;
+      }
+      collapse_remap[collapse.from] = collapse.to;
+      collapse_remap[collapse.sibling_from] = collapse.sibling_to;
+      quadrics[gb] += quadrics[ga];
+      result_error_sq = std::max(result_error_sq, collapse.error);
+      num_collapses++;
+
+      // Neighbouring groups keep their one-ring unchanged for the flip test
+      // of the remaining collapses in this pass.
+      for (uint32_t k = group_triangle_offsets[ga];
+           k < group_triangle_offsets[ga + 1]; k++) {
+        const uint32_t *triangle = &result[group_triangles[k] * 3];
+        bool collapsed = false;
+        for (int j = 0; j < 3; j++) {
+          locked[group[triangle[j]]] = 1;
+          collapsed |= group[triangle[j]] == gb;
+        }
+        removed_triangles += collapsed;
+      }
+      if (num_triangles - removed_triangles <= target_triangles) {
+        break;
+      }
+    }
+    if (!num_collapses) {
+      break;
+    }
+
+    size_t num_indices = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      uint32_t a = collapse_remap[result[i]];
+      uint32_t b = collapse_remap[result[i + 1]];
+      uint32_t c = collapse_remap[result[i + 2]];
+      if (group[a] == group[b] || group[b] == group[c] ||
+          group[c] == group[a]) {
+        continue;
+      }
+      result[num_indices++] = a;
+      result[num_indices++] = b;
+      result[num_indices++] = c;
+    }
+    result.resize(num_indices);
+  }
+
+  if (result_error) {
+    *result_error = float(std::sqrt(result_error_sq)) * max_extent;
+  }
+  return result.size();
+}
+
+}  // namespace sparks
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "sparks/assets/vertex.h"
+#include "vector"
+
+namespace sparks {
+
+struct MeshSimplifySettings {
+  // Simplification stops once the index count drops to this value.
+  size_t target_index_count{0};
+  // Largest allowed geometric deviation, relative to the largest extent of
+  // the mesh bounding box.
+  float max_error{0.01f};
+  // Weight of the normal deviation of a collapse against its geometric error.
+  float attribute_weight{1.0f};
+};
+
+// Simplifies an indexed triangle mesh with quadric error edge collapses
+// (Garland and Heckbert 1997). Every collapse moves a vertex onto one of its
+// neighbours, so the result indexes the input vertices and keeps their
+// attributes. Vertices sharing a position but not their attributes (e.g. UV
+// seams) only collapse along the seam together, open borders only collapse
+// along the border and non-manifold vertices never move. Returns the number
+// of indices in result, result_error receives the largest geometric error of
+// the applied collapses in object space units.
+size_t SimplifyMesh(const std::vector<Vertex> &vertices,
+                    const std::vector<uint32_t> &indices,
+                    const MeshSimplifySettings &settings,
+                    std::vector<uint32_t> &result,
+                    float *result_error = nullptr);
+
+}  // namespace sparks
@@ -0,0 +1,559 @@
+#include "sparks/assets/obj_parser.h"
+
+#include "algorithm"
+#include "atomic"
+#include "chrono"
+#include "cmath"
+#include "cstring"
+#include "sparks/assets/vertex_weld.h"
+
+namespace sparks {
+
+namespace {
+
+constexpr uint32_t kInvalidIndex = 0xffffffffu;
+constexpr uint64_t kMinChunkSize = 1u << 20;
+
+// Corner flags, a corner without a valid normal never shares its vertex
+// before the final weld since it takes the normal of its own face.
+constexpr uint8_t kCornerHasNormal = 1u;
+constexpr uint8_t kCornerFlipNormal = 2u;
+
+struct ObjCorner {
+  uint32_t position;
+  uint32_t tex_coord;
+  uint32_t normal;
+};
+
+struct ObjChunk {
+  const char *begin;
+  const char *end;
+  uint64_t num_positions{0};
+  uint64_t num_tex_coords{0};
+  uint64_t num_normals{0};
+  uint64_t num_triangles{0};
+  uint64_t position_offset{0};
+  uint64_t tex_coord_offset{0};
+  uint64_t normal_offset{0};
+  uint64_t triangle_offset{0};
+  bool failed{false};
+};
+
+enum class ObjLineType { Other, Position, TexCoord, Normal, Face };
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+const char *SkipSpaces(const char *p, const char *end) {
+  while (p < end && IsSpace(*p)) {
+    p++;
+  }
+  return p;
+}
+
+const char *FindLineEnd(const char *p, const char *end) {
+  auto line_end =
+      static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+  return line_end ? line_end : end;
+}
+
+// Classifies the line and moves p past the keyword.
+ObjLineType ClassifyLine(const char *&p, const char *end) {
+  p = SkipSpaces(p, end);
+  if (end - p < 2) {
+    return ObjLineType::Other;
+  }
+  if (p[0] == 'v') {
+    if (IsSpace(p[1])) {
+      p += 1;
+      return ObjLineType::Position;
+    }
+    if (end - p >= 3 && IsSpace(p[2])) {
+      if (p[1] == 't') {
+        p += 2;
+        return ObjLineType::TexCoord;
+      }
+      if (p[1] == 'n') {
+        p += 2;
+        return ObjLineType::Normal;
+      }
+    }
+  } else if (p[0] == 'f' && IsSpace(p[1])) {
+    p += 1;
+    return ObjLineType::Face;
+  }
+  return ObjLineType::Other;
+}
+
+double Pow10(int exponent) {
+  static const double kPowers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                   1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                   1e18, 1e19, 1e20, 1e21, 1e22};
+  if (exponent >= 0 && exponent <= 22) {
+    return kPowers[exponent];
+  }
+  return std::pow(10.0, exponent);
+}
+
+// Fast path for plain decimal numbers, anything else (inf, nan, hex floats)
+// goes through strtof.
+bool ParseFloat(const char *&p, const char *end, float &value) {
+  const char *s = p;
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+')) {
+    negative = *s == '-';
+    s++;
+  }
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int num_digits = 0;
+  bool has_digits = false;
+  while (s < end && IsDigit(*s)) {
+    if (num_digits < 19) {
+      mantissa = mantissa * 10 + uint64_t(*s - '0');
+      num_digits += mantissa != 0;
+    } else {
+      exponent++;
+    }
+    has_digits = true;
+    s++;
+  }
+  if (s < end && *s == '.') {
+    s++;
+    while (s < end && IsDigit(*s)) {
+      if (num_digits < 19) {
+        mantissa = mantissa * 10 + uint64_t(*s - '0');
+        num_digits += mantissa != 0;
+        exponent--;
+      }
+      has_digits = true;
+      s++;
+    }
+  }
+
+  if (!has_digits) {
+    char buffer[64];
+    size_t length = 0;
+    while (p + length < end && length + 1 < sizeof(buffer) &&
+           !IsSpace(p[length]) && p[length] != '\n') {
+      buffer[length] = p[length];
+      length++;
+    }
+    buffer[length] = '\0';
+    char *parse_end = nullptr;
+    value = std::strtof(buffer, &parse_end);
+    if (parse_end == buffer) {
+      return false;
+    }
+    p += parse_end - buffer;
+    return true;
+  }
+
+  if (s < end && (*s == 'e' || *s == 'E')) {
+    const char *e = s + 1;
+    bool negative_exponent = false;
+    if (e < end && (*e == '-' || *e == '+')) {
+      negative_exponent = *e == '-';
+      e++;
+    }
+    if (e < end && IsDigit(*e)) {
+      int exponent_value = 0;
+      while (e < end && IsDigit(*e)) {
+        exponent_value = std::min(exponent_value * 10 + (*e - '0'), 10000);
+        e++;
+      }
+      exponent += negative_exponent ? -exponent_value : exponent_value;
+      s = e;
+    }
+  }
+
+  double result = double(mantissa);
+  if (mantissa) {
+    result = exponent < 0 ? result / Pow10(-exponent) : result * Pow10(exponent);
+  }
+  value = float(negative ? -result : result);
+  p = s;
+  return true;
+}
+
+bool ParseIndex(const char *&p, const char *end, int64_t &value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  if (p >= end || !IsDigit(*p)) {
+    return false;
+  }
+  value = 0;
+  while (p < end && IsDigit(*p)) {
+    value = std::min<int64_t>(value * 10 + (*p - '0'), int64_t(1) << 40);
+    p++;
+  }
+  if (negative) {
+    value = -value;
+  }
+  return true;
+}
+
+// OBJ indices are 1-based, negative indices count back from the last element
+// defined before the current line.
+uint32_t ResolveIndex(int64_t index, uint64_t count) {
+  if (index > 0) {
+    return index <= int64_t(kInvalidIndex) ? uint32_t(index - 1)
+                                           : kInvalidIndex - 1;
+  }
+  if (index < 0 && -index <= int64_t(count)) {
+    return uint32_t(int64_t(count) + index);
+  }
+  return kInvalidIndex - 1;
+}
+
+uint64_t CountTokens(const char *p, const char *end) {
+  uint64_t count = 0;
+  while (true) {
+    p = SkipSpaces(p, end);
+    if (p >= end) {
+      return count;
+    }
+    count++;
+    while (p < end && !IsSpace(*p)) {
+      p++;
+    }
+  }
+}
+
+template <int N>
+bool ParseVector(const char *p,
+                 const char *end,
+                 float *out,
+                 int min_components) {
+  for (int i = 0; i < N; i++) {
+    p = SkipSpaces(p, end);
+    if (p >= end) {
+      return i >= min_components;
+    }
+    if (!ParseFloat(p, end, out[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Iterates over the lines whose first character lies in [begin, end).
+template <class Func>
+void ForEachLine(const char *begin, const char *end, Func &&func) {
+  const char *p = begin;
+  while (p < end) {
+    const char *line_end = FindLineEnd(p, end);
+    func(p, line_end);
+    p = line_end + 1;
+  }
+}
+
+void CountChunk(ObjChunk &chunk) {
+  ForEachLine(chunk.begin, chunk.end, [&chunk](const char *p, const char *end) {
+    switch (ClassifyLine(p, end)) {
+      case ObjLineType::Position:
+        chunk.num_positions++;
+        break;
+      case ObjLineType::TexCoord:
+        chunk.num_tex_coords++;
+        break;
+      case ObjLineType::Normal:
+        chunk.num_normals++;
+        break;
+      case ObjLineType::Face: {
+        uint64_t num_corners = CountTokens(p, end);
+        if (num_corners > 2) {
+          chunk.num_triangles += num_corners - 2;
+        }
+      } break;
+      default:
+        break;
+    }
+  });
+}
+
+bool ParseCorner(const char *&p,
+                 const char *end,
+                 uint64_t num_positions,
+                 uint64_t num_tex_coords,
+                 uint64_t num_normals,
+                 ObjCorner &corner) {
+  int64_t index;
+  if (!ParseIndex(p, end, index)) {
+    return false;
+  }
+  corner.position = ResolveIndex(index, num_positions);
+  corner.tex_coord = kInvalidIndex;
+  corner.normal = kInvalidIndex;
+  if (p < end && *p == '/') {
+    p++;
+    if (p < end && *p != '/') {
+      if (!ParseIndex(p, end, index)) {
+        return false;
+      }
+      corner.tex_coord = ResolveIndex(index, num_tex_coords);
+    }
+    if (p < end && *p == '/') {
+      p++;
+      if (!ParseIndex(p, end, index)) {
+        return false;
+      }
+      corner.normal = ResolveIndex(index, num_normals);
+    }
+  }
+  return p >= end || IsSpace(*p);
+}
+
+void ParseChunk(ObjChunk &chunk,
+                std::vector<glm::vec3> &positions,
+                std::vector<glm::vec2> &tex_coords,
+                std::vector<glm::vec3> &normals,
+                std::vector<ObjCorner> &corners) {
+  uint64_t num_positions = chunk.position_offset;
+  uint64_t num_tex_coords = chunk.tex_coord_offset;
+  uint64_t num_normals = chunk.normal_offset;
+  uint64_t num_triangles = chunk.triangle_offset;
+  std::vector<ObjCorner> face_corners;
+  ForEachLine(chunk.begin, chunk.end, [&](const char *p, const char *end) {
+    if (chunk.failed) {
+      return;
+    }
+    switch (ClassifyLine(p, end)) {
+      case ObjLineType::Position:
+        chunk.failed |=
+            !ParseVector<3>(p, end, &positions[num_positions++].x, 3);
+        break;
+      case ObjLineType::TexCoord:
+        chunk.failed |=
+            !ParseVector<2>(p, end, &tex_coords[num_tex_coords++].x, 1);
+        break;
+      case ObjLineType::Normal:
+        chunk.failed |= !ParseVector<3>(p, end, &normals[num_normals++].x, 3);
+        break;
+      case ObjLineType::Face: {
+        face_corners.clear();
+        while (true) {
+          p = SkipSpaces(p, end);
+          if (p >= end) {
+            break;
+          }
+          ObjCorner corner{};
+          if (!ParseCorner(p, end, num_positions, num_tex_coords, num_normals,
+                           corner)) {
+            chunk.failed = true;
+            return;
+          }
+          face_corners.push_back(corner);
+        }
+        for (size_t i = 2; i < face_corners.size(); i++) {
+          ObjCorner *triangle = &corners[num_triangles++ * 3];
+          triangle[0] = face_corners[0];
+          triangle[1] = face_corners[i - 1];
+          triangle[2] = face_corners[i];
+        }
+      } break;
+      default:
+        break;
+    }
+  });
+}
+
+}  // namespace
+
+int ParseObjFile(const std::string &obj_file_path,
+                 std::vector<Vertex> &vertices,
+                 std::vector<uint32_t> &indices) {
+  auto start_time = std::chrono::steady_clock::now();
+
+  MappedFile file;
+  if (file.Open(obj_file_path)) {
+    return -1;
+  }
+  const char *data = file.Data();
+  const uint64_t size = file.Size();
+
+  // Split the file at line boundaries, every chunk owns the lines starting
+  // inside of it.
+  uint64_t num_chunks = std::clamp<uint64_t>(
+      size / kMinChunkSize, 1, uint64_t(WorkerThreadCount()) * 4);
+  std::vector<ObjChunk> chunks(num_chunks);
+  std::vector<uint64_t> chunk_starts(num_chunks + 1, size);
+  for (uint64_t i = 0; i < num_chunks; i++) {
+    uint64_t start = size * i / num_chunks;
+    while (start > 0 && start < size && data[start - 1] != '\n') {
+      start++;
+    }
+    chunk_starts[i] = start;
+  }
+  for (uint64_t i = 0; i < num_chunks; i++) {
+    chunks[i].begin = data + chunk_starts[i];
+    chunks[i].end = data + std::max(chunk_starts[i], chunk_starts[i + 1]);
+  }
+
+  ParallelFor(
+      num_chunks,
+      [&chunks](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; i++) {
+          CountChunk(chunks[i]);
+        }
+      },
+      1);
+
+  uint64_t num_positions = 0;
+  uint64_t num_tex_coords = 0;
+  uint64_t num_normals = 0;
+  uint64_t num_triangles = 0;
+  for (auto &chunk : chunks) {
+    chunk.position_offset = num_positions;
+    chunk.tex_coord_offset = num_tex_coords;
+    chunk.normal_offset = num_normals;
+    chunk.triangle_offset = num_triangles;
+    num_positions += chunk.num_positions;
+    num_tex_coords += chunk.num_tex_coords;
+    num_normals += chunk.num_normals;
+    num_triangles += chunk.num_triangles;
+  }
+  if (num_triangles * 3 >= kInvalidIndex) {
+    LogWarning("[Load obj, ERROR]: {} has too many triangles",
+               obj_file_path);
+    return -1;
+  }
+
+  std::vector<glm::vec3> positions(num_positions);
+  std::vector<glm::vec2> tex_coords(num_tex_coords);
+  std::vector<glm::vec3> normals(num_normals);
+  std::vector<ObjCorner> corners(num_triangles * 3);
+  ParallelFor(
+      num_chunks,
+      [&](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; i++) {
+          ParseChunk(chunks[i], positions, tex_coords, normals, corners);
+        }
+      },
+      1);
+  for (const auto &chunk : chunks) {
+    if (chunk.failed) {
+      LogWarning("[Load obj, ERROR]: Malformed statement in {}",
+                 obj_file_path);
+      return -1;
+    }
+  }
+
+  // Validate the references and decide which normals have to be flipped.
+  const uint64_t num_corners = corners.size();
+  std::vector<uint8_t> corner_flags(num_corners, 0);
+  std::vector<uint64_t> hashes(num_corners);
+  std::atomic<bool> invalid_index{false};
+  ParallelFor(num_triangles, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t t = begin; t < end; t++) {
+      const ObjCorner *triangle = &corners[t * 3];
+      bool valid = true;
+      for (int i = 0; i < 3; i++) {
+        valid &= triangle[i].position < num_positions &&
+                 (triangle[i].tex_coord == kInvalidIndex ||
+                  triangle[i].tex_coord < num_tex_coords) &&
+                 (triangle[i].normal == kInvalidIndex ||
+                  triangle[i].normal < num_normals);
+      }
+      if (!valid) {
+        invalid_index = true;
+        continue;
+      }
+      glm::vec3 p0 = positions[triangle[0].position];
+      glm::vec3 geometry_normal = glm::normalize(
+          glm::cross(positions[triangle[1].position] - p0,
+                     positions[triangle[2].position] - p0));
+      for (int i = 0; i < 3; i++) {
+        uint64_t corner_index = t * 3 + i;
+        uint8_t flags = 0;
+        if (triangle[i].normal != kInvalidIndex &&
+            normals[triangle[i].normal] != glm::vec3{0.0f}) {
+          flags = kCornerHasNormal;
+          if (glm::dot(geometry_normal, normals[triangle[i].normal]) < 0.0f) {
+            flags |= kCornerFlipNormal;
+          }
+        }
+        corner_flags[corner_index] = flags;
+        uint64_t hash = HashCombine(0, triangle[i].position);
+        hash = HashCombine(hash, triangle[i].tex_coord);
+        hash = HashCombine(hash, (flags & kCornerHasNormal)
+                                     ? uint64_t(triangle[i].normal)
+                                     : corner_index);
+        hashes[corner_index] = HashCombine(hash, flags);
+      }
+    }
+  });
+  if (invalid_index) {
+    LogWarning("[Load obj, ERROR]: Index out of range in {}", obj_file_path);
+    return -1;
+  }
+
+  auto first = FindFirstEqualKeys(hashes, [&](uint32_t a, uint32_t b) {
+    return (corner_flags[a] & kCornerHasNormal) &&
+           corner_flags[a] == corner_flags[b] &&
+           corners[a].position == corners[b].position &&
+           corners[a].tex_coord == corners[b].tex_coord &&
+           corners[a].normal == corners[b].normal;
+  });
+  hashes = {};
+
+  indices.resize(num_corners);
+  std::vector<uint32_t> unique_corners;
+  for (uint64_t i = 0; i < num_corners; i++) {
+    if (first[i] == i) {
+      indices[i] = uint32_t(unique_corners.size());
+      unique_corners.push_back(uint32_t(i));
+    } else {
+      indices[i] = indices[first[i]];
+    }
+  }
+  first = {};
+
+  vertices.resize(unique_corners.size());
+  ParallelFor(unique_corners.size(), [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; i++) {
+      uint32_t corner_index = unique_corners[i];
+      const ObjCorner &corner = corners[corner_index];
+      uint8_t flags = corner_flags[corner_index];
+      Vertex vertex{};
+      vertex.position = positions[corner.position];
+      if (corner.tex_coord != kInvalidIndex) {
+        vertex.tex_coord = tex_coords[corner.tex_coord];
+      }
+      if (flags & kCornerHasNormal) {
+        vertex.normal = normals[corner.normal];
+        if (flags & kCornerFlipNormal) {
+          vertex.normal = -vertex.normal;
+        }
+      } else {
+        const ObjCorner *triangle = &corners[corner_index / 3 * 3];
+        glm::vec3 p0 = positions[triangle[0].position];
+        vertex.normal = glm::normalize(
+            glm::cross(positions[triangle[1].position] - p0,
+                       positions[triangle[2].position] - p0));
+      }
+      vertices[i] = vertex;
+    }
+  });
+
+  float seconds = std::chrono::duration<float>(
+                      std::chrono::steady_clock::now() - start_time)
+                      .count();
+  float megabytes = float(size) / (1024.0f * 1024.0f);
+  LogInfo("Parsed {} ({:.1f} MB, {} triangles) in {:.3f}s, {:.1f} MB/s",
+          obj_file_path, megabytes, num_triangles, seconds,
+          megabytes / std::max(seconds, 1e-6f));
+  return 0;
+}
+
+}  // namespace sparks
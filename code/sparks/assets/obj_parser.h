@@ -0,0 +1,19 @@
+#pragma once
+
+#include "sparks/assets/vertex.h"
+#include "vector"
+
+namespace sparks {
+
+// Parses a Wavefront OBJ file into an indexed triangle mesh. The file is
+// memory-mapped and split into line ranges that are tokenized on the worker
+// threads. All objects and groups are merged into one mesh, polygons are
+// fan-triangulated and only positions, texture coordinates and normals are
+// read. Corners without a normal receive the face normal, normals pointing
+// away from the face normal are flipped. Corners sharing the same position,
+// texture coordinate and normal share a vertex.
+int ParseObjFile(const std::string &obj_file_path,
+                 std::vector<Vertex> &vertices,
+                 std::vector<uint32_t> &indices);
+
+}  // namespace sparks
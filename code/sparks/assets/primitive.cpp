@@ -0,0 +1,122 @@
+#include "sparks/assets/primitive.h"
+
+#include "cmath"
+#include "limits"
+
+namespace sparks {
+
+namespace {
+constexpr float kPi = 3.14159265358979323846f;
+constexpr uint32_t kSphereSlices = 64;
+constexpr uint32_t kSphereStacks = 32;
+constexpr uint32_t kDiskSegments = 64;
+
+// Planar primitives share the texture mapping of the island water plane.
+Vertex PlanarVertex(float x, float z) {
+  Vertex vertex;
+  vertex.position = {x, 0.0f, z};
+  vertex.normal = {0.0f, 1.0f, 0.0f};
+  vertex.tangent = {1.0f, 0.0f, 0.0f};
+  vertex.tex_coord = {x + 0.5f, 0.5f - z};
+  vertex.signal = 1.0f;
+  return vertex;
+}
+
+void BuildQuad(float extent,
+               std::vector<Vertex> &vertices,
+               std::vector<uint32_t> &indices) {
+  vertices = {PlanarVertex(-extent, -extent), PlanarVertex(extent, -extent),
+              PlanarVertex(-extent, extent), PlanarVertex(extent, extent)};
+  indices = {0, 2, 1, 3, 1, 2};
+}
+
+void BuildDisk(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+  vertices.push_back(PlanarVertex(0.0f, 0.0f));
+  for (uint32_t i = 0; i < kDiskSegments; i++) {
+    float phi = 2.0f * kPi * float(i) / float(kDiskSegments);
+    vertices.push_back(
+        PlanarVertex(0.5f * std::cos(phi), 0.5f * std::sin(phi)));
+  }
+  for (uint32_t i = 0; i < kDiskSegments; i++) {
+    indices.insert(indices.end(), {0, (i + 1) % kDiskSegments + 1, i + 1});
+  }
+}
+
+void BuildSphere(std::vector<Vertex> &vertices,
+                 std::vector<uint32_t> &indices) {
+  // u follows the azimuth, starting at -x, v the polar angle from +y.
+  for (uint32_t j = 0; j <= kSphereStacks; j++) {
+    float v = float(j) / float(kSphereStacks);
+    float theta = kPi * v;
+    for (uint32_t i = 0; i <= kSphereSlices; i++) {
+      float u = float(i) / float(kSphereSlices);
+      float phi = 2.0f * kPi * (u - 0.5f);
+      Vertex vertex;
+      vertex.position = {std::sin(theta) * std::cos(phi), std::cos(theta),
+                         std::sin(theta) * std::sin(phi)};
+      vertex.normal = vertex.position;
+      vertex.tangent = {-std::sin(phi), 0.0f, std::cos(phi)};
+      vertex.tex_coord = {u, v};
+      vertex.signal = 1.0f;
+      vertices.push_back(vertex);
+    }
+  }
+  const uint32_t row = kSphereSlices + 1;
+  for (uint32_t j = 0; j < kSphereStacks; j++) {
+    for (uint32_t i = 0; i < kSphereSlices; i++) {
+      uint32_t v00 = j * row + i;
+      uint32_t v10 = (j + 1) * row + i;
+      if (j) {
+        indices.insert(indices.end(), {v00, v00 + 1, v10});
+      }
+      if (j + 1 < kSphereStacks) {
+        indices.insert(indices.end(), {v00 + 1, v10 + 1, v10});
+      }
+    }
+  }
+}
+}  // namespace
+
+float PrimitiveArea(PrimitiveType type) {
+  switch (type) {
+    case PrimitiveType::Sphere:
+      return 4.0f * kPi;
+    case PrimitiveType::Quad:
+      return 1.0f;
+    case PrimitiveType::Disk:
+      return 0.25f * kPi;
+    case PrimitiveType::Plane:
+      return std::numeric_limits<float>::infinity();
+    default:
+      return 0.0f;
+  }
+}
+
+Mesh BuildPrimitiveMesh(PrimitiveType type) {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  switch (type) {
+    case PrimitiveType::Sphere:
+      BuildSphere(vertices, indices);
+      break;
+    case PrimitiveType::Quad:
+      BuildQuad(0.5f, vertices, indices);
+      break;
+    case PrimitiveType::Disk:
+      BuildDisk(vertices, indices);
+      break;
+    case PrimitiveType::Plane:
+      BuildQuad(kPlanePrimitiveRasterExtent, vertices, indices);
+      break;
+    default:
+      break;
+  }
+
+  MeshBuildOptions options;
+  options.has_normals = true;
+  options.has_tangents = true;
+  options.merge_vertices = false;
+  return Mesh(vertices, indices, options);
+}
+
+}  // namespace sparks
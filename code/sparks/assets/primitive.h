@@ -0,0 +1,33 @@
+#pragma once
+
+#include "sparks/assets/mesh.h"
+
+namespace sparks {
+
+// Analytic shapes an entity can use instead of a mesh. The ray tracer
+// intersects them in object space, the raster preview draws the mesh from
+// BuildPrimitiveMesh. The values are shared with the shaders, see
+// primitive.glsl.
+enum class PrimitiveType : uint32_t {
+  Mesh = 0,
+  // Unit sphere around the origin.
+  Sphere = 1,
+  // [-0.5, 0.5] x [-0.5, 0.5] in the xz plane, facing +y.
+  Quad = 2,
+  // Radius 0.5 around the origin in the xz plane, facing +y.
+  Disk = 3,
+  // The whole xz plane, facing +y.
+  Plane = 4,
+};
+
+// Half extent of the quad the raster preview draws for an infinite plane.
+constexpr float kPlanePrimitiveRasterExtent = 1e4f;
+
+// Object space surface area, infinite for planes.
+float PrimitiveArea(PrimitiveType type);
+
+// Triangulated stand-in for the raster preview. Positions, normals, tangents
+// and texture coordinates follow the analytic parameterization.
+Mesh BuildPrimitiveMesh(PrimitiveType type);
+
+}  // namespace sparks
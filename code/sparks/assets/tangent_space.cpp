@@ -0,0 +1,243 @@
+#include "sparks/assets/tangent_space.h"
+
+#include "algorithm"
+#include "atomic"
+#include "mikktspace.h"
+#include "numeric"
+
+namespace sparks {
+
+namespace {
+
+constexpr uint32_t kInvalidIndex = 0xffffffffu;
+constexpr uint64_t kMinBatchFaces = 1u << 14;
+
+struct TangentBatch {
+  const std::vector<Vertex> *vertices;
+  const std::vector<uint32_t> *indices;
+  const uint32_t *faces;
+  uint32_t num_faces;
+  glm::vec4 *corner_tangents;
+};
+
+const Vertex &BatchVertex(const SMikkTSpaceContext *context,
+                          int i_face,
+                          int i_vert) {
+  auto batch = reinterpret_cast<const TangentBatch *>(context->m_pUserData);
+  return (*batch->vertices)[(*batch->indices)[batch->faces[i_face] * 3 +
+                                              i_vert]];
+}
+
+uint32_t FindRoot(std::vector<uint32_t> &parents, uint32_t i) {
+  while (parents[i] != i) {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+// Groups faces by the connected component they belong to. Faces of the same
+// component are stored contiguously in faces, component c spans
+// [offsets[c], offsets[c + 1]).
+void SortFacesByComponent(size_t num_vertices,
+                          const std::vector<uint32_t> &indices,
+                          std::vector<uint32_t> &faces,
+                          std::vector<uint32_t> &offsets) {
+  const uint32_t num_faces = indices.size() / 3;
+  std::vector<uint32_t> parents(num_vertices);
+  std::iota(parents.begin(), parents.end(), 0);
+  for (uint32_t i = 0; i < num_faces * 3; i += 3) {
+    uint32_t root = FindRoot(parents, indices[i]);
+    for (int j = 1; j < 3; j++) {
+      uint32_t other = FindRoot(parents, indices[i + j]);
+      if (other != root) {
+        // Attach to the smaller index so the roots are deterministic.
+        if (other < root) {
+          std::swap(other, root);
+        }
+        parents[other] = root;
+      }
+    }
+  }
+
+  // Component ids follow the order of the first face of each component.
+  std::vector<uint32_t> face_components(num_faces);
+  std::vector<uint32_t> root_components(num_vertices, kInvalidIndex);
+  offsets.clear();
+  for (uint32_t i = 0; i < num_faces; i++) {
+    uint32_t root = FindRoot(parents, indices[i * 3]);
+    if (root_components[root] == kInvalidIndex) {
+      root_components[root] = offsets.size();
+      offsets.push_back(0);
+    }
+    face_components[i] = root_components[root];
+    offsets[face_components[i]]++;
+  }
+
+  uint32_t face_offset = 0;
+  for (auto &offset : offsets) {
+    uint32_t count = offset;
+    offset = face_offset;
+    face_offset += count;
+  }
+  offsets.push_back(face_offset);
+
+  faces.resize(num_faces);
+  std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+  for (uint32_t i = 0; i < num_faces; i++) {
+    faces[cursors[face_components[i]]++] = i;
+  }
+}
+
+bool GenerateBatchTangents(TangentBatch &batch) {
+  SMikkTSpaceInterface interface {};
+
+  interface.m_getNumFaces = [](const SMikkTSpaceContext *context) {
+    auto batch = reinterpret_cast<const TangentBatch *>(context->m_pUserData);
+    return int(batch->num_faces);
+  };
+
+  interface.m_getNumVerticesOfFace = [](const SMikkTSpaceContext *context,
+                                        const int i_face) { return 3; };
+
+  interface.m_getNormal = [](const SMikkTSpaceContext *context,
+                             float normal_out[], const int i_face,
+                             const int i_vert) {
+    auto normal = BatchVertex(context, i_face, i_vert).normal;
+    normal_out[0] = normal.x;
+    normal_out[1] = normal.y;
+    normal_out[2] = normal.z;
+  };
+
+  interface.m_getPosition = [](const SMikkTSpaceContext *context,
+                               float position_out[], const int i_face,
+                               const int i_vert) {
+    auto position = BatchVertex(context, i_face, i_vert).position;
+    position_out[0] = position.x;
+    position_out[1] = position.y;
+    position_out[2] = position.z;
+  };
+
+  interface.m_getTexCoord = [](const SMikkTSpaceContext *context,
+                               float texcoord_out[], const int i_face,
+                               const int i_vert) {
+    auto tex_coord = BatchVertex(context, i_face, i_vert).tex_coord;
+    texcoord_out[0] = tex_coord.x;
+    texcoord_out[1] = tex_coord.y;
+  };
+
+  interface.m_setTSpaceBasic = [](const SMikkTSpaceContext *context,
+                                  const float tangent[], const float sign,
+                                  const int i_face, const int i_vert) {
+    auto batch = reinterpret_cast<const TangentBatch *>(context->m_pUserData);
+    batch->corner_tangents[batch->faces[i_face] * 3 + i_vert] =
+        glm::vec4{tangent[0], tangent[1], tangent[2], sign};
+  };
+
+  SMikkTSpaceContext context{};
+  context.m_pInterface = &interface;
+  context.m_pUserData = reinterpret_cast<void *>(&batch);
+  return genTangSpaceDefault(&context) != 0;
+}
+
+}  // namespace
+
+int GenerateTangents(std::vector<Vertex> &vertices,
+                     std::vector<uint32_t> &indices) {
+  if (indices.size() < 3 || vertices.empty()) {
+    return 0;
+  }
+
+  // MikkTSpace only shares tangents between corners with equal position,
+  // normal and texture coordinate. Faces that are not connected through
+  // indices can therefore be processed independently, as long as equal
+  // vertices have been welded beforehand.
+  std::vector<uint32_t> faces;
+  std::vector<uint32_t> offsets;
+  SortFacesByComponent(vertices.size(), indices, faces, offsets);
+
+  const uint64_t num_faces = faces.size();
+  const uint64_t batch_target = std::max<uint64_t>(
+      kMinBatchFaces, num_faces / (uint64_t(WorkerThreadCount()) * 4));
+  std::vector<TangentBatch> batches;
+  std::vector<glm::vec4> corner_tangents(num_faces * 3,
+                                         glm::vec4{0.0f, 0.0f, 0.0f, 1.0f});
+  for (size_t c = 0; c + 1 < offsets.size();) {
+    size_t end = c + 1;
+    while (end + 1 < offsets.size() &&
+           offsets[end] - offsets[c] < batch_target) {
+      end++;
+    }
+    batches.push_back({&vertices, &indices, faces.data() + offsets[c],
+                       offsets[end] - offsets[c], corner_tangents.data()});
+    c = end;
+  }
+
+  std::atomic<bool> failed{false};
+  ParallelFor(
+      batches.size(),
+      [&batches, &failed](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; i++) {
+          if (!GenerateBatchTangents(batches[i])) {
+            failed = true;
+          }
+        }
+      },
+      1);
+
+  ParallelFor(corner_tangents.size(), [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; i++) {
+      const glm::vec3 &normal = vertices[indices[i]].normal;
+      glm::vec3 tangent{corner_tangents[i]};
+      // Corners of components MikkTSpace failed on still hold a zero tangent.
+      if (std::abs(glm::dot(normal, tangent)) > 1e-4f ||
+          glm::length(tangent) < 0.5f) {
+        tangent = glm::cross(normal, glm::vec3{1.0f, 0.0f, 0.0f});
+        if (glm::length(tangent) < 1e-4f) {
+          tangent = glm::cross(normal, glm::vec3{0.0f, 1.0f, 0.0f});
+        }
+        tangent = glm::normalize(tangent);
+        corner_tangents[i] = glm::vec4{tangent, corner_tangents[i].w};
+      }
+    }
+  });
+
+  // Assign the tangent frames, a vertex referenced with several distinct
+  // frames gets one copy per frame. Copies of a vertex are chained through
+  // next_copies so each corner only compares against copies of its own
+  // vertex.
+  const uint32_t num_vertices = vertices.size();
+  std::vector<bool> assigned(num_vertices, false);
+  std::vector<uint32_t> next_copies(num_vertices, kInvalidIndex);
+  for (size_t i = 0; i < corner_tangents.size(); i++) {
+    const glm::vec4 &frame = corner_tangents[i];
+    glm::vec3 tangent{frame};
+    uint32_t index = indices[i];
+    if (!assigned[index]) {
+      assigned[index] = true;
+      vertices[index].tangent = tangent;
+      vertices[index].signal = frame.w;
+      continue;
+    }
+    uint32_t last = index;
+    while (index != kInvalidIndex && !(vertices[index].tangent == tangent &&
+                                       vertices[index].signal == frame.w)) {
+      last = index;
+      index = next_copies[index];
+    }
+    if (index == kInvalidIndex) {
+      index = vertices.size();
+      Vertex vertex = vertices[last];
+      vertex.tangent = tangent;
+      vertex.signal = frame.w;
+      vertices.push_back(vertex);
+      next_copies.push_back(kInvalidIndex);
+      next_copies[last] = index;
+    }
+    indices[i] = index;
+  }
+
+  return failed ? -1 : 0;
+}
+
+}  // namespace sparks
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "sparks/assets/vertex.h"
+#include "vector"
+
+namespace sparks {
+
+// Generates MikkTSpace tangents for an indexed triangle mesh in place. Normals
+// and texture coordinates are expected to be set already. A vertex is only
+// split where the corners sharing it end up with different tangent frames,
+// the copies are appended after the original vertices. Connected components
+// are processed on the worker threads. Returns -1 if MikkTSpace fails on any
+// component, the affected corners then fall back to an arbitrary tangent.
+int GenerateTangents(std::vector<Vertex> &vertices,
+                     std::vector<uint32_t> &indices);
+
+}  // namespace sparks
@@ -0,0 +1,91 @@
+#include "sparks/assets/terrain.h"
+
+#include "algorithm"
+#include "sparks/utils/parallel.h"
+
+namespace sparks {
+
+int BuildTerrainTiles(const Texture &height_map,
+                      const TerrainSettings &settings,
+                      std::vector<TerrainTile> &tiles) {
+  tiles.clear();
+  if (!settings.tile_size || !settings.num_levels) {
+    LogWarning("Invalid terrain settings.");
+    return -1;
+  }
+
+  HeightField height_field(height_map, settings.precision,
+                           settings.height_scale, settings.height_offset);
+  const uint32_t tile_size = settings.tile_size;
+  const uint32_t num_tiles_x =
+      (height_field.Width() + tile_size - 1) / tile_size;
+  const uint32_t num_tiles_y =
+      (height_field.Height() + tile_size - 1) / tile_size;
+  const uint32_t num_tiles = num_tiles_x * num_tiles_y;
+
+  // Level errors are needed up front, the skirt depth depends on all tiles.
+  std::vector<float> errors(num_tiles * settings.num_levels, 0.0f);
+  ParallelFor(
+      uint64_t(num_tiles) * settings.num_levels,
+      [&](uint64_t begin, uint64_t end) {
+        for (uint64_t k = begin; k < end; k++) {
+          uint32_t tile = k / settings.num_levels;
+          uint32_t level = k % settings.num_levels;
+          if (!level) {
+            continue;
+          }
+          uint32_t x0 = (tile % num_tiles_x) * tile_size;
+          uint32_t y0 = (tile / num_tiles_x) * tile_size;
+          uint32_t x1 = std::min(x0 + tile_size, height_field.Width());
+          uint32_t y1 = std::min(y0 + tile_size, height_field.Height());
+          errors[k] = height_field.PatchError(x0, y0, x1, y1, 1u << level);
+        }
+      },
+      1);
+
+  // The edges of two levels are both within their errors of the true
+  // heights, so twice the largest error closes any crack.
+  float skirt_depth = 2.0f * *std::max_element(errors.begin(), errors.end());
+
+  MeshBuildOptions options;
+  options.has_normals = true;
+  options.has_tangents = true;
+  options.merge_vertices = false;
+
+  tiles.resize(num_tiles);
+  ParallelFor(
+      num_tiles,
+      [&](uint64_t begin, uint64_t end) {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        for (uint64_t tile = begin; tile < end; tile++) {
+          auto &terrain_tile = tiles[tile];
+          terrain_tile.x = tile % num_tiles_x;
+          terrain_tile.y = tile / num_tiles_x;
+          uint32_t x0 = terrain_tile.x * tile_size;
+          uint32_t y0 = terrain_tile.y * tile_size;
+          uint32_t x1 = std::min(x0 + tile_size, height_field.Width());
+          uint32_t y1 = std::min(y0 + tile_size, height_field.Height());
+          for (uint32_t level = 0; level < settings.num_levels; level++) {
+            uint32_t step = 1u << level;
+            // Levels coarser than the tile add nothing.
+            if (level && step >= std::max(x1 - x0, y1 - y0) * 2) {
+              break;
+            }
+            height_field.BuildPatch(x0, y0, x1, y1, step, skirt_depth,
+                                    vertices, indices);
+            if (!level) {
+              terrain_tile.mesh = Mesh(vertices, indices, options);
+            } else {
+              terrain_tile.lods.push_back(
+                  {Mesh(vertices, indices, options),
+                   errors[tile * settings.num_levels + level]});
+            }
+          }
+        }
+      },
+      1);
+  return 0;
+}
+
+}  // namespace sparks
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "sparks/assets/height_field.h"
+#include "sparks/assets/mesh_lod.h"
+#include "vector"
+
+namespace sparks {
+
+struct TerrainSettings {
+  // Grid points per heightmap texel along each axis.
+  float precision{1.0f};
+  float height_scale{1.0f};
+  float height_offset{0.0f};
+  // Quads along each side of a tile at its finest level.
+  uint32_t tile_size{128};
+  // Levels per tile including the finest one, every level doubles the grid
+  // spacing of the previous one.
+  uint32_t num_levels{4};
+};
+
+struct TerrainTile {
+  // Position of the tile in the tile grid.
+  uint32_t x;
+  uint32_t y;
+  Mesh mesh;
+  // Coarser levels, finest first.
+  std::vector<MeshLod> lods;
+};
+
+// Splits a heightmap into tiles and builds their levels on the worker threads.
+// All tiles carry skirts deep enough to cover the largest difference between
+// any two levels, so neighbouring tiles can use different levels without
+// cracks. Tiles are returned in row-major order.
+int BuildTerrainTiles(const Texture &height_map,
+                      const TerrainSettings &settings,
+                      std::vector<TerrainTile> &tiles);
+
+}  // namespace sparks
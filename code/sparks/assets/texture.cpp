@@ -1,8 +1,15 @@
 #include "sparks/assets/texture.h"
 
+#include "algorithm"
 #include "cassert"
+#include "cmath"
 #include "glm/gtc/matrix_transform.hpp"
+#include "sparks/assets/texture_reader.h"
 
+// Textures are decoded on the asset worker threads. The failure reason and
+// the per-call flags of stb_image become thread local, and its process-wide
+// LDR to HDR gamma is never used: TextureReader converts LDR files itself.
+#define STBI_THREAD_LOCAL thread_local
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -24,29 +31,18 @@ Texture::Texture(uint32_t width,
 
 int Texture::LoadFromFile(const std::string &file_path,
                           LDRColorSpace ldr_color_space) {
-  float restore_gamma = stbi__l2h_gamma;
-  switch (ldr_color_space) {
-    case LDRColorSpace::SRGB:
-      stbi_ldr_to_hdr_gamma(2.2f);
-      break;
-    case LDRColorSpace::UNORM:
-      stbi_ldr_to_hdr_gamma(1.0f);
-      break;
-  }
-
-  float *pixels =
-      stbi_loadf(file_path.c_str(), reinterpret_cast<int *>(&width_),
-                 reinterpret_cast<int *>(&height_), nullptr, 4);
-  stbi_ldr_to_hdr_gamma(restore_gamma);
-  if (!pixels) {
+  TextureReader reader;
+  if (reader.Open(file_path, ldr_color_space)) {
     return -1;
   }
-  pixels_.resize(width_ * height_);
-  for (int i = 0; i < width_ * height_; i++) {
-    pixels_[i] = glm::vec4{pixels[i * 4], pixels[i * 4 + 1], pixels[i * 4 + 2],
-                           pixels[i * 4 + 3]};
+  std::vector<glm::vec4> pixels(size_t(reader.Width()) * reader.Height());
+  if (reader.ReadRows(reader.Height(), pixels.data())) {
+    return -1;
   }
-  stbi_image_free(pixels);
+  width_ = reader.Width();
+  height_ = reader.Height();
+  pixels_ = std::move(pixels);
+  format_ = reader.Format();
   return 0;
 }
 
@@ -148,16 +144,57 @@ glm::vec4 Texture::Sample(float u, float v, AddressMode address_mode) const {
          Fetch(x + 1, y + 1, address_mode) * rx * ry;
 }
 
+void BuildMipChain(const Texture &texture, std::vector<Texture> &levels) {
+  levels.clear();
+  const Texture *source = &texture;
+  while (source->Width() > 1 || source->Height() > 1) {
+    const uint32_t width = std::max(source->Width() / 2, 1u);
+    const uint32_t height = std::max(source->Height() / 2, 1u);
+    Texture level(width, height);
+    level.SetFormat(texture.Format());
+    ParallelFor(height, [&](uint64_t begin, uint64_t end) {
+      for (uint64_t y = begin; y < end; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+          // Odd sizes drop the last row or column of the larger level, the
+          // clamped fetch only matters for levels one texel wide.
+          level(x, y) = 0.25f * (source->Fetch(x * 2, y * 2) +
+                                 source->Fetch(x * 2 + 1, y * 2) +
+                                 source->Fetch(x * 2, y * 2 + 1) +
+                                 source->Fetch(x * 2 + 1, y * 2 + 1));
+        }
+      }
+    });
+    levels.push_back(std::move(level));
+    source = &levels.back();
+  }
+}
+
+float SrgbToLinear(float value) {
+  if (value <= 0.04045f) {
+    return value / 12.92f;
+  }
+  return std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float LinearToSrgb(float value) {
+  if (value <= 0.0031308f) {
+    return value * 12.92f;
+  }
+  return 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+// Rounds to the nearest byte, so that the bytes of a loaded image are written
+// back unchanged.
 uint8_t FloatToByte(float value, LDRColorSpace ldr_color_space) {
   switch (ldr_color_space) {
     case LDRColorSpace::SRGB:
-      value = std::pow(value, 1.0f / 2.2f);
+      value = LinearToSrgb(value);
       break;
     default:
       break;
   }
   return static_cast<uint8_t>(
-      glm::clamp(static_cast<int>(value * 255.0f), 0, 255));
+      glm::clamp(static_cast<int>(std::lround(value * 255.0f)), 0, 255));
 }
 
 std::vector<uint8_t> ConvertTexture(const Texture &texture,
@@ -13,6 +13,32 @@ enum class AddressMode {
 
 enum class LDRColorSpace { SRGB, UNORM };
 
+// Storage of a texture once it is uploaded, the host copy is always kept as
+// floats. Keep the values in sync with TextureVkFormat.
+enum class TextureFormat : uint32_t {
+  RGBA8Unorm = 0,
+  // Sampled through an sRGB view, the stored bytes are sRGB encoded.
+  RGBA8Srgb = 1,
+  RGBA16Unorm = 2,
+  RGBA16Float = 3,
+  // Shared exponent RGB as in Radiance files, alpha reads as 1.
+  RGB9E5Float = 4,
+  RGBA32Float = 5,
+  // Scalar data, reads as (r, 0, 0, 1). The loader never picks these since
+  // the shaders use every texture as a colour, callers opt in by SetFormat.
+  R8Unorm = 6,
+  R16Unorm = 7,
+  // Block compressed formats, see texture_compression.h. BC1 drops alpha,
+  // BC4 and BC5 read as (r, 0, 0, 1) and (r, g, 0, 1).
+  BC1Unorm = 8,
+  BC1Srgb = 9,
+  BC4Unorm = 10,
+  BC5Unorm = 11,
+  BC6HUfloat = 12,
+  BC7Unorm = 13,
+  BC7Srgb = 14,
+};
+
 class Texture {
  public:
   Texture(uint32_t width = 1,
@@ -23,6 +49,9 @@ class Texture {
           uint32_t height,
           const std::vector<glm::vec4> &pixels);
 
+  // Picks the format matching the bit depth of the file: 8-bit images become
+  // RGBA8Srgb or RGBA8Unorm depending on ldr_color_space, 16-bit images
+  // RGBA16Unorm (RGBA16Float for sRGB) and Radiance files RGB9E5Float.
   int LoadFromFile(const std::string &file_path,
                    LDRColorSpace ldr_color_space = LDRColorSpace::SRGB);
 
@@ -45,6 +74,14 @@ class Texture {
     return pixels_.data();
   }
 
+  TextureFormat Format() const {
+    return format_;
+  }
+
+  void SetFormat(TextureFormat format) {
+    format_ = format;
+  }
+
   glm::vec4 &operator()(int x, int y);
 
   const glm::vec4 &operator()(int x, int y) const;
@@ -62,8 +99,20 @@ class Texture {
   std::vector<glm::vec4> pixels_;
   uint32_t width_{};
   uint32_t height_{};
+  // Textures built in memory may hold any value, half floats keep them at
+  // half the size of the host copy.
+  TextureFormat format_{TextureFormat::RGBA16Float};
 };
 
+// Fills levels with the mip chain below the texture down to 1x1, each level
+// halves the size of the previous one (rounding down, at least 1) and
+// averages 2x2 of its texels. The levels keep the format of the texture.
+void BuildMipChain(const Texture &texture, std::vector<Texture> &levels);
+
+float SrgbToLinear(float value);
+
+float LinearToSrgb(float value);
+
 uint8_t FloatToByte(float value, LDRColorSpace ldr_color_space);
 
 std::vector<uint8_t> ConvertTexture(const Texture &texture,
@@ -0,0 +1,683 @@
+#include "sparks/assets/texture_compression.h"
+
+#include "algorithm"
+#include "cmath"
+#include "cstring"
+#include "filesystem"
+#include "limits"
+#include "glm/gtc/packing.hpp"
+
+namespace sparks {
+
+namespace {
+
+constexpr uint32_t kTextureCacheMagic = 0x544b5053;  // "SPKT"
+
+constexpr int kRefineIterations = 3;
+
+// Interpolation weights of 4-bit indices in BC6H and BC7, in 1/64.
+constexpr int kWeights4[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                               34, 38, 43, 47, 51, 55, 60, 64};
+
+struct TextureCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t reserved;
+  uint64_t size;
+};
+
+// Writes fields least significant bit first, as all BC formats lay them out.
+class BlockWriter {
+ public:
+  BlockWriter(uint8_t *out, uint32_t size) : out_(out) {
+    std::memset(out, 0, size);
+  }
+
+  void Write(uint32_t value, int bits) {
+    for (int i = 0; i < bits; i++, pos_++) {
+      out_[pos_ >> 3] |= uint8_t(((value >> i) & 1u) << (pos_ & 7));
+    }
+  }
+
+ private:
+  uint8_t *out_;
+  int pos_{0};
+};
+
+float Distance2(const glm::vec4 &a, const glm::vec4 &b) {
+  glm::vec4 d = a - b;
+  return glm::dot(d, d);
+}
+
+// Direction of the largest spread of the texels around mean, by power
+// iteration on their covariance. Zero for flat blocks.
+glm::vec4 PrincipalAxis(const glm::vec4 *texels, const glm::vec4 &mean) {
+  glm::mat4 covariance{0.0f};
+  for (int i = 0; i < 16; i++) {
+    glm::vec4 d = texels[i] - mean;
+    covariance += glm::outerProduct(d, d);
+  }
+  glm::vec4 axis{1.0f};
+  for (int iteration = 0; iteration < 8; iteration++) {
+    axis = covariance * axis;
+    float length = glm::length(axis);
+    if (!(length > 1e-12f)) {
+      return glm::vec4{0.0f};
+    }
+    axis /= length;
+  }
+  return axis;
+}
+
+// Fits two endpoints along the principal axis and refines them by least
+// squares against the indices the encoder picks for them. The encoder keeps
+// the best quantized endpoints it has seen in Try.
+template <class Encoder>
+void FitEndpoints(const glm::vec4 *texels, Encoder &encoder) {
+  glm::vec4 mean{0.0f};
+  for (int i = 0; i < 16; i++) {
+    mean += texels[i];
+  }
+  mean /= 16.0f;
+  glm::vec4 axis = PrincipalAxis(texels, mean);
+  float t_min = 0.0f;
+  float t_max = 0.0f;
+  for (int i = 0; i < 16; i++) {
+    float t = glm::dot(texels[i] - mean, axis);
+    t_min = std::min(t_min, t);
+    t_max = std::max(t_max, t);
+  }
+  glm::vec4 e0 = mean + axis * t_min;
+  glm::vec4 e1 = mean + axis * t_max;
+
+  for (int iteration = 0; iteration < kRefineIterations; iteration++) {
+    encoder.Try(e0, e1);
+    float a = 0.0f;
+    float b = 0.0f;
+    float c = 0.0f;
+    glm::vec4 x{0.0f};
+    glm::vec4 y{0.0f};
+    for (int i = 0; i < 16; i++) {
+      float w = encoder.Weight(encoder.indices[i]);
+      a += (1.0f - w) * (1.0f - w);
+      b += (1.0f - w) * w;
+      c += w * w;
+      x += (1.0f - w) * texels[i];
+      y += w * texels[i];
+    }
+    float det = a * c - b * b;
+    if (!(std::abs(det) > 1e-6f)) {
+      break;
+    }
+    e0 = (c * x - b * y) / det;
+    e1 = (a * y - b * x) / det;
+  }
+}
+
+// BC1 in four colour mode. Texels hold 0-255 RGB, alpha is ignored.
+struct BC1Encoder {
+  static uint16_t Quantize(const glm::vec4 &color) {
+    glm::vec3 c = glm::clamp(glm::vec3{color}, glm::vec3{0.0f},
+                             glm::vec3{255.0f});
+    uint32_t r = uint32_t(std::round(c.r * 31.0f / 255.0f));
+    uint32_t g = uint32_t(std::round(c.g * 63.0f / 255.0f));
+    uint32_t b = uint32_t(std::round(c.b * 31.0f / 255.0f));
+    return uint16_t((r << 11) | (g << 5) | b);
+  }
+
+  static glm::vec4 Dequantize(uint16_t value) {
+    uint32_t r = value >> 11;
+    uint32_t g = (value >> 5) & 63u;
+    uint32_t b = value & 31u;
+    return {float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)),
+            float((b << 3) | (b >> 2)), 0.0f};
+  }
+
+  float Weight(uint8_t index) const {
+    constexpr float kWeights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+    return kWeights[index];
+  }
+
+  void Try(const glm::vec4 &e0, const glm::vec4 &e1) {
+    uint16_t q0 = Quantize(e0);
+    uint16_t q1 = Quantize(e1);
+    glm::vec4 palette[4];
+    palette[0] = Dequantize(q0);
+    palette[1] = Dequantize(q1);
+    palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+    palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+    float error = 0.0f;
+    for (int i = 0; i < 16; i++) {
+      float best = Distance2(texels[i], palette[0]);
+      indices[i] = 0;
+      for (uint8_t k = 1; k < 4; k++) {
+        float d = Distance2(texels[i], palette[k]);
+        if (d < best) {
+          best = d;
+          indices[i] = k;
+        }
+      }
+      error += best;
+    }
+    if (error < best_error) {
+      best_error = error;
+      endpoints[0] = q0;
+      endpoints[1] = q1;
+      std::copy(indices, indices + 16, best_indices);
+    }
+  }
+
+  void Write(uint8_t *out) {
+    // Four colour mode needs the first endpoint to be the larger one, equal
+    // endpoints select three colour mode where index 0 still is endpoint 0.
+    if (endpoints[0] < endpoints[1]) {
+      std::swap(endpoints[0], endpoints[1]);
+      for (auto &index : best_indices) {
+        index ^= 1u;
+      }
+    }
+    if (endpoints[0] == endpoints[1]) {
+      std::fill(best_indices, best_indices + 16, 0);
+    }
+    BlockWriter writer(out, 8);
+    writer.Write(endpoints[0], 16);
+    writer.Write(endpoints[1], 16);
+    for (int i = 0; i < 16; i++) {
+      writer.Write(best_indices[i], 2);
+    }
+  }
+
+  const glm::vec4 *texels;
+  uint8_t indices[16];
+  uint8_t best_indices[16]{};
+  uint16_t endpoints[2]{};
+  float best_error{std::numeric_limits<float>::max()};
+};
+
+// BC7 mode 6: one subset, 7-bit RGBA endpoints with a p-bit each and 4-bit
+// indices. Texels hold 0-255 RGBA.
+struct BC7Encoder {
+  // Picks the p-bit that brings the 8-bit endpoint closest to color.
+  static void Quantize(const glm::vec4 &color, uint32_t q[4], uint32_t &p) {
+    float best_error = std::numeric_limits<float>::max();
+    for (uint32_t pbit = 0; pbit < 2; pbit++) {
+      uint32_t candidate[4];
+      float error = 0.0f;
+      for (int c = 0; c < 4; c++) {
+        float v = std::clamp(color[c], 0.0f, 255.0f);
+        candidate[c] = uint32_t(
+            std::clamp(std::round((v - float(pbit)) * 0.5f), 0.0f, 127.0f));
+        float d = float((candidate[c] << 1) | pbit) - v;
+        error += d * d;
+      }
+      if (error < best_error) {
+        best_error = error;
+        std::copy(candidate, candidate + 4, q);
+        p = pbit;
+      }
+    }
+  }
+
+  float Weight(uint8_t index) const {
+    return kWeights4[index] / 64.0f;
+  }
+
+  void Try(const glm::vec4 &e0, const glm::vec4 &e1) {
+    uint32_t q[2][4];
+    uint32_t p[2];
+    Quantize(e0, q[0], p[0]);
+    Quantize(e1, q[1], p[1]);
+    int v0[4];
+    int v1[4];
+    for (int c = 0; c < 4; c++) {
+      v0[c] = int((q[0][c] << 1) | p[0]);
+      v1[c] = int((q[1][c] << 1) | p[1]);
+    }
+    glm::vec4 palette[16];
+    for (int k = 0; k < 16; k++) {
+      for (int c = 0; c < 4; c++) {
+        palette[k][c] = float(
+            ((64 - kWeights4[k]) * v0[c] + kWeights4[k] * v1[c] + 32) >> 6);
+      }
+    }
+    float error = 0.0f;
+    for (int i = 0; i < 16; i++) {
+      float best = Distance2(texels[i], palette[0]);
+      indices[i] = 0;
+      for (uint8_t k = 1; k < 16; k++) {
+        float d = Distance2(texels[i], palette[k]);
+        if (d < best) {
+          best = d;
+          indices[i] = k;
+        }
+      }
+      error += best;
+    }
+    if (error < best_error) {
+      best_error = error;
+      std::memcpy(endpoints, q, sizeof(q));
+      std::copy(p, p + 2, pbits);
+      std::copy(indices, indices + 16, best_indices);
+    }
+  }
+
+  void Write(uint8_t *out) {
+    // The most significant bit of the first index is implicitly zero.
+    if (best_indices[0] >= 8) {
+      for (int c = 0; c < 4; c++) {
+        std::swap(endpoints[0][c], endpoints[1][c]);
+      }
+      std::swap(pbits[0], pbits[1]);
+      for (auto &index : best_indices) {
+        index = 15 - index;
+      }
+    }
+    BlockWriter writer(out, 16);
+    writer.Write(1u << 6, 7);
+    for (int c = 0; c < 4; c++) {
+      writer.Write(endpoints[0][c], 7);
+      writer.Write(endpoints[1][c], 7);
+    }
+    writer.Write(pbits[0], 1);
+    writer.Write(pbits[1], 1);
+    writer.Write(best_indices[0], 3);
+    for (int i = 1; i < 16; i++) {
+      writer.Write(best_indices[i], 4);
+    }
+  }
+
+  const glm::vec4 *texels;
+  uint8_t indices[16];
+  uint8_t best_indices[16]{};
+  uint32_t endpoints[2][4]{};
+  uint32_t pbits[2]{};
+  float best_error{std::numeric_limits<float>::max()};
+};
+
+// BC6H mode 11: one region, untransformed 10-bit endpoints and 4-bit indices.
+// The hardware interpolates the bit patterns of half floats, so texels hold
+// the half bits of the colour scaled by 64 / 31 to the interpolation range.
+struct BC6HEncoder {
+  static int Unquantize(uint32_t q) {
+    if (q == 0) {
+      return 0;
+    }
+    if (q == 1023) {
+      return 0xffff;
+    }
+    return int(((q << 16) + 0x8000u) >> 10);
+  }
+
+  static uint32_t Quantize(float value) {
+    int guess = int(value / 64.0f);
+    uint32_t best = 0;
+    float best_error = std::numeric_limits<float>::max();
+    for (int q = std::max(guess - 1, 0); q <= std::min(guess + 1, 1023); q++) {
+      float error = std::abs(float(Unquantize(q)) - value);
+      if (error < best_error) {
+        best_error = error;
+        best = q;
+      }
+    }
+    return best;
+  }
+
+  float Weight(uint8_t index) const {
+    return kWeights4[index] / 64.0f;
+  }
+
+  void Try(const glm::vec4 &e0, const glm::vec4 &e1) {
+    uint32_t q[2][3];
+    int v0[3];
+    int v1[3];
+    for (int c = 0; c < 3; c++) {
+      q[0][c] = Quantize(e0[c]);
+      q[1][c] = Quantize(e1[c]);
+      v0[c] = Unquantize(q[0][c]);
+      v1[c] = Unquantize(q[1][c]);
+    }
+    glm::vec4 palette[16];
+    for (int k = 0; k < 16; k++) {
+      for (int c = 0; c < 3; c++) {
+        palette[k][c] = float(
+            ((64 - kWeights4[k]) * v0[c] + kWeights4[k] * v1[c] + 32) >> 6);
+      }
+      palette[k].a = 0.0f;
+    }
+    float error = 0.0f;
+    for (int i = 0; i < 16; i++) {
+      float best = Distance2(texels[i], palette[0]);
+      indices[i] = 0;
+      for (uint8_t k = 1; k < 16; k++) {
+        float d = Distance2(texels[i], palette[k]);
+        if (d < best) {
+          best = d;
+          indices[i] = k;
+        }
+      }
+      error += best;
+    }
+    if (error < best_error) {
+      best_error = error;
+      std::memcpy(endpoints, q, sizeof(q));
+      std::copy(indices, indices + 16, best_indices);
+    }
+  }
+
+  void Write(uint8_t *out) {
+    if (best_indices[0] >= 8) {
+      for (int c = 0; c < 3; c++) {
+        std::swap(endpoints[0][c], endpoints[1][c]);
+      }
+      for (auto &index : best_indices) {
+        index = 15 - index;
+      }
+    }
+    BlockWriter writer(out, 16);
+    writer.Write(0x03, 5);
+    for (int e = 0; e < 2; e++) {
+      for (int c = 0; c < 3; c++) {
+        writer.Write(endpoints[e][c], 10);
+      }
+    }
+    writer.Write(best_indices[0], 3);
+    for (int i = 1; i < 16; i++) {
+      writer.Write(best_indices[i], 4);
+    }
+  }
+
+  const glm::vec4 *texels;
+  uint8_t indices[16];
+  uint8_t best_indices[16]{};
+  uint32_t endpoints[2][3]{};
+  float best_error{std::numeric_limits<float>::max()};
+};
+
+// BC4 in eight value mode, the endpoints span the values of the block.
+void EncodeBC4Block(const float *values, uint8_t *out) {
+  float lower = 255.0f;
+  float upper = 0.0f;
+  for (int i = 0; i < 16; i++) {
+    lower = std::min(lower, values[i]);
+    upper = std::max(upper, values[i]);
+  }
+  uint32_t r0 = uint32_t(std::round(upper));
+  uint32_t r1 = uint32_t(std::round(lower));
+  float palette[8];
+  palette[0] = float(r0);
+  palette[1] = float(r1);
+  for (int k = 2; k < 8; k++) {
+    palette[k] = float((8 - k) * r0 + (k - 1) * r1) / 7.0f;
+  }
+  BlockWriter writer(out, 8);
+  writer.Write(r0, 8);
+  writer.Write(r1, 8);
+  for (int i = 0; i < 16; i++) {
+    uint32_t best_index = 0;
+    float best = std::abs(values[i] - palette[0]);
+    for (uint32_t k = 1; k < 8 && r0 != r1; k++) {
+      float d = std::abs(values[i] - palette[k]);
+      if (d < best) {
+        best = d;
+        best_index = k;
+      }
+    }
+    writer.Write(best_index, 3);
+  }
+}
+
+float EncodeUnorm8(float value) {
+  return std::round(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+}
+
+float EncodeSrgb8(float value) {
+  return float(FloatToByte(value, LDRColorSpace::SRGB));
+}
+
+float HalfBits(float value) {
+  // Negative values and NaN are not representable, larger values clamp to
+  // the largest finite half.
+  if (!(value > 0.0f)) {
+    return 0.0f;
+  }
+  value = std::min(value, 65504.0f);
+  return float(glm::packHalf1x16(value)) * (64.0f / 31.0f);
+}
+
+void EncodeBlock(const glm::vec4 *pixels,
+                 TextureFormat format,
+                 uint8_t *out) {
+  glm::vec4 texels[16];
+  switch (format) {
+    case TextureFormat::BC1Unorm:
+    case TextureFormat::BC1Srgb: {
+      for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+          texels[i][c] = format == TextureFormat::BC1Srgb
+                             ? EncodeSrgb8(pixels[i][c])
+                             : EncodeUnorm8(pixels[i][c]);
+        }
+        texels[i].a = 0.0f;
+      }
+      BC1Encoder encoder;
+      encoder.texels = texels;
+      FitEndpoints(texels, encoder);
+      encoder.Write(out);
+      break;
+    }
+    case TextureFormat::BC4Unorm:
+    case TextureFormat::BC5Unorm: {
+      int num_channels = format == TextureFormat::BC5Unorm ? 2 : 1;
+      for (int c = 0; c < num_channels; c++) {
+        float values[16];
+        for (int i = 0; i < 16; i++) {
+          values[i] = EncodeUnorm8(pixels[i][c]);
+        }
+        EncodeBC4Block(values, out + c * 8);
+      }
+      break;
+    }
+    case TextureFormat::BC6HUfloat: {
+      for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+          texels[i][c] = HalfBits(pixels[i][c]);
+        }
+        texels[i].a = 0.0f;
+      }
+      BC6HEncoder encoder;
+      encoder.texels = texels;
+      FitEndpoints(texels, encoder);
+      encoder.Write(out);
+      break;
+    }
+    default: {
+      for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+          texels[i][c] = format == TextureFormat::BC7Srgb
+                             ? EncodeSrgb8(pixels[i][c])
+                             : EncodeUnorm8(pixels[i][c]);
+        }
+        texels[i].a = EncodeUnorm8(pixels[i].a);
+      }
+      BC7Encoder encoder;
+      encoder.texels = texels;
+      FitEndpoints(texels, encoder);
+      encoder.Write(out);
+      break;
+    }
+  }
+}
+
+uint64_t TextureCacheKey(const Texture &texture, TextureFormat format) {
+  uint64_t hash = HashCombine(kTextureCacheVersion, uint32_t(format));
+  hash = HashCombine(hash, texture.Width());
+  hash = HashCombine(hash, texture.Height());
+  return HashBytes(texture.Data(),
+                   size_t(texture.Width()) * texture.Height() *
+                       sizeof(glm::vec4),
+                   hash);
+}
+
+}  // namespace
+
+bool IsBlockCompressed(TextureFormat format) {
+  switch (format) {
+    case TextureFormat::BC1Unorm:
+    case TextureFormat::BC1Srgb:
+    case TextureFormat::BC4Unorm:
+    case TextureFormat::BC5Unorm:
+    case TextureFormat::BC6HUfloat:
+    case TextureFormat::BC7Unorm:
+    case TextureFormat::BC7Srgb:
+      return true;
+    default:
+      return false;
+  }
+}
+
+uint32_t CompressedBlockSize(TextureFormat format) {
+  switch (format) {
+    case TextureFormat::BC1Unorm:
+    case TextureFormat::BC1Srgb:
+    case TextureFormat::BC4Unorm:
+      return 8;
+    default:
+      return 16;
+  }
+}
+
+int LoadTextureCache(uint64_t key,
+                     uint32_t width,
+                     uint32_t height,
+                     TextureFormat format,
+                     std::vector<uint8_t> &data) {
+  std::string path = CacheFilePath("texture", key);
+  MappedFile file;
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec) || file.Open(path)) {
+    return -1;
+  }
+
+  TextureCacheHeader header{};
+  if (file.Size() < sizeof(header)) {
+    return -1;
+  }
+  std::memcpy(&header, file.Data(), sizeof(header));
+  if (header.magic != kTextureCacheMagic ||
+      header.version != kTextureCacheVersion || header.key != key ||
+      header.format != uint32_t(format) || header.width != width ||
+      header.height != height) {
+    return -1;
+  }
+  if (file.Size() != sizeof(header) + header.size) {
+    LogWarning("Ignoring truncated texture cache: {}", path);
+    return -1;
+  }
+  data.resize(header.size);
+  std::memcpy(data.data(), file.Data() + sizeof(header), header.size);
+  return 0;
+}
+
+int SaveTextureCache(uint64_t key,
+                     uint32_t width,
+                     uint32_t height,
+                     TextureFormat format,
+                     const std::vector<uint8_t> &data) {
+  TextureCacheHeader header{};
+  header.magic = kTextureCacheMagic;
+  header.version = kTextureCacheVersion;
+  header.key = key;
+  header.format = uint32_t(format);
+  header.width = width;
+  header.height = height;
+  header.size = data.size();
+  return WriteCacheFile(
+      CacheFilePath("texture", key),
+      {{&header, sizeof(header)}, {data.data(), data.size()}});
+}
+
+TextureFormat CompressedTextureFormat(const Texture &texture,
+                                      bool prefer_bc1) {
+  bool opaque = true;
+  const glm::vec4 *pixels = texture.Data();
+  for (size_t i = 0; i < size_t(texture.Width()) * texture.Height(); i++) {
+    if (pixels[i].a < 1.0f - 0.5f / 255.0f) {
+      opaque = false;
+      break;
+    }
+  }
+  return CompressedTextureFormat(texture.Format(), opaque, prefer_bc1);
+}
+
+TextureFormat CompressedTextureFormat(TextureFormat format,
+                                      bool opaque,
+                                      bool prefer_bc1) {
+  switch (format) {
+    case TextureFormat::RGBA8Srgb:
+      return prefer_bc1 && opaque ? TextureFormat::BC1Srgb
+                                  : TextureFormat::BC7Srgb;
+    case TextureFormat::RGBA8Unorm:
+    case TextureFormat::RGBA16Unorm:
+      return prefer_bc1 && opaque ? TextureFormat::BC1Unorm
+                                  : TextureFormat::BC7Unorm;
+    case TextureFormat::RGBA16Float:
+    case TextureFormat::RGB9E5Float:
+    case TextureFormat::RGBA32Float:
+      return opaque ? TextureFormat::BC6HUfloat : format;
+    case TextureFormat::R8Unorm:
+    case TextureFormat::R16Unorm:
+      return TextureFormat::BC4Unorm;
+    default:
+      return format;
+  }
+}
+
+int CompressTexture(const Texture &texture,
+                    TextureFormat format,
+                    std::vector<uint8_t> &data,
+                    bool use_cache) {
+  if (!IsBlockCompressed(format)) {
+    return -1;
+  }
+
+  uint64_t key = 0;
+  if (use_cache) {
+    key = TextureCacheKey(texture, format);
+    if (!LoadTextureCache(key, texture.Width(), texture.Height(), format,
+                          data)) {
+      return 0;
+    }
+  }
+
+  const uint32_t width = texture.Width();
+  const uint32_t height = texture.Height();
+  const uint32_t blocks_x = (width + 3) / 4;
+  const uint32_t blocks_y = (height + 3) / 4;
+  const uint32_t block_size = CompressedBlockSize(format);
+  data.resize(size_t(blocks_x) * blocks_y * block_size);
+  ParallelFor(blocks_y, [&](uint64_t begin, uint64_t end) {
+    glm::vec4 pixels[16];
+    for (uint64_t by = begin; by < end; by++) {
+      for (uint32_t bx = 0; bx < blocks_x; bx++) {
+        for (uint32_t i = 0; i < 16; i++) {
+          uint32_t x = std::min(bx * 4 + (i & 3u), width - 1);
+          uint32_t y = std::min(uint32_t(by) * 4 + (i >> 2), height - 1);
+          pixels[i] = texture(x, y);
+        }
+        EncodeBlock(pixels, format,
+                    data.data() + (by * blocks_x + bx) * block_size);
+      }
+    }
+  });
+
+  if (use_cache) {
+    SaveTextureCache(key, texture.Width(), texture.Height(), format, data);
+  }
+  return 0;
+}
+
+}  // namespace sparks
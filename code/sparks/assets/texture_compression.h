@@ -0,0 +1,49 @@
+#pragma once
+#include "sparks/assets/texture.h"
+
+namespace sparks {
+
+// Bump whenever an encoder changes its output, stale entries are then
+// ignored.
+constexpr uint32_t kTextureCacheVersion = 1;
+
+bool IsBlockCompressed(TextureFormat format);
+
+// Bytes per 4x4 texel block.
+uint32_t CompressedBlockSize(TextureFormat format);
+
+// Block compressed counterpart of an uncompressed format: BC7 for 8 and 16-bit
+// colour (BC1 if prefer_bc1 is set and the texture is opaque), BC6H for opaque
+// float textures and BC4 for scalar data. Formats without a counterpart are
+// returned unchanged.
+TextureFormat CompressedTextureFormat(const Texture &texture, bool prefer_bc1);
+
+// Same choice for a texture that is not held in memory, see TextureReader.
+TextureFormat CompressedTextureFormat(TextureFormat format,
+                                      bool opaque,
+                                      bool prefer_bc1);
+
+// Encodes the texture block by block, texels past the edges repeat the last
+// row and column. Results are kept in the disk cache under a hash of the
+// pixels and the format. Returns -1 if format is not block compressed.
+int CompressTexture(const Texture &texture,
+                    TextureFormat format,
+                    std::vector<uint8_t> &data,
+                    bool use_cache = true);
+
+// Entries of the texture cache under a key chosen by the caller, for encoders
+// that never hold the whole texture. The key must change with the pixels, the
+// size and the format are checked against the entry.
+int LoadTextureCache(uint64_t key,
+                     uint32_t width,
+                     uint32_t height,
+                     TextureFormat format,
+                     std::vector<uint8_t> &data);
+
+int SaveTextureCache(uint64_t key,
+                     uint32_t width,
+                     uint32_t height,
+                     TextureFormat format,
+                     const std::vector<uint8_t> &data);
+
+}  // namespace sparks
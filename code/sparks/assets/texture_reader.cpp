@@ -0,0 +1,257 @@
+#include "sparks/assets/texture_reader.h"
+
+#include "cmath"
+#include "cstdio"
+#include "cstring"
+#include "stb_image.h"
+
+namespace sparks {
+
+namespace {
+// Decodes integer channels of an LDR image, alpha is always linear.
+template <class T>
+void DecodeLDRPixels(const T *pixels,
+                     size_t count,
+                     float max_value,
+                     LDRColorSpace ldr_color_space,
+                     glm::vec4 *result) {
+  for (size_t i = 0; i < count; i++) {
+    glm::vec4 pixel{pixels[i * 4], pixels[i * 4 + 1], pixels[i * 4 + 2],
+                    pixels[i * 4 + 3]};
+    pixel /= max_value;
+    if (ldr_color_space == LDRColorSpace::SRGB) {
+      pixel.r = SrgbToLinear(pixel.r);
+      pixel.g = SrgbToLinear(pixel.g);
+      pixel.b = SrgbToLinear(pixel.b);
+    }
+    result[i] = pixel;
+  }
+}
+
+template <class T>
+bool IsOpaque(const T *pixels, size_t count, T max_value) {
+  for (size_t i = 0; i < count; i++) {
+    if (pixels[i * 4 + 3] != max_value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reads the line starting at offset and moves offset past it.
+bool ReadLine(const char *data,
+              size_t size,
+              size_t &offset,
+              std::string &line) {
+  const void *end = std::memchr(data + offset, '\n', size - offset);
+  if (!end) {
+    return false;
+  }
+  size_t length = static_cast<const char *>(end) - (data + offset);
+  line.assign(data + offset, length);
+  offset += length + 1;
+  return true;
+}
+
+// Same conversion as stb_image, alpha reads as 1.
+glm::vec4 DecodeRGBE(const uint8_t *rgbe) {
+  if (!rgbe[3]) {
+    return glm::vec4{0.0f, 0.0f, 0.0f, 1.0f};
+  }
+  float scale = std::ldexp(1.0f, int(rgbe[3]) - (128 + 8));
+  return glm::vec4{rgbe[0] * scale, rgbe[1] * scale, rgbe[2] * scale, 1.0f};
+}
+}  // namespace
+
+TextureReader::~TextureReader() {
+  if (ldr_pixels_) {
+    stbi_image_free(ldr_pixels_);
+  }
+}
+
+int TextureReader::Open(const std::string &file_path,
+                        LDRColorSpace ldr_color_space) {
+  if (ldr_pixels_) {
+    stbi_image_free(ldr_pixels_);
+    ldr_pixels_ = nullptr;
+  }
+  radiance_file_.Close();
+  next_row_ = 0;
+  ldr_color_space_ = ldr_color_space;
+  opaque_ = true;
+  source_key_ = 0;
+  uint64_t file_key = 0;
+  if (!SourceFileKey(file_path, file_key)) {
+    source_key_ = HashCombine(file_key, uint64_t(ldr_color_space));
+  }
+
+  if (stbi_is_hdr(file_path.c_str())) {
+    return OpenRadiance(file_path);
+  }
+
+  int width = 0;
+  int height = 0;
+  ldr_16_bit_ = stbi_is_16_bit(file_path.c_str());
+  if (ldr_16_bit_) {
+    ldr_pixels_ = stbi_load_16(file_path.c_str(), &width, &height, nullptr, 4);
+  } else {
+    ldr_pixels_ = stbi_load(file_path.c_str(), &width, &height, nullptr, 4);
+  }
+  if (!ldr_pixels_) {
+    return -1;
+  }
+  width_ = width;
+  height_ = height;
+  const size_t count = size_t(width_) * height_;
+  if (ldr_16_bit_) {
+    opaque_ = IsOpaque(static_cast<const stbi_us *>(ldr_pixels_), count,
+                       stbi_us(65535));
+    // There is no 16-bit sRGB format, decoded values need the extra range
+    // of half floats near zero.
+    format_ = ldr_color_space == LDRColorSpace::SRGB
+                  ? TextureFormat::RGBA16Float
+                  : TextureFormat::RGBA16Unorm;
+  } else {
+    opaque_ = IsOpaque(static_cast<const stbi_uc *>(ldr_pixels_), count,
+                       stbi_uc(255));
+    format_ = ldr_color_space == LDRColorSpace::SRGB
+                  ? TextureFormat::RGBA8Srgb
+                  : TextureFormat::RGBA8Unorm;
+  }
+  return 0;
+}
+
+int TextureReader::OpenRadiance(const std::string &file_path) {
+  if (radiance_file_.Open(file_path)) {
+    return -1;
+  }
+  const char *data = radiance_file_.Data();
+  const size_t size = radiance_file_.Size();
+
+  // Header lines up to an empty one, then the resolution line.
+  size_t offset = 0;
+  std::string line;
+  if (!ReadLine(data, size, offset, line) ||
+      (line != "#?RADIANCE" && line != "#?RGBE")) {
+    return -1;
+  }
+  bool rle_rgbe = false;
+  while (true) {
+    if (!ReadLine(data, size, offset, line)) {
+      return -1;
+    }
+    if (line.empty()) {
+      break;
+    }
+    if (line == "FORMAT=32-bit_rle_rgbe") {
+      rle_rgbe = true;
+    }
+  }
+  if (!rle_rgbe) {
+    LogWarning("Unsupported Radiance format: {}", file_path);
+    return -1;
+  }
+
+  // Only the usual top to bottom, left to right orientation, as stb_image.
+  int width = 0;
+  int height = 0;
+  if (!ReadLine(data, size, offset, line) ||
+      std::sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 ||
+      width <= 0 || height <= 0) {
+    LogWarning("Unsupported Radiance orientation: {}", file_path);
+    return -1;
+  }
+  radiance_offset_ = offset;
+  radiance_flat_ = false;
+  width_ = width;
+  height_ = height;
+  format_ = TextureFormat::RGB9E5Float;
+  rgbe_row_.resize(size_t(width_) * 4);
+  return 0;
+}
+
+int TextureReader::ReadRadianceRow(glm::vec4 *pixels) {
+  const uint8_t *data =
+      reinterpret_cast<const uint8_t *>(radiance_file_.Data());
+  const size_t size = radiance_file_.Size();
+  size_t &offset = radiance_offset_;
+
+  // Scanlines are run length encoded per channel if they start with
+  // 2, 2 and the width, otherwise they hold flat RGBE quadruples. As in
+  // stb_image, the first flat scanline makes the rest of the file flat.
+  bool rle = !radiance_flat_ && width_ >= 8 && width_ < 32768 &&
+             offset + 4 <= size && data[offset] == 2 &&
+             data[offset + 1] == 2 && !(data[offset + 2] & 0x80);
+  if (!rle) {
+    radiance_flat_ = true;
+    if (offset + rgbe_row_.size() > size) {
+      return -1;
+    }
+    std::memcpy(rgbe_row_.data(), data + offset, rgbe_row_.size());
+    offset += rgbe_row_.size();
+  } else {
+    if (((uint32_t(data[offset + 2]) << 8) | data[offset + 3]) != width_) {
+      return -1;
+    }
+    offset += 4;
+    for (uint32_t channel = 0; channel < 4; channel++) {
+      uint32_t x = 0;
+      while (x < width_) {
+        if (offset >= size) {
+          return -1;
+        }
+        uint32_t count = data[offset++];
+        if (count > 128) {
+          count -= 128;
+          if (count > width_ - x || offset >= size) {
+            return -1;
+          }
+          uint8_t value = data[offset++];
+          for (uint32_t i = 0; i < count; i++) {
+            rgbe_row_[(x + i) * 4 + channel] = value;
+          }
+        } else {
+          if (!count || count > width_ - x || offset + count > size) {
+            return -1;
+          }
+          for (uint32_t i = 0; i < count; i++) {
+            rgbe_row_[(x + i) * 4 + channel] = data[offset++];
+          }
+        }
+        x += count;
+      }
+    }
+  }
+
+  for (uint32_t x = 0; x < width_; x++) {
+    pixels[x] = DecodeRGBE(rgbe_row_.data() + x * 4);
+  }
+  return 0;
+}
+
+int TextureReader::ReadRows(uint32_t num_rows, glm::vec4 *pixels) {
+  if (num_rows > height_ - next_row_) {
+    return -1;
+  }
+  if (ldr_pixels_) {
+    const size_t first = size_t(next_row_) * width_ * 4;
+    const size_t count = size_t(num_rows) * width_;
+    if (ldr_16_bit_) {
+      DecodeLDRPixels(static_cast<const stbi_us *>(ldr_pixels_) + first,
+                      count, 65535.0f, ldr_color_space_, pixels);
+    } else {
+      DecodeLDRPixels(static_cast<const stbi_uc *>(ldr_pixels_) + first,
+                      count, 255.0f, ldr_color_space_, pixels);
+    }
+  } else {
+    for (uint32_t i = 0; i < num_rows; i++) {
+      if (ReadRadianceRow(pixels + size_t(i) * width_)) {
+        return -1;
+      }
+    }
+  }
+  next_row_ += num_rows;
+  return 0;
+}
+
+}  // namespace sparks
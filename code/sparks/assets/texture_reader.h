@@ -0,0 +1,71 @@
+#pragma once
+#include "sparks/assets/texture.h"
+
+namespace sparks {
+
+// Decodes an image file a few rows at a time, so that the whole image never
+// has to be held as floats. Radiance files are decoded scanline by scanline
+// straight from the mapped file, other formats are kept as the 8 or 16-bit
+// integers stb_image produces and converted on request.
+class TextureReader {
+ public:
+  TextureReader() = default;
+  ~TextureReader();
+
+  TextureReader(const TextureReader &) = delete;
+  TextureReader &operator=(const TextureReader &) = delete;
+
+  int Open(const std::string &file_path,
+           LDRColorSpace ldr_color_space = LDRColorSpace::SRGB);
+
+  uint32_t Width() const {
+    return width_;
+  }
+
+  uint32_t Height() const {
+    return height_;
+  }
+
+  // The format Texture::LoadFromFile assigns to the image.
+  TextureFormat Format() const {
+    return format_;
+  }
+
+  // True if no pixel has an alpha below 255/255, Radiance files always are.
+  bool Opaque() const {
+    return opaque_;
+  }
+
+  // Changes whenever the file or the decoding settings change, for caching
+  // derived data of the image.
+  uint64_t SourceKey() const {
+    return source_key_;
+  }
+
+  // Decodes the next num_rows rows into pixels, which holds num_rows * Width()
+  // elements. Returns -1 past the last row or on malformed scanlines.
+  int ReadRows(uint32_t num_rows, glm::vec4 *pixels);
+
+ private:
+  int OpenRadiance(const std::string &file_path);
+  int ReadRadianceRow(glm::vec4 *pixels);
+
+  uint32_t width_{};
+  uint32_t height_{};
+  uint32_t next_row_{};
+  TextureFormat format_{TextureFormat::RGBA8Unorm};
+  LDRColorSpace ldr_color_space_{LDRColorSpace::SRGB};
+  bool opaque_{true};
+  uint64_t source_key_{};
+
+  MappedFile radiance_file_;
+  size_t radiance_offset_{};
+  bool radiance_flat_{false};
+  std::vector<uint8_t> rgbe_row_;
+
+  // 4 channels of stbi_uc or stbi_us, released with stbi_image_free.
+  void *ldr_pixels_{nullptr};
+  bool ldr_16_bit_{false};
+};
+
+}  // namespace sparks
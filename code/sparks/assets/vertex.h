@@ -61,7 +61,7 @@ struct Vertex {
 
   bool operator==(const Vertex &vertex) const {
     return position == vertex.position && normal == vertex.normal &&
-           tex_coord == tex_coord && tangent == vertex.tangent &&
+           tex_coord == vertex.tex_coord && tangent == vertex.tangent &&
            signal == vertex.signal;
   }
 
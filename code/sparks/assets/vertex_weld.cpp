@@ -0,0 +1,229 @@
+#include "sparks/assets/vertex_weld.h"
+
+#include "algorithm"
+#include "cmath"
+#include "cstring"
+
+namespace sparks {
+
+namespace {
+
+constexpr uint32_t kNumPartitionBits = 8;
+constexpr uint32_t kNumPartitions = 1u << kNumPartitionBits;
+constexpr uint64_t kPartitionChunkSize = 1u << 16;
+constexpr uint32_t kEmptySlot = 0xffffffffu;
+
+uint64_t HashFloat(uint64_t seed, float value) {
+  // -0.0f and 0.0f compare equal, so they have to hash equally as well.
+  if (value == 0.0f) {
+    value = 0.0f;
+  }
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return HashCombine(seed, bits);
+}
+
+int64_t Quantize(float value, float epsilon) {
+  return static_cast<int64_t>(std::floor(value / epsilon));
+}
+
+uint64_t HashVec3(uint64_t seed, const glm::vec3 &value, float epsilon) {
+  if (epsilon > 0.0f) {
+    for (int i = 0; i < 3; i++) {
+      seed = HashCombine(seed, Quantize(value[i], epsilon));
+    }
+    return seed;
+  }
+  for (int i = 0; i < 3; i++) {
+    seed = HashFloat(seed, value[i]);
+  }
+  return seed;
+}
+
+bool EqualVec3(const glm::vec3 &a, const glm::vec3 &b, float epsilon) {
+  if (epsilon > 0.0f) {
+    for (int i = 0; i < 3; i++) {
+      if (Quantize(a[i], epsilon) != Quantize(b[i], epsilon)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return a == b;
+}
+
+uint64_t HashVertex(const Vertex &vertex, const VertexWeldSettings &settings) {
+  uint64_t hash = HashVec3(0, vertex.position, settings.position_epsilon);
+  hash = HashVec3(hash, vertex.normal, settings.normal_epsilon);
+  hash = HashVec3(hash, vertex.tangent, 0.0f);
+  hash = HashFloat(hash, vertex.tex_coord.x);
+  hash = HashFloat(hash, vertex.tex_coord.y);
+  return HashFloat(hash, vertex.signal);
+}
+
+bool EqualVertex(const Vertex &a,
+                 const Vertex &b,
+                 const VertexWeldSettings &settings) {
+  return EqualVec3(a.position, b.position, settings.position_epsilon) &&
+         EqualVec3(a.normal, b.normal, settings.normal_epsilon) &&
+         a.tangent == b.tangent && a.tex_coord == b.tex_coord &&
+         a.signal == b.signal;
+}
+
+}  // namespace
+
+std::vector<uint32_t> FindFirstEqualKeys(
+    const std::vector<uint64_t> &hashes,
+    const std::function<bool(uint32_t, uint32_t)> &equal) {
+  const uint64_t num_keys = hashes.size();
+  std::vector<uint32_t> first(num_keys);
+  if (!num_keys) {
+    return first;
+  }
+
+  // Stable radix partition by the top hash bits, the chunk layout only depends
+  // on the number of keys.
+  const uint64_t num_chunks =
+      (num_keys + kPartitionChunkSize - 1) / kPartitionChunkSize;
+  std::vector<uint32_t> partition_offsets(num_chunks * kNumPartitions, 0);
+  auto partition_of = [&hashes](uint64_t key) {
+    return static_cast<uint32_t>(hashes[key] >> (64 - kNumPartitionBits));
+  };
+
+  ParallelFor(
+      num_chunks,
+      [&](uint64_t begin, uint64_t end) {
+        for (uint64_t chunk = begin; chunk < end; chunk++) {
+          uint32_t *counts = &partition_offsets[chunk * kNumPartitions];
+          uint64_t key_end =
+              std::min(num_keys, (chunk + 1) * kPartitionChunkSize);
+          for (uint64_t key = chunk * kPartitionChunkSize; key < key_end;
+               key++) {
+            counts[partition_of(key)]++;
+          }
+        }
+      },
+      1);
+
+  std::vector<uint32_t> partition_begin(kNumPartitions + 1, 0);
+  uint32_t offset = 0;
+  for (uint32_t partition = 0; partition < kNumPartitions; partition++) {
+    partition_begin[partition] = offset;
+    for (uint64_t chunk = 0; chunk < num_chunks; chunk++) {
+      uint32_t count = partition_offsets[chunk * kNumPartitions + partition];
+      partition_offsets[chunk * kNumPartitions + partition] = offset;
+      offset += count;
+    }
+  }
+  partition_begin[kNumPartitions] = offset;
+
+  std::vector<uint32_t> partitioned_keys(num_keys);
+  ParallelFor(
+      num_chunks,
+      [&](uint64_t begin, uint64_t end) {
+        for (uint64_t chunk = begin; chunk < end; chunk++) {
+          uint32_t *offsets = &partition_offsets[chunk * kNumPartitions];
+          uint64_t key_end =
+              std::min(num_keys, (chunk + 1) * kPartitionChunkSize);
+          for (uint64_t key = chunk * kPartitionChunkSize; key < key_end;
+               key++) {
+            partitioned_keys[offsets[partition_of(key)]++] = key;
+          }
+        }
+      },
+      1);
+
+  // Keys of a partition are visited in increasing order, so the first key
+  // inserted for an equivalence class is also the smallest one.
+  ParallelFor(
+      kNumPartitions,
+      [&](uint64_t begin, uint64_t end) {
+        std::vector<uint32_t> table;
+        for (uint64_t partition = begin; partition < end; partition++) {
+          uint32_t key_begin = partition_begin[partition];
+          uint32_t key_end = partition_begin[partition + 1];
+          if (key_begin == key_end) {
+            continue;
+          }
+          uint64_t table_size = 16;
+          while (table_size < uint64_t(key_end - key_begin) * 2) {
+            table_size <<= 1;
+          }
+          table.assign(table_size, kEmptySlot);
+          const uint64_t mask = table_size - 1;
+          for (uint32_t i = key_begin; i < key_end; i++) {
+            uint32_t key = partitioned_keys[i];
+            uint64_t slot = hashes[key] & mask;
+            while (true) {
+              uint32_t candidate = table[slot];
+              if (candidate == kEmptySlot) {
+                table[slot] = key;
+                first[key] = key;
+                break;
+              }
+              if (hashes[candidate] == hashes[key] && equal(candidate, key)) {
+                first[key] = candidate;
+                break;
+              }
+              slot = (slot + 1) & mask;
+            }
+          }
+        }
+      },
+      1);
+
+  return first;
+}
+
+void WeldVertices(const std::vector<Vertex> &vertices,
+                  const std::vector<uint32_t> &indices,
+                  std::vector<Vertex> &welded_vertices,
+                  std::vector<uint32_t> &welded_indices,
+                  const VertexWeldSettings &settings) {
+  // Referenced vertices in the order of their first reference.
+  std::vector<uint32_t> reference_order(vertices.size(), kEmptySlot);
+  std::vector<uint32_t> referenced;
+  referenced.reserve(vertices.size());
+  for (auto index : indices) {
+    if (reference_order[index] == kEmptySlot) {
+      reference_order[index] = referenced.size();
+      referenced.push_back(index);
+    }
+  }
+
+  std::vector<uint64_t> hashes(referenced.size());
+  ParallelFor(referenced.size(), [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; i++) {
+      hashes[i] = HashVertex(vertices[referenced[i]], settings);
+    }
+  });
+
+  std::vector<uint32_t> first =
+      FindFirstEqualKeys(hashes, [&](uint32_t a, uint32_t b) {
+        return EqualVertex(vertices[referenced[a]], vertices[referenced[b]],
+                           settings);
+      });
+
+  std::vector<Vertex> result_vertices;
+  std::vector<uint32_t> welded_id(referenced.size());
+  for (uint32_t i = 0; i < referenced.size(); i++) {
+    if (first[i] == i) {
+      welded_id[i] = result_vertices.size();
+      result_vertices.push_back(vertices[referenced[i]]);
+    } else {
+      welded_id[i] = welded_id[first[i]];
+    }
+  }
+
+  std::vector<uint32_t> result_indices(indices.size());
+  ParallelFor(indices.size(), [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; i++) {
+      result_indices[i] = welded_id[reference_order[indices[i]]];
+    }
+  });
+
+  welded_vertices = std::move(result_vertices);
+  welded_indices = std::move(result_indices);
+}
+
+}  // namespace sparks
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "functional"
+#include "sparks/assets/vertex.h"
+#include "vector"
+
+namespace sparks {
+
+struct VertexWeldSettings {
+  // Positions (normals) falling into the same grid cell of this size are
+  // treated as equal, 0 requires the values to match exactly. All the other
+  // attributes always have to match exactly.
+  float position_epsilon{0.0f};
+  float normal_epsilon{0.0f};
+};
+
+// For every key i, finds the smallest index j with hashes[j] == hashes[i] and
+// equal(j, i). Keys are partitioned by hash and each partition is resolved on
+// its own thread with an open-addressing table, the result does not depend on
+// the number of worker threads.
+std::vector<uint32_t> FindFirstEqualKeys(
+    const std::vector<uint64_t> &hashes,
+    const std::function<bool(uint32_t, uint32_t)> &equal);
+
+// Merges equal vertices. The welded vertices keep the order of their first
+// reference in indices, unreferenced vertices are dropped.
+void WeldVertices(const std::vector<Vertex> &vertices,
+                  const std::vector<uint32_t> &indices,
+                  std::vector<Vertex> &welded_vertices,
+                  std::vector<uint32_t> &welded_indices,
+                  const VertexWeldSettings &settings = {});
+
+}  // namespace sparks
@@ -48,6 +48,12 @@ void Renderer::CreateCommonObjects() {
        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR,
         nullptr},
        {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+        nullptr},
+       {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+        nullptr},
+       {4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+        nullptr},
+       {5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR,
         nullptr}},
       &scene_descriptor_set_layout_);
 }
@@ -257,11 +263,42 @@ void Renderer::CreateEntityPipeline() {
   pipeline_settings.SetCullMode(VK_CULL_MODE_NONE);
 
   core_->Device()->CreatePipeline(pipeline_settings, &entity_pipeline_);
+
+  // Compact vertices are fetched as raw words and decoded in the shader.
+  core_->Device()->CreateShaderModule(
+      vulkan::CompileGLSLToSPIRV(
+          GetShaderCode("shaders/entity_pass_compact.vert"),
+          VK_SHADER_STAGE_VERTEX_BIT),
+      &entity_compact_vertex_shader_);
+
+  vulkan::PipelineSettings compact_pipeline_settings{
+      render_pass_.get(), entity_pipeline_layout_.get(), 0};
+  compact_pipeline_settings.AddInputBinding(
+      0, VertexStride(VertexFormat::Compact), VK_VERTEX_INPUT_RATE_VERTEX);
+  compact_pipeline_settings.AddInputAttribute(0, 0, VK_FORMAT_R32G32B32_SFLOAT,
+                                              0);
+  compact_pipeline_settings.AddInputAttribute(0, 1, VK_FORMAT_R32_UINT, 12);
+  compact_pipeline_settings.AddInputAttribute(0, 2, VK_FORMAT_R32_UINT, 16);
+  compact_pipeline_settings.AddInputAttribute(0, 3, VK_FORMAT_R32_UINT, 20);
+
+  compact_pipeline_settings.AddShaderStage(entity_compact_vertex_shader_.get(),
+                                           VK_SHADER_STAGE_VERTEX_BIT);
+  compact_pipeline_settings.AddShaderStage(entity_fragment_shader_.get(),
+                                           VK_SHADER_STAGE_FRAGMENT_BIT);
+
+  compact_pipeline_settings.SetPrimitiveTopology(
+      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+  compact_pipeline_settings.SetCullMode(VK_CULL_MODE_NONE);
+
+  core_->Device()->CreatePipeline(compact_pipeline_settings,
+                                  &entity_compact_pipeline_);
 }
 
 void Renderer::DestroyEntityPipeline() {
+  entity_compact_pipeline_.reset();
   entity_pipeline_.reset();
 
+  entity_compact_vertex_shader_.reset();
   entity_vertex_shader_.reset();
   entity_fragment_shader_.reset();
 
@@ -591,9 +628,6 @@ void Renderer::RenderScene(VkCommandBuffer cmd_buffer,
 
   scene->DrawEnvmap(cmd_buffer, core_->CurrentFrame());
 
-  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    entity_pipeline_->Handle());
-
   scene->DrawEntities(cmd_buffer, core_->CurrentFrame());
 
   VkClearAttachment clearAttachment = {};
@@ -636,6 +670,8 @@ void Renderer::RenderScene(VkCommandBuffer cmd_buffer,
 void Renderer::RenderSceneRayTracing(VkCommandBuffer cmd_buffer,
                                      RayTracingFilm *film,
                                      Scene *scene) {
+  scene->BuildTopLevelAccelerationStructure(cmd_buffer, core_->CurrentFrame());
+
   vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
                     raytracing_pipeline_->Handle());
 
@@ -51,7 +51,11 @@ class Renderer {
     return raytracing_film_descriptor_set_layout_.get();
   }
 
-  vulkan::Pipeline *EntityPipeline() {
+  vulkan::Pipeline *EntityPipeline(
+      VertexFormat vertex_format = VertexFormat::Full) {
+    if (vertex_format == VertexFormat::Compact) {
+      return entity_compact_pipeline_.get();
+    }
     return entity_pipeline_.get();
   }
 
@@ -136,6 +140,8 @@ class Renderer {
   std::unique_ptr<vulkan::ShaderModule> entity_vertex_shader_;
   std::unique_ptr<vulkan::ShaderModule> entity_fragment_shader_;
   std::unique_ptr<vulkan::Pipeline> entity_pipeline_;
+  std::unique_ptr<vulkan::ShaderModule> entity_compact_vertex_shader_;
+  std::unique_ptr<vulkan::Pipeline> entity_compact_pipeline_;
 
   std::unique_ptr<vulkan::DescriptorSetLayout> envmap_descriptor_set_layout_;
   std::unique_ptr<vulkan::PipelineLayout> envmap_pipeline_layout_;
@@ -0,0 +1,36 @@
+#ifndef ALIAS_TABLE_GLSL
+#define ALIAS_TABLE_GLSL
+
+// Keep in sync with AliasEntry in sparks/utils/alias_table.h.
+// Largest float below 1.
+#define ALIAS_TABLE_ONE_MINUS_EPSILON 0.99999994
+
+struct AliasEntry {
+  float threshold;
+  uint alias;
+  float pdf;
+  uint payload;
+};
+
+// Picks a slot of a table with n entries from r, and rescales the remaining
+// fraction of r to [0, 1) for AliasTableResolve.
+uint AliasTableSlot(uint n, inout float r) {
+  float x = r * float(n);
+  uint slot = min(uint(x), n - 1);
+  r = clamp(x - float(slot), 0.0, ALIAS_TABLE_ONE_MINUS_EPSILON);
+  return slot;
+}
+
+// Decides between the slot and its alias, r is rescaled to [0, 1) again so
+// the caller can keep using it.
+uint AliasTableResolve(AliasEntry entry, uint slot, inout float r) {
+  if (r < entry.threshold) {
+    r = min(r / entry.threshold, ALIAS_TABLE_ONE_MINUS_EPSILON);
+    return slot;
+  }
+  r = min((r - entry.threshold) / (1.0 - entry.threshold),
+          ALIAS_TABLE_ONE_MINUS_EPSILON);
+  return entry.alias;
+}
+
+#endif
@@ -1,22 +1,137 @@
 #ifndef ENTITY_DIRECT_LIGHTING_GLSL
 #define ENTITY_DIRECT_LIGHTING_GLSL
 
+#include "alias_table.glsl"
 #include "entity_metadata.glsl"
+#include "index.glsl"
+#include "light_bvh.glsl"
 #include "material.glsl"
 #include "mesh_metadata.glsl"
+#include "primitive.glsl"
 #include "shadow_ray.glsl"
 #include "vertex.glsl"
 
-float EntityCDF(int x) {
-  if (x < 0)
-    return 0.0;
-  return metadatas[x].emission_cdf;
+// Walks from the root of the light BVH to a leaf, picking the children in
+// proportion to their importance to the shading point. Returns
+// LIGHT_BVH_INVALID if no emitter can reach the point.
+uint SampleLightBvh(vec3 position, vec3 normal, inout float r, out float pmf) {
+  pmf = 1.0;
+  uint node_id = 0;
+  while ((light_bvh_nodes[node_id].flags & LIGHT_BVH_LEAF) == 0u) {
+    uint second_child = light_bvh_nodes[node_id].index;
+    float importance0 =
+        LightBvhImportance(light_bvh_nodes[node_id + 1], position, normal);
+    float importance1 =
+        LightBvhImportance(light_bvh_nodes[second_child], position, normal);
+    if (importance0 + importance1 <= 0.0) {
+      return LIGHT_BVH_INVALID;
+    }
+    float prob0 = importance0 / (importance0 + importance1);
+    if (r < prob0) {
+      r = min(r / prob0, ALIAS_TABLE_ONE_MINUS_EPSILON);
+      pmf *= prob0;
+      node_id = node_id + 1;
+    } else {
+      r = min((r - prob0) / (1.0 - prob0), ALIAS_TABLE_ONE_MINUS_EPSILON);
+      pmf *= 1.0 - prob0;
+      node_id = second_child;
+    }
+  }
+  return node_id;
+}
+
+// Probability of SampleLightBvh reaching the node, evaluated bottom up with
+// the same importance terms.
+float LightBvhPmf(uint node_id, vec3 position, vec3 normal) {
+  float pmf = 1.0;
+  while (node_id != 0) {
+    uint parent = light_bvh_nodes[node_id].parent;
+    float importance0 =
+        LightBvhImportance(light_bvh_nodes[parent + 1], position, normal);
+    float importance1 = LightBvhImportance(
+        light_bvh_nodes[light_bvh_nodes[parent].index], position, normal);
+    float importance = node_id == parent + 1 ? importance0 : importance1;
+    if (importance <= 0.0) {
+      return 0.0;
+    }
+    pmf *= importance / (importance0 + importance1);
+    node_id = parent;
+  }
+  return pmf;
+}
+
+// Picks an emissive entity for the shading point. primitive_id is the
+// triangle to sample, or LIGHT_BVH_INVALID if it is left to the area alias
+// table of the mesh.
+bool SelectEmitter(vec3 position,
+                   vec3 normal,
+                   out uint entity_id,
+                   out uint primitive_id,
+                   out float select_prob) {
+  entity_id = 0;
+  primitive_id = LIGHT_BVH_INVALID;
+  select_prob = 0.0;
+  float r = RandomFloat();
+  if (scene_settings.light_sampler == LIGHT_SAMPLER_LIGHT_BVH) {
+    if (scene_settings.num_light_bvh_node == 0) {
+      return false;
+    }
+    uint node_id = SampleLightBvh(position, normal, r, select_prob);
+    if (node_id == LIGHT_BVH_INVALID) {
+      return false;
+    }
+    entity_id = light_bvh_nodes[node_id].index;
+    if ((light_bvh_nodes[node_id].flags & LIGHT_BVH_ENTITY_LEAF) == 0u) {
+      primitive_id = light_bvh_nodes[node_id].primitive_id;
+    }
+    return true;
+  }
+  if (scene_settings.num_emitter == 0) {
+    return false;
+  }
+  uint slot = AliasTableSlot(scene_settings.num_emitter, r);
+  uint emitter = AliasTableResolve(emitter_alias_table[slot], slot, r);
+  select_prob = emitter_alias_table[emitter].pdf;
+  entity_id = emitter_alias_table[emitter].payload;
+  return true;
 }
 
-float MeshCDF(uint mesh_id, int primitive_id) {
-  if (primitive_id < 0)
+// Probability of SelectEmitter picking the entity and triangle of the current
+// hit record from a shading point at origin.
+float EmitterSelectPdf(vec3 origin, vec3 origin_normal) {
+  uint entity_id = hit_record.entity_id;
+  uint mesh_id = metadatas[entity_id].mesh_id;
+  bool is_mesh = metadatas[entity_id].primitive_type == PRIMITIVE_TYPE_MESH;
+  // Only emitters have their area alias table built, the others are bound to
+  // a single entry placeholder.
+  if (metadatas[entity_id].emission_pdf <= 0.0) {
     return 0.0;
-  return mesh_cdf_buffers[mesh_id].area_cdfs[primitive_id];
+  }
+  float triangle_prob =
+      is_mesh ? area_alias_tables[mesh_id].entries[ray_payload.primitive_id].pdf
+              : 1.0;
+  if (scene_settings.light_sampler != LIGHT_SAMPLER_LIGHT_BVH) {
+    return metadatas[entity_id].emission_pdf * triangle_prob;
+  }
+
+  uint offset = metadatas[entity_id].light_leaf_offset;
+  if (offset == LIGHT_BVH_INVALID) {
+    return 0.0;
+  }
+  uint node_id = light_leaves[offset];
+  float select_prob = 1.0;
+  if (is_mesh) {
+    if (node_id != LIGHT_BVH_INVALID &&
+        (light_bvh_nodes[node_id].flags & LIGHT_BVH_ENTITY_LEAF) != 0u) {
+      select_prob = triangle_prob;
+    } else {
+      node_id = light_leaves[offset + ray_payload.primitive_id];
+    }
+  }
+  if (node_id == LIGHT_BVH_INVALID) {
+    return 0.0;
+  }
+  return select_prob * LightBvhPmf(node_id, origin, origin_normal);
 }
 
 void SampleEntityDirectLighting(out vec3 eval,
@@ -25,42 +140,59 @@ void SampleEntityDirectLighting(out vec3 eval,
   pdf = 0.0;
   eval = vec3(0.0);
   omega_in = vec3(0.0);
-  float select_prob = 1.0;
-  float r1 = RandomFloat();
-  int L = 0, R = int(scene_settings.num_entity - 1);
-  while (L < R) {
-    int m = (L + R) / 2;
-    if (r1 <= EntityCDF(m)) {
-      R = m;
-    } else {
-      L = m + 1;
-    }
+  uint entity_id;
+  uint primitive_id;
+  float select_prob;
+  if (!SelectEmitter(hit_record.position, hit_record.geometry_normal,
+                     entity_id, primitive_id, select_prob)) {
+    return;
   }
-  int entity_id = L;
+  float r1 = RandomFloat();
   vec3 emission =
       materials[entity_id].emission * materials[entity_id].emission_strength;
   uint mesh_id = metadatas[entity_id].mesh_id;
   mat4 entity_transform = metadatas[entity_id].model;
-  select_prob = EntityCDF(L) - EntityCDF(L - 1);
-  r1 = (r1 - EntityCDF(L - 1)) / select_prob;
-  L = 0;
-  R = int(mesh_metadatas[mesh_id].num_index / 3) - 1;
-  while (L < R) {
-    int m = (L + R) / 2;
-    if (r1 <= MeshCDF(mesh_id, m)) {
-      R = m;
-    } else {
-      L = m + 1;
+  uint primitive_type = metadatas[entity_id].primitive_type;
+  if (primitive_type != PRIMITIVE_TYPE_MESH) {
+    float primitive_area = PrimitiveArea(primitive_type);
+    if (primitive_area == 0.0) {
+      return;
+    }
+    vec3 local_pos = SamplePrimitive(primitive_type, r1, RandomFloat());
+    vec3 local_normal;
+    vec3 local_tangent;
+    vec2 tex_coord;
+    PrimitiveFrame(primitive_type, local_pos, local_normal, local_tangent,
+                   tex_coord);
+    vec3 hit_pos = vec3(entity_transform * vec4(local_pos, 1.0));
+    vec3 normal = normalize(transpose(inverse(mat3(entity_transform))) *
+                            local_normal);
+    float area = primitive_area *
+                 PrimitiveAreaScale(mat3(entity_transform), local_normal);
+    omega_in = hit_pos - hit_record.position;
+    float dist = length(omega_in);
+    omega_in /= dist;
+    if (dot(normal, omega_in) > 0.0) {
+      normal = -normal;
     }
+    float shadow = ShadowRay(hit_record.position, omega_in, dist * 0.9999);
+    float cos_theta = -dot(normal, omega_in);
+    if (shadow > 1e-4 && cos_theta > 1e-6) {
+      pdf = dist * dist * select_prob / (area * cos_theta);
+      eval = shadow * emission / pdf;
+    }
+    return;
+  }
+  if (primitive_id == LIGHT_BVH_INVALID) {
+    uint slot = AliasTableSlot(mesh_metadatas[mesh_id].num_index / 3, r1);
+    primitive_id =
+        AliasTableResolve(area_alias_tables[mesh_id].entries[slot], slot, r1);
+    select_prob *= area_alias_tables[mesh_id].entries[primitive_id].pdf;
   }
-  int primitive_id = L;
-  float primitive_select_prob = MeshCDF(mesh_id, L) - MeshCDF(mesh_id, L - 1);
-  r1 = (r1 - MeshCDF(mesh_id, L - 1)) / primitive_select_prob;
-  select_prob *= primitive_select_prob;
   uint iu, iv, iw;
-  iu = index_buffers[mesh_id].indices[primitive_id * 3 + 0];
-  iv = index_buffers[mesh_id].indices[primitive_id * 3 + 1];
-  iw = index_buffers[mesh_id].indices[primitive_id * 3 + 2];
+  iu = GetIndex(mesh_id, primitive_id * 3 + 0);
+  iv = GetIndex(mesh_id, primitive_id * 3 + 1);
+  iw = GetIndex(mesh_id, primitive_id * 3 + 2);
   vec3 pu, pv, pw;
   pu = GetVertexPos(mesh_id, iu);
   pv = GetVertexPos(mesh_id, iv);
@@ -92,13 +224,33 @@ void SampleEntityDirectLighting(out vec3 eval,
   }
 }
 
-float EstimateEntityDirectLightingPdf(vec3 origin) {
+float EstimateEntityDirectLightingPdf(vec3 origin, vec3 origin_normal) {
   uint mesh_id = metadatas[hit_record.entity_id].mesh_id;
   mat4 entity_transform = metadatas[hit_record.entity_id].model;
+  uint primitive_type = metadatas[hit_record.entity_id].primitive_type;
+  if (primitive_type != PRIMITIVE_TYPE_MESH) {
+    float primitive_area = PrimitiveArea(primitive_type);
+    if (primitive_area == 0.0) {
+      return 0.0;
+    }
+    vec3 local_normal;
+    vec3 local_tangent;
+    vec2 tex_coord;
+    PrimitiveFrame(primitive_type, ray_payload.barycentric, local_normal,
+                   local_tangent, tex_coord);
+    float area = primitive_area *
+                 PrimitiveAreaScale(mat3(entity_transform), local_normal);
+    vec3 omega_in = hit_record.position - origin;
+    float dist = length(omega_in);
+    omega_in /= dist;
+    float select_prob = EmitterSelectPdf(origin, origin_normal);
+    return dist * dist * select_prob / area /
+           -dot(hit_record.geometry_normal, omega_in);
+  }
   uint iu, iv, iw;
-  iu = index_buffers[mesh_id].indices[ray_payload.primitive_id * 3 + 0];
-  iv = index_buffers[mesh_id].indices[ray_payload.primitive_id * 3 + 1];
-  iw = index_buffers[mesh_id].indices[ray_payload.primitive_id * 3 + 2];
+  iu = GetIndex(mesh_id, ray_payload.primitive_id * 3 + 0);
+  iv = GetIndex(mesh_id, ray_payload.primitive_id * 3 + 1);
+  iw = GetIndex(mesh_id, ray_payload.primitive_id * 3 + 2);
   vec3 pu, pv, pw;
   pu = GetVertexPos(mesh_id, iu);
   pv = GetVertexPos(mesh_id, iv);
@@ -112,10 +264,7 @@ float EstimateEntityDirectLightingPdf(vec3 origin) {
   vec3 omega_in = hit_record.position - origin;
   float dist = length(omega_in);
   omega_in /= dist;
-  float select_prob = (EntityCDF(int(hit_record.entity_id)) -
-                       EntityCDF(int(hit_record.entity_id - 1))) *
-                      (MeshCDF(mesh_id, int(ray_payload.primitive_id)) -
-                       MeshCDF(mesh_id, int(ray_payload.primitive_id - 1)));
+  float select_prob = EmitterSelectPdf(origin, origin_normal);
   return dist * dist * select_prob / area /
          -dot(hit_record.geometry_normal, omega_in);
 }
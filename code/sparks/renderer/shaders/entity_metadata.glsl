@@ -3,15 +3,16 @@
 
 struct EntityMetadata {
   mat4 model;
+  mat4 inv_model;
   uint entity_id;
   uint mesh_id;
   uint albedo_texture_id;
   uint albedo_detail_texture_id;
   vec4 detail_scale_offset;
-  float emission_cdf;
-  float padding0;
-  float padding1;
-  float padding2;
+  uint primitive_type;
+  float emission_pdf;
+  uint light_leaf_offset;
+  uint padding0;
   // align to 16 bytes
 };
 
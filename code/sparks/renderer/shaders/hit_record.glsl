@@ -2,6 +2,8 @@
 #define HIT_RECORD_GLSL
 
 #include "entity_metadata.glsl"
+#include "index.glsl"
+#include "primitive.glsl"
 #include "vertex.glsl"
 
 struct HitRecord {
@@ -12,6 +14,9 @@ struct HitRecord {
   vec3 tangent;
   vec3 bitangent;
   vec2 tex_coord;
+  // Half the log2 ratio between texture coordinate and world space area, the
+  // texture LOD of a unit footprint.
+  float tex_coord_lod;
   vec3 omega_v;
   bool front_face;
 
@@ -31,6 +36,7 @@ HitRecord ComposeHitRecord(RayPayload ray_payload,
   hit_record.tangent = vec3(0.0);
   hit_record.bitangent = vec3(0.0);
   hit_record.tex_coord = vec2(0.0);
+  hit_record.tex_coord_lod = 0.0;
   hit_record.omega_v = -direction;
   hit_record.front_face = true;
   hit_record.albedo_texture_id = 0;
@@ -42,37 +48,66 @@ HitRecord ComposeHitRecord(RayPayload ray_payload,
   hit_record.albedo_texture_id = metadata.albedo_texture_id;
   hit_record.albedo_detail_texture_id = metadata.albedo_detail_texture_id;
   hit_record.detail_scale_offset = metadata.detail_scale_offset;
-  Vertex v0 = GetVertex(metadata.mesh_id,
-                        index_buffers[metadata.mesh_id]
-                            .indices[ray_payload.primitive_id * 3 + 0]);
-  Vertex v1 = GetVertex(metadata.mesh_id,
-                        index_buffers[metadata.mesh_id]
-                            .indices[ray_payload.primitive_id * 3 + 1]);
-  Vertex v2 = GetVertex(metadata.mesh_id,
-                        index_buffers[metadata.mesh_id]
-                            .indices[ray_payload.primitive_id * 3 + 2]);
-  vec3 b0 = v0.signal * cross(v0.normal, v0.tangent);
-  vec3 b1 = v1.signal * cross(v1.normal, v1.tangent);
-  vec3 b2 = v2.signal * cross(v2.normal, v2.tangent);
-
   mat3 entity_transform = mat3(ray_payload.entity_transform);
-  hit_record.position = ray_payload.entity_transform *
-                        vec4(mat3(v0.position, v1.position, v2.position) *
-                                 ray_payload.barycentric,
-                             1.0);
-  hit_record.shading_normal = normalize(transpose(inverse(entity_transform)) *
-                                        mat3(v0.normal, v1.normal, v2.normal) *
-                                        ray_payload.barycentric);
-  hit_record.geometry_normal =
-      normalize(transpose(inverse(entity_transform)) *
-                cross(v1.position - v0.position, v2.position - v0.position));
-  hit_record.tangent =
-      normalize(entity_transform * mat3(v0.tangent, v1.tangent, v2.tangent) *
-                ray_payload.barycentric);
-  hit_record.bitangent =
-      normalize(entity_transform * mat3(b0, b1, b2) * ray_payload.barycentric);
-  hit_record.tex_coord = mat3x2(v0.tex_coord, v1.tex_coord, v2.tex_coord) *
-                         ray_payload.barycentric;
+  if (metadata.primitive_type != PRIMITIVE_TYPE_MESH) {
+    // The payload holds the object space hit point.
+    vec3 normal;
+    vec3 tangent;
+    PrimitiveFrame(metadata.primitive_type, ray_payload.barycentric, normal,
+                   tangent, hit_record.tex_coord);
+    hit_record.position =
+        ray_payload.entity_transform * vec4(ray_payload.barycentric, 1.0);
+    hit_record.shading_normal =
+        normalize(transpose(inverse(entity_transform)) * normal);
+    hit_record.geometry_normal = hit_record.shading_normal;
+    hit_record.tangent = normalize(entity_transform * tangent);
+    hit_record.bitangent = normalize(entity_transform * cross(normal, tangent));
+    // The sphere maps the unit square to its whole surface, the flat
+    // primitives keep their object space area.
+    float tex_coord_area =
+        metadata.primitive_type == PRIMITIVE_TYPE_SPHERE ? 0.25 * INV_PI : 1.0;
+    hit_record.tex_coord_lod =
+        0.5 *
+        log2(tex_coord_area / PrimitiveAreaScale(entity_transform, normal));
+  } else {
+    Vertex v0 = GetVertex(metadata.mesh_id,
+                          GetIndex(metadata.mesh_id,
+                                   ray_payload.primitive_id * 3 + 0));
+    Vertex v1 = GetVertex(metadata.mesh_id,
+                          GetIndex(metadata.mesh_id,
+                                   ray_payload.primitive_id * 3 + 1));
+    Vertex v2 = GetVertex(metadata.mesh_id,
+                          GetIndex(metadata.mesh_id,
+                                   ray_payload.primitive_id * 3 + 2));
+    vec3 b0 = v0.signal * cross(v0.normal, v0.tangent);
+    vec3 b1 = v1.signal * cross(v1.normal, v1.tangent);
+    vec3 b2 = v2.signal * cross(v2.normal, v2.tangent);
+
+    hit_record.position = ray_payload.entity_transform *
+                          vec4(mat3(v0.position, v1.position, v2.position) *
+                                   ray_payload.barycentric,
+                               1.0);
+    hit_record.shading_normal = normalize(
+        transpose(inverse(entity_transform)) *
+        mat3(v0.normal, v1.normal, v2.normal) * ray_payload.barycentric);
+    hit_record.geometry_normal = normalize(
+        transpose(inverse(entity_transform)) *
+        cross(v1.position - v0.position, v2.position - v0.position));
+    hit_record.tangent = normalize(entity_transform *
+                                   mat3(v0.tangent, v1.tangent, v2.tangent) *
+                                   ray_payload.barycentric);
+    hit_record.bitangent = normalize(entity_transform * mat3(b0, b1, b2) *
+                                     ray_payload.barycentric);
+    hit_record.tex_coord = mat3x2(v0.tex_coord, v1.tex_coord, v2.tex_coord) *
+                           ray_payload.barycentric;
+    vec2 duv1 = v1.tex_coord - v0.tex_coord;
+    vec2 duv2 = v2.tex_coord - v0.tex_coord;
+    float world_area =
+        length(cross(entity_transform * (v1.position - v0.position),
+                     entity_transform * (v2.position - v0.position)));
+    hit_record.tex_coord_lod =
+        0.5 * log2(abs(duv1.x * duv2.y - duv1.y * duv2.x) / world_area);
+  }
 
   if (dot(hit_record.geometry_normal, hit_record.shading_normal) < 0.0) {
     hit_record.geometry_normal = -hit_record.geometry_normal;
@@ -0,0 +1,18 @@
+#ifndef INDEX_GLSL
+#define INDEX_GLSL
+
+#include "mesh_metadata.glsl"
+
+#define INDEX_FORMAT_UINT32 0u
+#define INDEX_FORMAT_UINT16 1u
+
+// 16-bit indices are packed two per word, the low half holding the even one.
+uint GetIndex(uint mesh_id, uint index_id) {
+  if (mesh_metadatas[mesh_id].index_format == INDEX_FORMAT_UINT16) {
+    uint word = index_buffers[mesh_id].indices[index_id >> 1];
+    return (word >> ((index_id & 1u) << 4)) & 0xffffu;
+  }
+  return index_buffers[mesh_id].indices[index_id];
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef LIGHT_BVH_GLSL
+#define LIGHT_BVH_GLSL
+
+// Keep in sync with sparks/utils/light_bvh.h.
+#define LIGHT_BVH_INVALID 0xffffffffu
+#define LIGHT_BVH_LEAF 1u
+#define LIGHT_BVH_TWO_SIDED 2u
+#define LIGHT_BVH_ENTITY_LEAF 4u
+
+struct LightBvhNode {
+  vec3 lower;
+  float power;
+  vec3 upper;
+  float cos_theta_o;
+  vec3 axis;
+  float cos_theta_e;
+  uint flags;
+  uint index;
+  uint primitive_id;
+  uint parent;
+};
+
+// cos(max(a - b, 0)) and sin(max(a - b, 0)) from the sines and cosines of
+// two angles in [0, pi].
+float LightBvhCosSubClamped(float sin_a,
+                            float cos_a,
+                            float sin_b,
+                            float cos_b) {
+  return cos_a > cos_b ? 1.0 : cos_a * cos_b + sin_a * sin_b;
+}
+
+float LightBvhSinSubClamped(float sin_a,
+                            float cos_a,
+                            float sin_b,
+                            float cos_b) {
+  return cos_a > cos_b ? 0.0 : sin_a * cos_b - cos_a * sin_b;
+}
+
+// Conservative estimate of the light a node contributes to a point with the
+// given surface normal. Both the bounds and the orientation cone are widened
+// by the angle the node subtends, so no emitter below it is underestimated.
+float LightBvhImportance(LightBvhNode node, vec3 position, vec3 normal) {
+  vec3 center = 0.5 * (node.lower + node.upper);
+  vec3 w = position - center;
+  float dist2 = dot(w, w);
+  vec3 diagonal = node.upper - node.lower;
+  float radius2 = 0.25 * dot(diagonal, diagonal);
+
+  // Cone of directions from the point to the bounding sphere.
+  float sin_theta_b = 0.0;
+  float cos_theta_b = -1.0;
+  if (dist2 > radius2) {
+    float sin2_theta_b = radius2 / dist2;
+    sin_theta_b = sqrt(sin2_theta_b);
+    cos_theta_b = sqrt(max(1.0 - sin2_theta_b, 0.0));
+  }
+
+  vec3 omega = dist2 > 0.0 ? w * inversesqrt(dist2) : normal;
+  dist2 = max(dist2, radius2);
+
+  float cos_theta_w = dot(node.axis, omega);
+  if ((node.flags & LIGHT_BVH_TWO_SIDED) != 0u) {
+    cos_theta_w = abs(cos_theta_w);
+  }
+  float sin_theta_w = sqrt(max(1.0 - cos_theta_w * cos_theta_w, 0.0));
+  float sin_theta_o =
+      sqrt(max(1.0 - node.cos_theta_o * node.cos_theta_o, 0.0));
+
+  // Smallest angle between the point and any emission direction.
+  float cos_theta_x = LightBvhCosSubClamped(sin_theta_w, cos_theta_w,
+                                            sin_theta_o, node.cos_theta_o);
+  float sin_theta_x = LightBvhSinSubClamped(sin_theta_w, cos_theta_w,
+                                            sin_theta_o, node.cos_theta_o);
+  float cos_theta_p = LightBvhCosSubClamped(sin_theta_x, cos_theta_x,
+                                            sin_theta_b, cos_theta_b);
+  if (cos_theta_p <= node.cos_theta_e) {
+    return 0.0;
+  }
+
+  float importance = node.power * cos_theta_p / dist2;
+
+  // Smallest angle between the surface normal and the node, either side of
+  // the surface may receive light.
+  float cos_theta_i = abs(dot(omega, normal));
+  float sin_theta_i = sqrt(max(1.0 - cos_theta_i * cos_theta_i, 0.0));
+  importance *= LightBvhCosSubClamped(sin_theta_i, cos_theta_i, sin_theta_b,
+                                      cos_theta_b);
+  return max(importance, 0.0);
+}
+
+#endif
@@ -4,6 +4,8 @@
 struct MeshMetadata {
   uint num_vertex;
   uint num_index;
+  uint vertex_format;
+  uint index_format;
 };
 
 #endif
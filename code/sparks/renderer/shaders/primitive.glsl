@@ -0,0 +1,122 @@
+#ifndef PRIMITIVE_GLSL
+#define PRIMITIVE_GLSL
+
+#include "constants.glsl"
+
+// Keep in sync with PrimitiveType in sparks/assets/primitive.h.
+#define PRIMITIVE_TYPE_MESH 0u
+#define PRIMITIVE_TYPE_SPHERE 1u
+#define PRIMITIVE_TYPE_QUAD 2u
+#define PRIMITIVE_TYPE_DISK 3u
+#define PRIMITIVE_TYPE_PLANE 4u
+
+// Intersects the ray origin + t * direction with a primitive in object space.
+// The direction does not need to be normalized, so t stays the same in world
+// space.
+bool IntersectPrimitive(uint type,
+                        vec3 origin,
+                        vec3 direction,
+                        float tmin,
+                        float tmax,
+                        out float t) {
+  t = tmax;
+  if (type == PRIMITIVE_TYPE_SPHERE) {
+    float a = dot(direction, direction);
+    float b = dot(origin, direction);
+    float c = dot(origin, origin) - 1.0;
+    float discriminant = b * b - a * c;
+    if (discriminant < 0.0) {
+      return false;
+    }
+    float s = sqrt(discriminant);
+    float t0 = (-b - s) / a;
+    float t1 = (-b + s) / a;
+    if (t0 > tmin && t0 < tmax) {
+      t = t0;
+      return true;
+    }
+    if (t1 > tmin && t1 < tmax) {
+      t = t1;
+      return true;
+    }
+    return false;
+  }
+
+  if (direction.y == 0.0) {
+    return false;
+  }
+  float t_plane = -origin.y / direction.y;
+  if (t_plane <= tmin || t_plane >= tmax) {
+    return false;
+  }
+  vec2 p = origin.xz + t_plane * direction.xz;
+  if (type == PRIMITIVE_TYPE_QUAD && (abs(p.x) > 0.5 || abs(p.y) > 0.5)) {
+    return false;
+  }
+  if (type == PRIMITIVE_TYPE_DISK && dot(p, p) > 0.25) {
+    return false;
+  }
+  t = t_plane;
+  return true;
+}
+
+// Object space frame and texture coordinates at a surface point, matching
+// BuildPrimitiveMesh.
+void PrimitiveFrame(uint type,
+                    vec3 position,
+                    out vec3 normal,
+                    out vec3 tangent,
+                    out vec2 tex_coord) {
+  if (type == PRIMITIVE_TYPE_SPHERE) {
+    normal = normalize(position);
+    tangent = vec3(-normal.z, 0.0, normal.x);
+    float tangent_length = length(tangent);
+    tangent = tangent_length > 1e-6 ? tangent / tangent_length
+                                    : vec3(0.0, 0.0, 1.0);
+    tex_coord = vec2(atan(normal.z, normal.x) * 0.5 * INV_PI + 0.5,
+                     acos(clamp(normal.y, -1.0, 1.0)) * INV_PI);
+    return;
+  }
+  normal = vec3(0.0, 1.0, 0.0);
+  tangent = vec3(1.0, 0.0, 0.0);
+  tex_coord = vec2(position.x + 0.5, 0.5 - position.z);
+}
+
+// Object space area, 0 for primitives that cannot be sampled.
+float PrimitiveArea(uint type) {
+  if (type == PRIMITIVE_TYPE_SPHERE) {
+    return 4.0 * PI;
+  }
+  if (type == PRIMITIVE_TYPE_QUAD) {
+    return 1.0;
+  }
+  if (type == PRIMITIVE_TYPE_DISK) {
+    return 0.25 * PI;
+  }
+  return 0.0;
+}
+
+// Uniformly samples a point on the primitive surface in object space.
+vec3 SamplePrimitive(uint type, float r1, float r2) {
+  if (type == PRIMITIVE_TYPE_SPHERE) {
+    float y = 1.0 - 2.0 * r1;
+    float r = sqrt(max(1.0 - y * y, 0.0));
+    float phi = 2.0 * PI * r2;
+    return vec3(r * cos(phi), y, r * sin(phi));
+  }
+  if (type == PRIMITIVE_TYPE_DISK) {
+    float r = 0.5 * sqrt(r1);
+    float phi = 2.0 * PI * r2;
+    return vec3(r * cos(phi), 0.0, r * sin(phi));
+  }
+  return vec3(r1 - 0.5, 0.0, r2 - 0.5);
+}
+
+// Ratio between world and object space area elements at a point with the
+// given object space normal.
+float PrimitiveAreaScale(mat3 transform, vec3 normal) {
+  return abs(determinant(transform)) *
+         length(transpose(inverse(transform)) * normal);
+}
+
+#endif
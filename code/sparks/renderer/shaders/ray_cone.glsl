@@ -0,0 +1,33 @@
+#ifndef RAY_CONE_GLSL
+#define RAY_CONE_GLSL
+
+// Footprint of a path for texture filtering, after "Improved Shader and
+// Texture Level of Detail Using Ray Cones". The width grows with the distance
+// travelled and the spread angle widens at every bounce.
+struct RayCone {
+  float width;
+  float spread_angle;
+};
+
+RayCone PropagateRayCone(RayCone cone, float distance) {
+  cone.width += cone.spread_angle * distance;
+  return cone;
+}
+
+// Rough reflections widen the cone by about the width of their lobe. Surface
+// curvature is ignored.
+RayCone ScatterRayCone(RayCone cone, float roughness) {
+  cone.spread_angle += 2.0 * roughness * roughness;
+  return cone;
+}
+
+// Log2 of the footprint of the cone in texture coordinates at a surface,
+// tex_coord_lod is the log2 scale of the texture coordinates there.
+float RayConeLod(RayCone cone,
+                 float tex_coord_lod,
+                 vec3 normal,
+                 vec3 direction) {
+  return tex_coord_lod + log2(cone.width / abs(dot(normal, direction)));
+}
+
+#endif
@@ -1,6 +1,10 @@
 #ifndef SCENE_SETTINGS_H
 #define SCENE_SETTINGS_H
 
+// Keep in sync with LightSampler in sparks/scene/scene_settings.h.
+#define LIGHT_SAMPLER_POWER 0u
+#define LIGHT_SAMPLER_LIGHT_BVH 1u
+
 struct SceneSettings {
   mat4 projection;
   mat4 inv_projection;
@@ -16,6 +20,10 @@ struct SceneSettings {
   float total_emission_energy;
   uint num_entity;
   bool enable_direct_lighting;
+  uint num_primitive_entity;
+  uint num_emitter;
+  uint light_sampler;
+  uint num_light_bvh_node;
 };
 
 #endif
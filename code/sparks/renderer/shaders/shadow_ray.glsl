@@ -1,17 +1,32 @@
 #ifndef SHADOW_RAY_GLSL
 #define SHADOW_RAY_GLSL
+#include "primitive.glsl"
 #include "random.glsl"
 
 float ShadowRay(vec3 origin, vec3 direction, float dist) {
+  float tmin = length(origin) * 1e-3;
+  float tmax = dist * 0.999;
   rayQueryEXT rq;
   rayQueryInitializeEXT(rq, scene, gl_RayFlagsTerminateOnFirstHitEXT, 0xFF,
-                        origin, length(origin) * 1e-3, direction, dist * 0.999);
+                        origin, tmin, direction, tmax);
   rayQueryProceedEXT(rq);
 
   if (rayQueryGetIntersectionTypeEXT(rq, true) !=
       gl_RayQueryCommittedIntersectionNoneEXT) {
     return 0.0f;
   }
+
+  uint first = scene_settings.num_entity - scene_settings.num_primitive_entity;
+  for (uint entity_id = first; entity_id < scene_settings.num_entity;
+       entity_id++) {
+    mat4 inv_model = metadatas[entity_id].inv_model;
+    float t;
+    if (IntersectPrimitive(metadatas[entity_id].primitive_type,
+                           vec3(inv_model * vec4(origin, 1.0)),
+                           mat3(inv_model) * direction, tmin, tmax, t)) {
+      return 0.0f;
+    }
+  }
   return 1.0;
 }
 
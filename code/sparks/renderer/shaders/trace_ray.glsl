@@ -1,8 +1,35 @@
 #ifndef TRACE_RAY_GLSL
 #define TRACE_RAY_GLSL
 
+#include "primitive.glsl"
+
 vec3 trace_ray_direction;
 
+// Primitive entities are not part of the TLAS, they are bound after all mesh
+// entities and intersected here.
+void TracePrimitives(vec3 origin, vec3 direction, float tmin, float tmax) {
+  uint first = scene_settings.num_entity - scene_settings.num_primitive_entity;
+  for (uint entity_id = first; entity_id < scene_settings.num_entity;
+       entity_id++) {
+    mat4 inv_model = metadatas[entity_id].inv_model;
+    vec3 local_origin = vec3(inv_model * vec4(origin, 1.0));
+    vec3 local_direction = mat3(inv_model) * direction;
+    float t;
+    if (!IntersectPrimitive(metadatas[entity_id].primitive_type, local_origin,
+                            local_direction, tmin, tmax, t)) {
+      continue;
+    }
+    tmax = t;
+    ray_payload.t = t;
+    // Primitive hits carry the object space hit point in place of the
+    // barycentric coordinates.
+    ray_payload.barycentric = local_origin + t * local_direction;
+    ray_payload.entity_id = entity_id;
+    ray_payload.primitive_id = 0;
+    ray_payload.entity_transform = mat4x3(metadatas[entity_id].model);
+  }
+}
+
 void TraceRay(vec3 origin, vec3 direction) {
   trace_ray_direction = direction;
   float tmin = 1e-4 * length(origin);
@@ -16,6 +43,11 @@ void TraceRay(vec3 origin, vec3 direction) {
 
   traceRayEXT(scene, gl_RayFlagsOpaqueEXT, 0xff, 0, 0, 0, origin, tmin,
               direction, tmax, 0);
+
+  if (ray_payload.t != -1.0) {
+    tmax = ray_payload.t;
+  }
+  TracePrimitives(origin, direction, tmin, tmax);
 }
 
 #endif
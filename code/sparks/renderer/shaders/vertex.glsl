@@ -1,7 +1,11 @@
 #ifndef VERTEX_GLSL
 #define VERTEX_GLSL
 
-#define VERTEX_VAR_COUNT 12
+#include "mesh_metadata.glsl"
+#include "vertex_compression.glsl"
+
+#define VERTEX_VAR_COUNT 12u
+#define COMPACT_VERTEX_VAR_COUNT 6u
 
 struct Vertex {
   vec3 position;
@@ -11,29 +15,47 @@ struct Vertex {
   float signal;
 };
 
+float VertexData(uint mesh_id, uint offset) {
+  return uintBitsToFloat(vertex_buffers[mesh_id].vertex_data[offset]);
+}
+
+uint VertexStride(uint mesh_id) {
+  return mesh_metadatas[mesh_id].vertex_format == VERTEX_FORMAT_COMPACT
+             ? COMPACT_VERTEX_VAR_COUNT
+             : VERTEX_VAR_COUNT;
+}
+
 Vertex GetVertex(uint mesh_id, uint vertex_id) {
-  uint offset = vertex_id * VERTEX_VAR_COUNT;
+  uint offset = vertex_id * VertexStride(mesh_id);
   Vertex vertex;
-  vertex.position = vec3(vertex_buffers[mesh_id].vertex_data[offset + 0],
-                         vertex_buffers[mesh_id].vertex_data[offset + 1],
-                         vertex_buffers[mesh_id].vertex_data[offset + 2]);
-  vertex.normal = vec3(vertex_buffers[mesh_id].vertex_data[offset + 3],
-                       vertex_buffers[mesh_id].vertex_data[offset + 4],
-                       vertex_buffers[mesh_id].vertex_data[offset + 5]);
-  vertex.tangent = vec3(vertex_buffers[mesh_id].vertex_data[offset + 6],
-                        vertex_buffers[mesh_id].vertex_data[offset + 7],
-                        vertex_buffers[mesh_id].vertex_data[offset + 8]);
-  vertex.tex_coord = vec2(vertex_buffers[mesh_id].vertex_data[offset + 9],
-                          vertex_buffers[mesh_id].vertex_data[offset + 10]);
-  vertex.signal = vertex_buffers[mesh_id].vertex_data[offset + 11];
+  vertex.position = vec3(VertexData(mesh_id, offset + 0),
+                         VertexData(mesh_id, offset + 1),
+                         VertexData(mesh_id, offset + 2));
+  if (mesh_metadatas[mesh_id].vertex_format == VERTEX_FORMAT_COMPACT) {
+    vertex.normal =
+        DecodeOctahedral(vertex_buffers[mesh_id].vertex_data[offset + 3]);
+    vertex.tangent = DecodeCompactTangent(
+        vertex_buffers[mesh_id].vertex_data[offset + 4], vertex.signal);
+    vertex.tex_coord =
+        DecodeCompactTexCoord(vertex_buffers[mesh_id].vertex_data[offset + 5]);
+    return vertex;
+  }
+  vertex.normal = vec3(VertexData(mesh_id, offset + 3),
+                       VertexData(mesh_id, offset + 4),
+                       VertexData(mesh_id, offset + 5));
+  vertex.tangent = vec3(VertexData(mesh_id, offset + 6),
+                        VertexData(mesh_id, offset + 7),
+                        VertexData(mesh_id, offset + 8));
+  vertex.tex_coord =
+      vec2(VertexData(mesh_id, offset + 9), VertexData(mesh_id, offset + 10));
+  vertex.signal = VertexData(mesh_id, offset + 11);
   return vertex;
 }
 
 vec3 GetVertexPos(uint mesh_id, uint vertex_id) {
-  uint offset = vertex_id * VERTEX_VAR_COUNT;
-  return vec3(vertex_buffers[mesh_id].vertex_data[offset + 0],
-              vertex_buffers[mesh_id].vertex_data[offset + 1],
-              vertex_buffers[mesh_id].vertex_data[offset + 2]);
+  uint offset = vertex_id * VertexStride(mesh_id);
+  return vec3(VertexData(mesh_id, offset + 0), VertexData(mesh_id, offset + 1),
+              VertexData(mesh_id, offset + 2));
 }
 
 #endif
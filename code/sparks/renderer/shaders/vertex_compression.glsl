@@ -0,0 +1,27 @@
+#ifndef VERTEX_COMPRESSION_GLSL
+#define VERTEX_COMPRESSION_GLSL
+
+#define VERTEX_FORMAT_FULL 0u
+#define VERTEX_FORMAT_COMPACT 1u
+
+#define TANGENT_SIGN_BIT 0x10000u
+
+vec3 DecodeOctahedral(uint encoded) {
+  vec2 f = unpackSnorm2x16(encoded);
+  vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+
+vec3 DecodeCompactTangent(uint encoded, out float signal) {
+  signal = (encoded & TANGENT_SIGN_BIT) != 0u ? -1.0 : 1.0;
+  return DecodeOctahedral(encoded & ~TANGENT_SIGN_BIT);
+}
+
+vec2 DecodeCompactTexCoord(uint encoded) {
+  return unpackHalf2x16(encoded);
+}
+
+#endif
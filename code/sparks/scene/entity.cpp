@@ -34,6 +34,17 @@ vulkan::Core *Entity::Core() const {
   return scene_->Renderer()->Core();
 }
 
+uint32_t Entity::RayTracingMeshId() const {
+  if (!ray_tracing_lod_) {
+    return metadata_.mesh_id;
+  }
+  auto mesh = scene_->Renderer()->AssetManager()->GetMesh(metadata_.mesh_id);
+  if (ray_tracing_lod_ > mesh->lod_mesh_ids_.size()) {
+    return metadata_.mesh_id;
+  }
+  return mesh->lod_mesh_ids_[ray_tracing_lod_ - 1];
+}
+
 EntityMetadata Entity::GetTranslatedMetadata() const {
   AssetManager *asset_manager = scene_->Renderer()->AssetManager();
   EntityMetadata metadata = metadata_;
@@ -41,7 +52,7 @@ EntityMetadata Entity::GetTranslatedMetadata() const {
       asset_manager->GetTextureBindingId(metadata_.albedo_texture_id);
   metadata.albedo_detail_texture_id =
       asset_manager->GetTextureBindingId(metadata_.albedo_detail_texture_id);
-  metadata.mesh_id = asset_manager->GetMeshBindingId(metadata_.mesh_id);
+  metadata.mesh_id = asset_manager->GetMeshBindingId(RayTracingMeshId());
   return metadata;
 }
 
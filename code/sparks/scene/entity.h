@@ -1,4 +1,5 @@
 #pragma once
+#include "sparks/assets/primitive.h"
 #include "sparks/scene/material.h"
 #include "sparks/scene/scene_utils.h"
 
@@ -6,15 +7,23 @@ namespace sparks {
 
 struct EntityMetadata {
   glm::mat4 transform{1.0f};
+  // Inverse of transform, filled in by the scene for the primitive
+  // intersection of the ray tracer.
+  glm::mat4 inv_transform{1.0f};
   uint32_t entity_id{0};
   uint32_t mesh_id{0};
   uint32_t albedo_texture_id{0};
   uint32_t albedo_detail_texture_id{0};
   glm::vec4 detail_scale_offset{10.0f, 10.0f, 0.0f, 0.0f};
-  float emission_cdf{0.0f};
-  float padding0;  // padding to 16 bytes
-  float padding1;  // padding to 16 bytes
-  float padding2;  // padding to 16 bytes
+  // PrimitiveType of the entity, mesh_id only serves the raster preview if
+  // this is not PrimitiveType::Mesh.
+  uint32_t primitive_type{0};
+  // Probability of the entity being picked from the emitter alias table.
+  float emission_pdf{0.0f};
+  // First entry of the entity in the light leaf table of the scene, filled in
+  // by the scene. kLightBvhInvalid if the entity does not emit.
+  uint32_t light_leaf_offset{kLightBvhInvalid};
+  uint32_t padding0{0};
 
   // This structure needs to be padded to 16 bytes
   // If you wants to add normal_texture_id, you should add it here.
@@ -31,6 +40,13 @@ class Entity {
     return metadata_.mesh_id;
   }
 
+  // Mesh level instanced in the ray tracing acceleration structure.
+  uint32_t RayTracingMeshId() const;
+
+  PrimitiveType GetPrimitiveType() const {
+    return PrimitiveType(metadata_.primitive_type);
+  }
+
   Material GetMaterial() const {
     return material_;
   }
@@ -45,12 +61,12 @@ class Entity {
 
   EntityMetadata GetTranslatedMetadata() const;
 
-  void SetEmissionCDF(float cdf) {
-    metadata_.emission_cdf = cdf;
+  void SetEmissionPdf(float pdf) {
+    metadata_.emission_pdf = pdf;
   }
 
-  float GetEmissionCDF() const {
-    return metadata_.emission_cdf;
+  float GetEmissionPdf() const {
+    return metadata_.emission_pdf;
   }
 
   void Update();
@@ -62,6 +78,8 @@ class Entity {
   Scene *scene_;
   Material material_{};
   EntityMetadata metadata_{};
+  // Index into the LOD chain of the mesh, 0 is the mesh itself.
+  uint32_t ray_tracing_lod_{0};
   std::vector<std::unique_ptr<vulkan::DescriptorSet>> descriptor_sets_;
   std::unique_ptr<vulkan::DynamicBuffer<EntityMetadata>> metadata_buffer_;
   std::unique_ptr<vulkan::DynamicBuffer<Material>> material_buffer_;
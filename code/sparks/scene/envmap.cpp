@@ -40,11 +40,11 @@ void EnvMap::Update() {
                                         ->AssetManager()
                                         ->GetTexture(settings_.envmap_id)
                                         ->image_.get());
+  auto importance_buffer =
+      scene_->Renderer()->AssetManager()->GetTextureImportanceBuffer(
+          settings_.envmap_id);
   descriptor_sets_[scene_->Renderer()->Core()->CurrentFrame()]
-      ->BindStorageBuffer(2, scene_->Renderer()
-                                 ->AssetManager()
-                                 ->GetTexture(settings_.envmap_id)
-                                 ->cdf_buffer_->GetBuffer());
+      ->BindStorageBuffer(2, importance_buffer->GetBuffer());
 }
 
 void EnvMap::Sync(VkCommandBuffer cmd_buffer, int frame_id) {
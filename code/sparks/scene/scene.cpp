@@ -1,9 +1,39 @@
 #include "sparks/scene/scene.h"
 
 #include "Eigen/Eigen"
+#include "limits"
 #include "sparks/renderer/renderer.h"
 
 namespace sparks {
+
+namespace {
+// Bounds of an object space box under the transform, the caller sets up the
+// orientation cone. All emitters are diffuse, their emission spreads up to 90
+// degrees from the surface normal.
+LightBounds TransformedLightBounds(const glm::mat4 &transform,
+                                   const glm::vec3 &lower,
+                                   const glm::vec3 &upper) {
+  LightBounds bounds;
+  for (int i = 0; i < 8; i++) {
+    glm::vec3 corner{(i & 1) ? upper.x : lower.x, (i & 2) ? upper.y : lower.y,
+                     (i & 4) ? upper.z : lower.z};
+    corner = glm::vec3{transform * glm::vec4{corner, 1.0f}};
+    bounds.lower = glm::min(bounds.lower, corner);
+    bounds.upper = glm::max(bounds.upper, corner);
+  }
+  bounds.cos_theta_e = 0.0f;
+  return bounds;
+}
+
+uint32_t NextPowerOfTwo(size_t n) {
+  uint32_t result = 1;
+  while (result < n) {
+    result <<= 1;
+  }
+  return result;
+}
+}  // namespace
+
 Scene::Scene(struct Renderer *renderer, int max_entities)
     : renderer_(renderer) {
   vulkan::DescriptorPoolSize pool_size;
@@ -37,6 +67,20 @@ Scene::Scene(struct Renderer *renderer, int max_entities)
       std::make_unique<vulkan::DynamicBuffer<EntityMetadata>>(
           renderer_->Core(), max_entities, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 
+  emitter_alias_buffer_ = std::make_unique<vulkan::DynamicBuffer<AliasEntry>>(
+      renderer_->Core(), max_entities, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+  light_bvh_node_capacity_ = max_entities;
+  light_bvh_node_buffer_ =
+      std::make_unique<vulkan::DynamicBuffer<LightBvhNode>>(
+          renderer_->Core(), light_bvh_node_capacity_,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+  light_leaf_capacity_ = max_entities;
+  light_leaf_buffer_ = std::make_unique<vulkan::DynamicBuffer<uint32_t>>(
+      renderer_->Core(), light_leaf_capacity_,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
   descriptor_sets_.resize(renderer_->Core()->MaxFramesInFlight());
   for (int i = 0; i < renderer_->Core()->MaxFramesInFlight(); i++) {
     descriptor_pool_->AllocateDescriptorSet(
@@ -48,6 +92,8 @@ Scene::Scene(struct Renderer *renderer, int max_entities)
         1, entity_material_buffer_->GetBuffer(i));
     descriptor_sets_[i]->BindStorageBuffer(
         2, entity_metadata_buffer_->GetBuffer(i));
+    descriptor_sets_[i]->BindStorageBuffer(
+        3, emitter_alias_buffer_->GetBuffer(i));
   }
   far_descriptor_sets_.resize(renderer_->Core()->MaxFramesInFlight());
   for (int i = 0; i < renderer_->Core()->MaxFramesInFlight(); i++) {
@@ -62,9 +108,24 @@ Scene::Scene(struct Renderer *renderer, int max_entities)
         1, entity_material_buffer_->GetBuffer(i));
     far_descriptor_sets_[i]->BindStorageBuffer(
         2, entity_metadata_buffer_->GetBuffer(i));
+    far_descriptor_sets_[i]->BindStorageBuffer(
+        3, emitter_alias_buffer_->GetBuffer(i));
+  }
+  BindLightBvhBuffers();
+
+  tlas_instance_buffer_ = std::make_unique<
+      vulkan::DynamicBuffer<VkAccelerationStructureInstanceKHR>>(
+      renderer_->Core(), max_entities,
+      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  // One per frame in flight, so that a rebuild never waits for the frames
+  // still tracing against the previous one.
+  top_level_as_.resize(renderer_->Core()->MaxFramesInFlight());
+  for (auto &top_level_as : top_level_as_) {
+    top_level_as =
+        std::make_unique<TopLevelAccelerationStructure>(renderer_->Core());
+    top_level_as->Reserve(0);
   }
-
-  renderer_->Core()->CreateTopLevelAccelerationStructure({}, &top_level_as_);
 
   raytracing_descriptor_sets_.resize(renderer_->Core()->MaxFramesInFlight());
   for (int i = 0; i < renderer_->Core()->MaxFramesInFlight(); i++) {
@@ -77,7 +138,8 @@ Scene::Scene(struct Renderer *renderer, int max_entities)
 }
 
 Scene::~Scene() {
-  top_level_as_.reset();
+  top_level_as_.clear();
+  tlas_instance_buffer_.reset();
   envmap_.reset();
   entities_.clear();
   descriptor_sets_.clear();
@@ -85,6 +147,9 @@ Scene::~Scene() {
   raytracing_descriptor_sets_.clear();
   entity_material_buffer_.reset();
   entity_metadata_buffer_.reset();
+  emitter_alias_buffer_.reset();
+  light_bvh_node_buffer_.reset();
+  light_leaf_buffer_.reset();
   scene_settings_buffer_.reset();
   descriptor_pool_.reset();
 }
@@ -106,6 +171,7 @@ void Scene::Update(float delta_time) {
 
 void Scene::UpdatePipelineObjects() {
   envmap_->Update();
+  UpdateRayTracingLods();
   UpdateDynamicBuffers();
   UpdateTopLevelAccelerationStructure();
   UpdateDescriptorSetBindings();
@@ -119,6 +185,20 @@ void Scene::SyncData(VkCommandBuffer cmd_buffer, int frame_id) {
   }
   entity_metadata_buffer_->SyncData(cmd_buffer, frame_id);
   entity_material_buffer_->SyncData(cmd_buffer, frame_id);
+  emitter_alias_buffer_->SyncData(cmd_buffer, frame_id);
+  light_bvh_node_buffer_->SyncData(cmd_buffer, frame_id);
+  light_leaf_buffer_->SyncData(cmd_buffer, frame_id);
+  tlas_instance_buffer_->SyncData(cmd_buffer, frame_id);
+}
+
+void Scene::BuildTopLevelAccelerationStructure(VkCommandBuffer cmd_buffer,
+                                               int frame_id) {
+  renderer_->AssetManager()->AcquireBlases(cmd_buffer);
+  top_level_as_[frame_id]->RecordBuild(
+      cmd_buffer,
+      GetBufferDeviceAddress(renderer_->Core(),
+                             tlas_instance_buffer_->GetBuffer(frame_id)),
+      num_mesh_entities_);
 }
 
 void Scene::UpdateDynamicBuffers() {
@@ -129,9 +209,29 @@ void Scene::UpdateDynamicBuffers() {
     entity.second->Update();
   }
 
+  // Mesh entities come first so that their binding indices match the
+  // instance indices of the TLAS, which only holds meshes.
+  binding_entities_.clear();
+  for (auto &[id, entity] : entities_) {
+    if (entity->GetPrimitiveType() == PrimitiveType::Mesh) {
+      binding_entities_.push_back(entity.get());
+    }
+  }
+  num_mesh_entities_ = binding_entities_.size();
+  for (auto &[id, entity] : entities_) {
+    if (entity->GetPrimitiveType() != PrimitiveType::Mesh) {
+      binding_entities_.push_back(entity.get());
+    }
+  }
+
   float total_energy = 0.0f;
+  // Entities with emission, identified by their binding index.
+  std::vector<float> emitter_energies;
+  std::vector<uint32_t> emitter_entities;
 
-  for (auto &[id, entity] : entities_) {
+  for (uint32_t binding_id = 0; binding_id < binding_entities_.size();
+       binding_id++) {
+    auto entity = binding_entities_[binding_id];
     float energy = 0.0f;
 
     auto material = entity->GetMaterial();
@@ -140,8 +240,22 @@ void Scene::UpdateDynamicBuffers() {
     glm::vec3 emission = material.emission * material.emission_strength;
     energy_density = std::max(emission.r, std::max(emission.g, emission.b));
 
-    if (energy_density > 0.0) {
-      auto mesh = renderer_->AssetManager()->GetMesh(entity->MeshId());
+    // Infinite planes cannot be sampled, they are only hit by BSDF samples.
+    // Meshes are not sampled until their BLAS is built, rays cannot hit them
+    // before.
+    if (energy_density > 0.0 &&
+        entity->GetPrimitiveType() != PrimitiveType::Plane &&
+        (entity->GetPrimitiveType() != PrimitiveType::Mesh ||
+         renderer_->AssetManager()->RequestBlas(entity->RayTracingMeshId()))) {
+      float area = PrimitiveArea(entity->GetPrimitiveType());
+      if (entity->GetPrimitiveType() == PrimitiveType::Mesh) {
+        auto mesh =
+            renderer_->AssetManager()->GetMesh(entity->RayTracingMeshId());
+        area = mesh->area_;
+        // Builds the triangle table before the asset manager binds it.
+        renderer_->AssetManager()->GetMeshAreaAliasBuffer(
+            entity->RayTracingMeshId());
+      }
       auto transform = glm::mat3(entity->GetTransform());
 
       Eigen::Matrix3<float> svd_transform;
@@ -163,27 +277,45 @@ void Scene::UpdateDynamicBuffers() {
       float singular_value_0 = singular_values[2];
       float singular_value_1 = singular_values[1];
 
-      float stretched_area = singular_value_0 * singular_value_1 * mesh->area_;
+      float stretched_area = singular_value_0 * singular_value_1 * area;
       energy = stretched_area * energy_density;
     }
+    if (energy > 0.0f) {
+      emitter_energies.push_back(energy);
+      emitter_entities.push_back(binding_id);
+    }
     total_energy += energy;
-    entity->SetEmissionCDF(total_energy);
+    entity->SetEmissionPdf(energy);
   }
   scene_settings_.total_emission_energy = total_energy;
 
+  std::vector<AliasEntry> emitter_alias_table;
+  BuildAliasTable(emitter_energies, emitter_alias_table);
+  for (uint32_t i = 0; i < emitter_alias_table.size(); i++) {
+    emitter_alias_table[i].payload = emitter_entities[i];
+    emitter_alias_buffer_->At(i) = emitter_alias_table[i];
+  }
+  scene_settings_.num_emitter = emitter_alias_table.size();
+
+  UpdateLightBvh(emitter_entities, emitter_energies);
+
   uint32_t binding_entity_id = 0;
-  for (auto &[id, entity] : entities_) {
+  for (auto entity : binding_entities_) {
     if (total_energy > 0.0) {
-      entity->SetEmissionCDF(entity->GetEmissionCDF() / total_energy);
+      entity->SetEmissionPdf(entity->GetEmissionPdf() / total_energy);
     } else {
-      entity->SetEmissionCDF(0.0);
+      entity->SetEmissionPdf(0.0);
     }
-    entity_metadata_buffer_->At(binding_entity_id) =
-        entity->GetTranslatedMetadata();
+    EntityMetadata metadata = entity->GetTranslatedMetadata();
+    metadata.inv_transform = glm::inverse(metadata.transform);
+    metadata.light_leaf_offset = light_leaf_offsets_[binding_entity_id];
+    entity_metadata_buffer_->At(binding_entity_id) = metadata;
     entity_material_buffer_->At(binding_entity_id) = entity->GetMaterial();
     binding_entity_id++;
   }
   scene_settings_.num_entity = entities_.size();
+  scene_settings_.num_primitive_entity =
+      binding_entities_.size() - num_mesh_entities_;
 
   VkExtent2D extent = renderer_->Core()->Swapchain()->Extent();
   SceneSettings scene_settings = scene_settings_;
@@ -199,30 +331,172 @@ void Scene::UpdateDynamicBuffers() {
   scene_settings_buffer_->At(1) = scene_settings;
 }
 
-void Scene::UpdateTopLevelAccelerationStructure() {
-  std::vector<std::pair<vulkan::AccelerationStructure *, glm::mat4>> instances;
-  for (auto &[id, entity] : entities_) {
-    uint32_t mesh_id = entity->MeshId();
-    auto mesh = renderer_->AssetManager()->GetMesh(mesh_id);
-    instances.emplace_back(mesh->blas_.get(), entity->metadata_.transform);
+void Scene::UpdateLightBvh(const std::vector<uint32_t> &emitter_entities,
+                           const std::vector<float> &emitter_energies) {
+  uint64_t hash = HashCombine(0, binding_entities_.size());
+  for (size_t i = 0; i < emitter_entities.size(); i++) {
+    auto entity = binding_entities_[emitter_entities[i]];
+    hash = HashCombine(hash, emitter_entities[i]);
+    hash = HashCombine(hash, entity->metadata_.primitive_type);
+    hash = HashCombine(hash, entity->RayTracingMeshId());
+    hash = HashBytes(&entity->metadata_.transform,
+                     sizeof(entity->metadata_.transform), hash);
+    hash = HashBytes(&emitter_energies[i], sizeof(float), hash);
+  }
+  if (hash == light_bvh_hash_ &&
+      light_leaf_offsets_.size() == binding_entities_.size()) {
+    return;
   }
-  static int last_num_instances = -1;
-  if (last_num_instances != instances.size()) {
-    last_num_instances = instances.size();
+  light_bvh_hash_ = hash;
+
+  std::vector<LightBvhItem> items;
+  light_leaf_offsets_.assign(binding_entities_.size(), kLightBvhInvalid);
+  for (size_t i = 0; i < emitter_entities.size(); i++) {
+    uint32_t binding_id = emitter_entities[i];
+    auto entity = binding_entities_[binding_id];
+    glm::mat4 transform = entity->GetTransform();
+    PrimitiveType type = entity->GetPrimitiveType();
+    light_leaf_offsets_[binding_id] = items.size();
+
+    LightBvhItem item{};
+    item.index = binding_id;
+    item.flags = kLightBvhEntityLeaf;
+    if (type == PrimitiveType::Sphere) {
+      item.bounds = TransformedLightBounds(transform, glm::vec3{-1.0f},
+                                           glm::vec3{1.0f});
+      item.bounds.cos_theta_o = -1.0f;
+      item.bounds.power = emitter_energies[i];
+      items.push_back(item);
+      continue;
+    }
+    // Planar emitters shine on both sides, their power counts twice against
+    // spheres of the same area.
+    if (type != PrimitiveType::Mesh) {
+      item.bounds =
+          TransformedLightBounds(transform, glm::vec3{-0.5f, 0.0f, -0.5f},
+                                 glm::vec3{0.5f, 0.0f, 0.5f});
+      glm::mat3 normal_transform =
+          glm::transpose(glm::inverse(glm::mat3{transform}));
+      item.bounds.axis =
+          glm::normalize(normal_transform * glm::vec3{0.0f, 1.0f, 0.0f});
+      item.bounds.two_sided = true;
+      item.bounds.power = 2.0f * emitter_energies[i];
+      items.push_back(item);
+      continue;
+    }
+
+    auto mesh =
+        renderer_->AssetManager()->GetMesh(entity->RayTracingMeshId());
+    const auto &corners = renderer_->AssetManager()->GetMeshLightTriangles(
+        entity->RayTracingMeshId());
+    if (corners.empty()) {
+      item.bounds = TransformedLightBounds(
+          transform, mesh->center_ - glm::vec3{mesh->radius_},
+          mesh->center_ + glm::vec3{mesh->radius_});
+      item.bounds.cos_theta_o = -1.0f;
+      item.bounds.two_sided = true;
+      item.bounds.power = 2.0f * emitter_energies[i];
+      items.push_back(item);
+      continue;
+    }
+
+    Material material = entity->GetMaterial();
+    glm::vec3 emission = material.emission * material.emission_strength;
+    float energy_density =
+        std::max(emission.r, std::max(emission.g, emission.b));
+    item.flags = 0;
+    for (uint32_t j = 0; j + 2 < corners.size(); j += 3) {
+      glm::vec3 p0{transform * glm::vec4{corners[j], 1.0f}};
+      glm::vec3 p1{transform * glm::vec4{corners[j + 1], 1.0f}};
+      glm::vec3 p2{transform * glm::vec4{corners[j + 2], 1.0f}};
+      glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+      float double_area = glm::length(normal);
+      item.primitive_id = j / 3;
+      item.bounds = LightBounds{};
+      if (double_area > 0.0f) {
+        item.bounds.lower = glm::min(p0, glm::min(p1, p2));
+        item.bounds.upper = glm::max(p0, glm::max(p1, p2));
+        item.bounds.axis = normal / double_area;
+        item.bounds.cos_theta_e = 0.0f;
+        item.bounds.two_sided = true;
+        item.bounds.power = energy_density * double_area;
+      }
+      items.push_back(item);
+    }
+  }
+
+  std::vector<LightBvhNode> nodes;
+  std::vector<uint32_t> leaf_nodes;
+  BuildLightBvh(items, nodes, leaf_nodes);
+  scene_settings_.num_light_bvh_node = nodes.size();
+
+  if (nodes.size() > light_bvh_node_capacity_ ||
+      leaf_nodes.size() > light_leaf_capacity_) {
     renderer_->Core()->Device()->WaitIdle();
-    renderer_->Core()->CreateTopLevelAccelerationStructure(instances,
-                                                           &top_level_as_);
-  } else {
-    top_level_as_->UpdateInstances(instances,
-                                   renderer_->Core()->GraphicsCommandPool(),
-                                   renderer_->Core()->GraphicsQueue());
+    if (nodes.size() > light_bvh_node_capacity_) {
+      light_bvh_node_capacity_ = NextPowerOfTwo(nodes.size());
+      light_bvh_node_buffer_ =
+          std::make_unique<vulkan::DynamicBuffer<LightBvhNode>>(
+              renderer_->Core(), light_bvh_node_capacity_,
+              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    }
+    if (leaf_nodes.size() > light_leaf_capacity_) {
+      light_leaf_capacity_ = NextPowerOfTwo(leaf_nodes.size());
+      light_leaf_buffer_ = std::make_unique<vulkan::DynamicBuffer<uint32_t>>(
+          renderer_->Core(), light_leaf_capacity_,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    }
+    BindLightBvhBuffers();
+  }
+  for (uint32_t i = 0; i < nodes.size(); i++) {
+    light_bvh_node_buffer_->At(i) = nodes[i];
+  }
+  for (uint32_t i = 0; i < leaf_nodes.size(); i++) {
+    light_leaf_buffer_->At(i) = leaf_nodes[i];
+  }
+}
+
+void Scene::BindLightBvhBuffers() {
+  for (int i = 0; i < renderer_->Core()->MaxFramesInFlight(); i++) {
+    for (auto descriptor_set :
+         {descriptor_sets_[i].get(), far_descriptor_sets_[i].get()}) {
+      descriptor_set->BindStorageBuffer(
+          4, light_bvh_node_buffer_->GetBuffer(i));
+      descriptor_set->BindStorageBuffer(5, light_leaf_buffer_->GetBuffer(i));
+    }
+  }
+}
+
+void Scene::UpdateTopLevelAccelerationStructure() {
+  for (uint32_t i = 0; i < num_mesh_entities_; i++) {
+    auto entity = binding_entities_[i];
+    auto blas =
+        renderer_->AssetManager()->RequestBlas(entity->RayTracingMeshId());
+    VkAccelerationStructureInstanceKHR instance{};
+    const glm::mat4 &transform = entity->metadata_.transform;
+    for (int row = 0; row < 3; row++) {
+      for (int col = 0; col < 4; col++) {
+        instance.transform.matrix[row][col] = transform[col][row];
+      }
+    }
+    instance.instanceCustomIndex = i;
+    // Entities whose BLAS is still queued stay inactive until it is built.
+    instance.mask = blas ? 0xFF : 0;
+    instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+    instance.accelerationStructureReference = blas ? blas->DeviceAddress() : 0;
+    tlas_instance_buffer_->At(i) = instance;
+  }
+  // The frame being prepared is no longer in flight, its TLAS can grow.
+  if (top_level_as_[renderer_->Core()->CurrentFrame()]->Reserve(
+          num_mesh_entities_)) {
+    LogWarning("Failed to allocate the TLAS for {} instances",
+               num_mesh_entities_);
   }
 }
 
 void Scene::UpdateDescriptorSetBindings() {
   uint32_t frame_id = renderer_->Core()->CurrentFrame();
-  raytracing_descriptor_sets_[frame_id]->BindAccelerationStructure(
-      0, top_level_as_.get());
+  top_level_as_[frame_id]->Bind(raytracing_descriptor_sets_[frame_id].get(), 0);
 
   for (auto &[id, entity] : entities_) {
     entity->descriptor_sets_[frame_id]->BindCombinedImageSampler(
@@ -244,7 +518,106 @@ void Scene::DrawEnvmap(VkCommandBuffer cmd_buffer, int frame_id) {
   vkCmdDraw(cmd_buffer, 6, 1, 0, 0);
 }
 
+float Scene::LodPixelScale() const {
+  // Pixels covered by one unit at unit distance from the camera.
+  VkExtent2D extent = renderer_->Core()->Swapchain()->Extent();
+  return static_cast<float>(extent.height) /
+         (2.0f * std::tan(camera_.GetFov() * 0.5f));
+}
+
+float Scene::ProjectedPixelsPerUnit(const Entity *entity,
+                                    const MeshAsset *mesh,
+                                    float pixel_scale) const {
+  glm::mat4 transform = entity->GetTransform();
+  float scale = std::max(glm::length(glm::vec3{transform[0]}),
+                         std::max(glm::length(glm::vec3{transform[1]}),
+                                  glm::length(glm::vec3{transform[2]})));
+  glm::vec3 center{transform * glm::vec4{mesh->center_, 1.0f}};
+  float distance =
+      glm::length(center - camera_.GetPosition()) - mesh->radius_ * scale;
+  if (distance <= 0.0f) {
+    return std::numeric_limits<float>::infinity();
+  }
+  return pixel_scale * scale / distance;
+}
+
+uint32_t Scene::SelectRasterLod(const Entity *entity,
+                                float pixel_scale) const {
+  uint32_t mesh_id = entity->MeshId();
+  auto asset_manager = renderer_->AssetManager();
+  auto mesh = asset_manager->GetMesh(mesh_id);
+  if (mesh->lod_mesh_ids_.empty()) {
+    return mesh_id;
+  }
+
+  float pixels_per_unit = ProjectedPixelsPerUnit(entity, mesh, pixel_scale);
+  for (auto it = mesh->lod_mesh_ids_.rbegin();
+       it != mesh->lod_mesh_ids_.rend(); ++it) {
+    if (asset_manager->GetMesh(*it)->lod_error_ * pixels_per_unit <=
+        lod_pixel_error_) {
+      return *it;
+    }
+  }
+  return mesh_id;
+}
+
+void Scene::UpdateRayTracingLods() {
+  auto asset_manager = renderer_->AssetManager();
+  const float pixel_scale = LodPixelScale();
+  const float coarsen_error =
+      ray_tracing_lod_pixel_error_ * (1.0f - ray_tracing_lod_hysteresis_);
+  const float refine_error =
+      ray_tracing_lod_pixel_error_ * (1.0f + ray_tracing_lod_hysteresis_);
+  for (auto &[id, entity] : entities_) {
+    auto mesh = asset_manager->GetMesh(entity->MeshId());
+    const auto &lod_mesh_ids = mesh->lod_mesh_ids_;
+    const uint32_t current_lod = std::min<uint32_t>(entity->ray_tracing_lod_,
+                                                    lod_mesh_ids.size());
+    uint32_t lod = current_lod;
+    if (lod_mesh_ids.empty()) {
+      entity->ray_tracing_lod_ = 0;
+      continue;
+    }
+
+    float pixels_per_unit =
+        ProjectedPixelsPerUnit(entity.get(), mesh, pixel_scale);
+    auto projected_error = [&](uint32_t level) {
+      if (!level) {
+        return 0.0f;
+      }
+      return asset_manager->GetMesh(lod_mesh_ids[level - 1])->lod_error_ *
+             pixels_per_unit;
+    };
+    while (lod > 0 && projected_error(lod) > refine_error) {
+      lod--;
+    }
+    while (lod < lod_mesh_ids.size() &&
+           projected_error(lod + 1) < coarsen_error) {
+      lod++;
+    }
+
+    // Levels get their BLAS on request. The entity stays on its level until
+    // the new one has been built, unless there is nothing to show either way.
+    auto level_mesh_id = [&](uint32_t level) {
+      return level ? lod_mesh_ids[level - 1] : entity->MeshId();
+    };
+    if (lod != current_lod &&
+        !asset_manager->RequestBlas(level_mesh_id(lod)) &&
+        asset_manager->GetMesh(level_mesh_id(current_lod))->blas_) {
+      lod = current_lod;
+    }
+    entity->ray_tracing_lod_ = lod;
+  }
+}
+
 void Scene::DrawEntities(VkCommandBuffer cmd_buffer, int frame_id) {
+  const float pixel_scale = LodPixelScale();
+
+  // All entity pipelines share one layout, switching between them keeps the
+  // bound descriptor sets valid.
+  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    renderer_->EntityPipeline(VertexFormat::Full)->Handle());
+  VertexFormat bound_vertex_format = VertexFormat::Full;
   for (auto &entity : entities_) {
     VkDescriptorSet descriptor_sets[] = {
         entity.second->DescriptorSet(frame_id)->Handle()};
@@ -252,16 +625,22 @@ void Scene::DrawEntities(VkCommandBuffer cmd_buffer, int frame_id) {
                             renderer_->EntityPipelineLayout()->Handle(), 1, 1,
                             descriptor_sets, 0, nullptr);
 
-    uint32_t mesh_id = entity.second->MeshId();
+    uint32_t mesh_id = SelectRasterLod(entity.second.get(), pixel_scale);
     auto mesh = renderer_->AssetManager()->GetMesh(mesh_id);
+    if (mesh->vertex_format_ != bound_vertex_format) {
+      bound_vertex_format = mesh->vertex_format_;
+      vkCmdBindPipeline(
+          cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+          renderer_->EntityPipeline(bound_vertex_format)->Handle());
+    }
     VkBuffer vertex_buffers[] = {
         mesh->vertex_buffer_->GetBuffer(frame_id)->Handle()};
     VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(cmd_buffer, 0, 1, vertex_buffers, offsets);
     vkCmdBindIndexBuffer(cmd_buffer,
                          mesh->index_buffer_->GetBuffer(frame_id)->Handle(), 0,
-                         VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(cmd_buffer, mesh->index_buffer_->Length(), 1, 0, 0, 0);
+                         IndexType(mesh->index_format_));
+    vkCmdDrawIndexed(cmd_buffer, mesh->num_indices_, 1, 0, 0, 0);
   }
 }
 
@@ -355,6 +734,28 @@ int Scene::SetEntityMesh(uint32_t entity_id, uint32_t mesh_id) {
     return -1;
   }
   entities_[entity_id]->metadata_.mesh_id = mesh_id;
+  entities_[entity_id]->metadata_.primitive_type =
+      uint32_t(PrimitiveType::Mesh);
+  entities_[entity_id]->ray_tracing_lod_ = 0;
+  return 0;
+}
+
+int Scene::SetEntityPrimitive(uint32_t entity_id, PrimitiveType type) {
+  if (entities_.find(entity_id) == entities_.end()) {
+    return -1;
+  }
+  entities_[entity_id]->metadata_.mesh_id =
+      renderer_->AssetManager()->GetPrimitiveMeshId(type);
+  entities_[entity_id]->metadata_.primitive_type = uint32_t(type);
+  entities_[entity_id]->ray_tracing_lod_ = 0;
+  return 0;
+}
+
+int Scene::GetEntityPrimitive(uint32_t entity_id, PrimitiveType &type) const {
+  if (entities_.find(entity_id) == entities_.end()) {
+    return -1;
+  }
+  type = entities_.at(entity_id)->GetPrimitiveType();
   return 0;
 }
 
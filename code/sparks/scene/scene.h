@@ -56,6 +56,11 @@ class Scene {
 
   void SyncData(VkCommandBuffer cmd_buffer, int frame_id);
 
+  // Records the TLAS build over the instances of the frame, ahead of the ray
+  // tracing dispatch in the same command buffer.
+  void BuildTopLevelAccelerationStructure(VkCommandBuffer cmd_buffer,
+                                          int frame_id);
+
   void DrawEnvmap(VkCommandBuffer cmd_buffer, int frame_id);
 
   void DrawEntities(VkCommandBuffer cmd_buffer, int frame_id);
@@ -107,17 +112,69 @@ class Scene {
 
   int GetEntityMesh(uint32_t entity_id, uint32_t &mesh_id) const;
 
+  // Replaces the mesh of the entity with an analytic primitive. Setting a mesh
+  // turns the entity back into a mesh entity.
+  int SetEntityPrimitive(uint32_t entity_id, PrimitiveType type);
+
+  int GetEntityPrimitive(uint32_t entity_id, PrimitiveType &type) const;
+
   void SetSceneSettings(const SceneSettings &settings);
 
   void GetSceneSettings(SceneSettings &settings) const;
 
+  // The raster preview draws the coarsest mesh level whose geometric error
+  // projects to at most this many pixels.
+  void SetLodPixelError(float pixels) {
+    lod_pixel_error_ = pixels;
+  }
+
+  float GetLodPixelError() const {
+    return lod_pixel_error_;
+  }
+
+  // Ray traced instances switch to the next coarser mesh level once its
+  // error projects to less than pixels * (1 - hysteresis), and back to a finer
+  // one once the current error exceeds pixels * (1 + hysteresis). The band
+  // keeps instances from toggling while the image accumulates.
+  void SetRayTracingLodPixelError(float pixels) {
+    ray_tracing_lod_pixel_error_ = pixels;
+  }
+
+  float GetRayTracingLodPixelError() const {
+    return ray_tracing_lod_pixel_error_;
+  }
+
+  void SetRayTracingLodHysteresis(float hysteresis) {
+    ray_tracing_lod_hysteresis_ = hysteresis;
+  }
+
+  float GetRayTracingLodHysteresis() const {
+    return ray_tracing_lod_hysteresis_;
+  }
+
  private:
   void UpdateDynamicBuffers();
 
+  // Rebuilds the light BVH if an emitter changed since the last call.
+  void UpdateLightBvh(const std::vector<uint32_t> &emitter_entities,
+                      const std::vector<float> &emitter_energies);
+
+  void BindLightBvhBuffers();
+
   void UpdateTopLevelAccelerationStructure();
 
   void UpdateDescriptorSetBindings();
 
+  void UpdateRayTracingLods();
+
+  float LodPixelScale() const;
+
+  float ProjectedPixelsPerUnit(const Entity *entity,
+                               const MeshAsset *mesh,
+                               float pixel_scale) const;
+
+  uint32_t SelectRasterLod(const Entity *entity, float pixel_scale) const;
+
   class Renderer *renderer_{};
 
   std::unique_ptr<vulkan::DescriptorPool> descriptor_pool_{};
@@ -129,6 +186,9 @@ class Scene {
 
   std::map<uint32_t, std::unique_ptr<Entity>> entities_{};
   uint32_t next_entity_id_{};
+  // Entities in the order of their binding indices, mesh entities first.
+  std::vector<Entity *> binding_entities_{};
+  uint32_t num_mesh_entities_{};
 
   std::unique_ptr<EnvMap> envmap_{};
 
@@ -139,11 +199,31 @@ class Scene {
   std::vector<std::unique_ptr<vulkan::DescriptorSet>>
       raytracing_descriptor_sets_{};
 
-  std::unique_ptr<vulkan::AccelerationStructure> top_level_as_{};
+  std::vector<std::unique_ptr<TopLevelAccelerationStructure>> top_level_as_{};
+  // Instance of every mesh entity, at its binding index.
+  std::unique_ptr<vulkan::DynamicBuffer<VkAccelerationStructureInstanceKHR>>
+      tlas_instance_buffer_{};
 
   std::unique_ptr<vulkan::DynamicBuffer<Material>> entity_material_buffer_{};
   std::unique_ptr<vulkan::DynamicBuffer<EntityMetadata>>
       entity_metadata_buffer_{};
+  // Selects emissive entities proportionally to their emitted power.
+  std::unique_ptr<vulkan::DynamicBuffer<AliasEntry>> emitter_alias_buffer_{};
+  // Light BVH over the emissive entities and their triangles. The buffers
+  // grow on demand and keep their capacity.
+  std::unique_ptr<vulkan::DynamicBuffer<LightBvhNode>>
+      light_bvh_node_buffer_{};
+  uint32_t light_bvh_node_capacity_{};
+  // Leaf node of every emitter, an entity finds its entries at the
+  // light_leaf_offset of its metadata, followed by one per triangle.
+  std::unique_ptr<vulkan::DynamicBuffer<uint32_t>> light_leaf_buffer_{};
+  uint32_t light_leaf_capacity_{};
+  // light_leaf_offset of every entity by binding index.
+  std::vector<uint32_t> light_leaf_offsets_{};
+  uint64_t light_bvh_hash_{};
   SceneSettings scene_settings_;
+  float lod_pixel_error_{1.0f};
+  float ray_tracing_lod_pixel_error_{0.5f};
+  float ray_tracing_lod_hysteresis_{0.25f};
 };
 }  // namespace sparks
@@ -3,6 +3,14 @@
 
 namespace sparks {
 
+// Keep in sync with the LIGHT_SAMPLER_* defines in scene_settings.glsl.
+enum class LightSampler : uint32_t {
+  // Picks emitters proportionally to their power from the alias table.
+  Power = 0,
+  // Walks the light BVH by the estimated contribution to the shading point.
+  LightBvh = 1
+};
+
 struct SceneSettings {
   glm::mat4 projection;      // camera_to_clip
   glm::mat4 inv_projection;  // inverse_projection
@@ -18,7 +26,15 @@ struct SceneSettings {
   float total_emission_energy{0.0f};
   uint32_t num_entity{0};
   uint32_t enable_direct_lighting{1};
-  float padding[6];
+  // Entities with analytic primitives are bound after all mesh entities, they
+  // are the last num_primitive_entity of the num_entity entities.
+  uint32_t num_primitive_entity{0};
+  // Entries of the emitter alias table, entities without emission are left
+  // out.
+  uint32_t num_emitter{0};
+  uint32_t light_sampler{static_cast<uint32_t>(LightSampler::LightBvh)};
+  uint32_t num_light_bvh_node{0};
+  float padding[2];
 };  // need align to 64(0x40) byte
 
 }  // namespace sparks
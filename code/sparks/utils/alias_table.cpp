@@ -0,0 +1,52 @@
+#include "sparks/utils/alias_table.h"
+
+#include "algorithm"
+
+namespace sparks {
+
+int BuildAliasTable(const std::vector<float> &weights,
+                    std::vector<AliasEntry> &table) {
+  table.clear();
+  double total = 0.0;
+  for (auto weight : weights) {
+    total += std::max(weight, 0.0f);
+  }
+  if (!(total > 0.0)) {
+    return -1;
+  }
+
+  const uint32_t n = weights.size();
+  table.resize(n);
+  std::vector<double> scaled(n);
+  std::vector<uint32_t> small;
+  std::vector<uint32_t> large;
+  for (uint32_t i = 0; i < n; i++) {
+    double weight = std::max(weights[i], 0.0f);
+    table[i] = {1.0f, i, float(weight / total), 0};
+    scaled[i] = weight * n / total;
+    (scaled[i] < 1.0 ? small : large).push_back(i);
+  }
+
+  while (!small.empty() && !large.empty()) {
+    uint32_t s = small.back();
+    small.pop_back();
+    uint32_t l = large.back();
+    table[s].threshold = float(scaled[s]);
+    table[s].alias = l;
+    scaled[l] -= 1.0 - scaled[s];
+    if (scaled[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // Whatever is left only differs from 1 by rounding.
+  for (auto i : small) {
+    table[i].threshold = 1.0f;
+  }
+  for (auto i : large) {
+    table[i].threshold = 1.0f;
+  }
+  return 0;
+}
+
+}  // namespace sparks
@@ -0,0 +1,25 @@
+#pragma once
+#include "cstdint"
+#include "vector"
+
+namespace sparks {
+
+// One slot of a Walker/Vose alias table, shared with the shaders, see
+// alias_table.glsl. Slot i is picked uniformly, then i itself is taken with
+// probability threshold and alias otherwise.
+struct AliasEntry {
+  float threshold;
+  uint32_t alias;
+  // Probability of item i, which is the slot index.
+  float pdf;
+  // Free for the owner of the table, e.g. the entity an emitter refers to.
+  uint32_t payload;
+};
+
+// Builds a table that samples item i proportionally to weights[i]. Negative
+// weights count as 0. Returns -1 and leaves the table empty if the weights sum
+// to 0.
+int BuildAliasTable(const std::vector<float> &weights,
+                    std::vector<AliasEntry> &table);
+
+}  // namespace sparks
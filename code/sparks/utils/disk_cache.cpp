@@ -0,0 +1,106 @@
+#include "sparks/utils/disk_cache.h"
+
+#include "chrono"
+#include "filesystem"
+#include "fstream"
+#include "mutex"
+#include "sparks/utils/hash.h"
+#include "thread"
+
+namespace sparks {
+
+namespace {
+std::mutex cache_directory_mutex;
+std::string cache_directory;
+}  // namespace
+
+std::string CacheDirectory() {
+  std::lock_guard<std::mutex> lock(cache_directory_mutex);
+  if (cache_directory.empty()) {
+    std::error_code ec;
+    auto temp_directory = std::filesystem::temp_directory_path(ec);
+    if (ec) {
+      temp_directory = ".";
+    }
+    cache_directory = (temp_directory / "sparks" / "cache").string();
+  }
+  return cache_directory;
+}
+
+void SetCacheDirectory(const std::string &directory) {
+  std::lock_guard<std::mutex> lock(cache_directory_mutex);
+  cache_directory = directory;
+}
+
+std::string CacheFilePath(const std::string &category, uint64_t key) {
+  return (std::filesystem::path(CacheDirectory()) / category /
+          fmt::format("{:016x}.bin", key))
+      .string();
+}
+
+int SourceFileKey(const std::string &path, uint64_t &key) {
+  std::error_code ec;
+  auto canonical_path = std::filesystem::canonical(path, ec);
+  if (ec) {
+    return -1;
+  }
+  auto size = std::filesystem::file_size(canonical_path, ec);
+  if (ec) {
+    return -1;
+  }
+  auto write_time = std::filesystem::last_write_time(canonical_path, ec);
+  if (ec) {
+    return -1;
+  }
+  key = HashString(canonical_path.string());
+  key = HashCombine(key, size);
+  key = HashCombine(key, uint64_t(write_time.time_since_epoch().count()));
+  return 0;
+}
+
+int WriteCacheFile(const std::string &path,
+                   const std::vector<std::pair<const void *, size_t>> &blocks) {
+  std::error_code ec;
+  std::filesystem::path file_path(path);
+  std::filesystem::create_directories(file_path.parent_path(), ec);
+  if (ec) {
+    LogWarning("Failed to create cache directory: {}",
+               file_path.parent_path().string());
+    return -1;
+  }
+
+  // Several viewer instances may write the same entry concurrently.
+  auto temp_path = file_path;
+  temp_path += fmt::format(
+      ".{:016x}.tmp",
+      HashCombine(std::hash<std::thread::id>{}(std::this_thread::get_id()),
+                  uint64_t(std::chrono::steady_clock::now()
+                               .time_since_epoch()
+                               .count())));
+  {
+    std::ofstream file(temp_path, std::ios::binary);
+    if (!file.is_open()) {
+      LogWarning("Failed to open file: {}", temp_path.string());
+      return -1;
+    }
+    for (auto &block : blocks) {
+      file.write(static_cast<const char *>(block.first),
+                 std::streamsize(block.second));
+    }
+    if (!file.good()) {
+      LogWarning("Failed to write cache file: {}", temp_path.string());
+      file.close();
+      std::filesystem::remove(temp_path, ec);
+      return -1;
+    }
+  }
+
+  std::filesystem::rename(temp_path, file_path, ec);
+  if (ec) {
+    std::filesystem::remove(temp_path, ec);
+    return -1;
+  }
+  return 0;
+}
+
+}  // namespace sparks
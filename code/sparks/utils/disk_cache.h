@@ -0,0 +1,22 @@
+#pragma once
+#include "sparks/utils/common.h"
+
+namespace sparks {
+// Derived data (processed meshes, encoded textures) is cached in files named
+// after a 64-bit key below the cache directory. The directory defaults to
+// <temp>/sparks/cache.
+std::string CacheDirectory();
+
+void SetCacheDirectory(const std::string &directory);
+
+std::string CacheFilePath(const std::string &category, uint64_t key);
+
+// Hashes the canonical path, size and modification time of a source file, so
+// keys derived from it change whenever the file is touched.
+int SourceFileKey(const std::string &path, uint64_t &key);
+
+// Writes the blocks into a temporary file next to path and renames it into
+// place, readers never observe a partially written cache file.
+int WriteCacheFile(const std::string &path,
+                   const std::vector<std::pair<const void *, size_t>> &blocks);
+}  // namespace sparks
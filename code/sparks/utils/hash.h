@@ -0,0 +1,88 @@
+#pragma once
+#include "cstdint"
+#include "cstring"
+#include "string"
+
+namespace sparks {
+
+// Finalizer of SplitMix64, spreads every input bit over the whole result.
+inline uint64_t HashMix64(uint64_t value) {
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ull;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebull;
+  value ^= value >> 31;
+  return value;
+}
+
+inline uint64_t HashCombine(uint64_t seed, uint64_t value) {
+  return HashMix64(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) +
+                           (seed >> 2)));
+}
+
+inline uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0) {
+  auto bytes = static_cast<const uint8_t *>(data);
+  uint64_t hash = HashCombine(seed, size);
+  for (; size >= 8; size -= 8, bytes += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes, 8);
+    hash = HashCombine(hash, word);
+  }
+  if (size) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes, size);
+    hash = HashCombine(hash, word);
+  }
+  return hash;
+}
+
+// 128-bit content key, wide enough that distinct assets never collide in
+// practice.
+struct Hash128 {
+  uint64_t low{};
+  uint64_t high{};
+
+  bool operator==(const Hash128 &other) const {
+    return low == other.low && high == other.high;
+  }
+
+  bool operator<(const Hash128 &other) const {
+    return low != other.low ? low < other.low : high < other.high;
+  }
+};
+
+inline uint64_t RotateLeft64(uint64_t value, int shift) {
+  return (value << shift) | (value >> (64 - shift));
+}
+
+// Two independent lanes of the xxHash64 round, 16 bytes per step, folded
+// together at the end. Pass the result of a previous call as seed to hash
+// several buffers as one.
+inline Hash128 HashBytes128(const void *data,
+                            size_t size,
+                            const Hash128 &seed = {}) {
+  constexpr uint64_t kPrime1 = 0x9e3779b185ebca87ull;
+  constexpr uint64_t kPrime2 = 0xc2b2ae3d27d4eb4full;
+  auto bytes = static_cast<const uint8_t *>(data);
+  uint64_t lane0 = HashCombine(seed.low, size);
+  uint64_t lane1 = HashCombine(seed.high ^ kPrime1, size);
+  for (; size >= 16; size -= 16, bytes += 16) {
+    uint64_t words[2];
+    std::memcpy(words, bytes, 16);
+    lane0 = RotateLeft64(lane0 + words[0] * kPrime2, 31) * kPrime1;
+    lane1 = RotateLeft64(lane1 + words[1] * kPrime2, 31) * kPrime1;
+  }
+  if (size) {
+    uint64_t words[2] = {};
+    std::memcpy(words, bytes, size);
+    lane0 = HashCombine(lane0, words[0]);
+    lane1 = HashCombine(lane1, words[1]);
+  }
+  return {HashCombine(lane0, lane1), HashCombine(lane1, lane0)};
+}
+
+inline uint64_t HashString(const std::string &str, uint64_t seed = 0) {
+  return HashBytes(str.data(), str.size(), seed);
+}
+
+}  // namespace sparks
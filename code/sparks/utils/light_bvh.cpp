@@ -0,0 +1,258 @@
+#include "sparks/utils/light_bvh.h"
+
+#include "algorithm"
+#include "cmath"
+#include "glm/gtc/constants.hpp"
+
+namespace sparks {
+
+namespace {
+constexpr int kNumBuckets = 12;
+
+float SafeAcos(float x) {
+  return std::acos(std::clamp(x, -1.0f, 1.0f));
+}
+
+float SafeSqrt(float x) {
+  return std::sqrt(std::max(x, 0.0f));
+}
+
+float SurfaceArea(const glm::vec3 &lower, const glm::vec3 &upper) {
+  glm::vec3 d = glm::max(upper - lower, glm::vec3{0.0f});
+  return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+// Solid angle measure of the orientation cone widened by theta_e, the M_omega
+// term of the surface area orientation heuristic.
+float OrientationMeasure(float cos_theta_o, float cos_theta_e) {
+  const float pi = glm::pi<float>();
+  float theta_o = SafeAcos(cos_theta_o);
+  float theta_e = SafeAcos(cos_theta_e);
+  float theta_w = std::min(theta_o + theta_e, pi);
+  float sin_theta_o = SafeSqrt(1.0f - cos_theta_o * cos_theta_o);
+  return 2.0f * pi * (1.0f - cos_theta_o) +
+         0.5f * pi *
+             (2.0f * theta_w * sin_theta_o -
+              std::cos(theta_o - 2.0f * theta_w) -
+              2.0f * theta_o * sin_theta_o + cos_theta_o);
+}
+
+float SplitCost(const LightBounds &bounds, float extent_ratio) {
+  return bounds.power *
+         OrientationMeasure(bounds.cos_theta_o, bounds.cos_theta_e) *
+         SurfaceArea(bounds.lower, bounds.upper) * extent_ratio;
+}
+
+glm::vec3 Centroid(const LightBounds &bounds) {
+  return (bounds.lower + bounds.upper) * 0.5f;
+}
+
+class LightBvhBuilder {
+ public:
+  LightBvhBuilder(const std::vector<LightBvhItem> &items,
+                  std::vector<LightBvhNode> &nodes,
+                  std::vector<uint32_t> &leaf_nodes)
+      : items_(items), nodes_(nodes), leaf_nodes_(leaf_nodes) {
+  }
+
+  void Build(std::vector<uint32_t> &order) {
+    Build(order.data(), order.data() + order.size(), kLightBvhInvalid);
+  }
+
+ private:
+  uint32_t Build(uint32_t *begin, uint32_t *end, uint32_t parent) {
+    const uint32_t node_index = nodes_.size();
+    nodes_.emplace_back();
+
+    LightBounds bounds;
+    for (auto it = begin; it != end; ++it) {
+      bounds = UnionLightBounds(bounds, items_[*it].bounds);
+    }
+
+    LightBvhNode node{};
+    node.lower = bounds.lower;
+    node.upper = bounds.upper;
+    node.power = bounds.power;
+    node.axis = bounds.axis;
+    node.cos_theta_o = bounds.cos_theta_o;
+    node.cos_theta_e = bounds.cos_theta_e;
+    node.flags = bounds.two_sided ? kLightBvhTwoSided : 0u;
+    node.parent = parent;
+
+    if (end - begin == 1) {
+      const LightBvhItem &item = items_[*begin];
+      node.flags |= kLightBvhLeaf | item.flags;
+      node.index = item.index;
+      node.primitive_id = item.primitive_id;
+      nodes_[node_index] = node;
+      leaf_nodes_[*begin] = node_index;
+      return node_index;
+    }
+
+    uint32_t *mid = Split(begin, end, bounds);
+    Build(begin, mid, node_index);
+    node.index = Build(mid, end, node_index);
+    nodes_[node_index] = node;
+    return node_index;
+  }
+
+  // Partitions the items by the cheapest bucket boundary over all axes, or by
+  // the median centroid if no boundary separates them.
+  uint32_t *Split(uint32_t *begin, uint32_t *end, const LightBounds &bounds) {
+    glm::vec3 centroid_lower{std::numeric_limits<float>::max()};
+    glm::vec3 centroid_upper{std::numeric_limits<float>::lowest()};
+    for (auto it = begin; it != end; ++it) {
+      glm::vec3 centroid = Centroid(items_[*it].bounds);
+      centroid_lower = glm::min(centroid_lower, centroid);
+      centroid_upper = glm::max(centroid_upper, centroid);
+    }
+    glm::vec3 extent = bounds.upper - bounds.lower;
+    float max_extent = std::max(extent.x, std::max(extent.y, extent.z));
+
+    float best_cost = std::numeric_limits<float>::max();
+    int best_dim = -1;
+    int best_bucket = -1;
+    for (int dim = 0; dim < 3; dim++) {
+      if (!(centroid_upper[dim] > centroid_lower[dim]) || !(extent[dim] > 0)) {
+        continue;
+      }
+      LightBounds buckets[kNumBuckets];
+      for (auto it = begin; it != end; ++it) {
+        const LightBounds &item_bounds = items_[*it].bounds;
+        int b = Bucket(Centroid(item_bounds)[dim], centroid_lower[dim],
+                       centroid_upper[dim]);
+        buckets[b] = UnionLightBounds(buckets[b], item_bounds);
+      }
+      // Unbalanced boxes are penalized, thin slabs along dim split well in
+      // space but poorly in the other two axes.
+      float extent_ratio = max_extent / extent[dim];
+      for (int split = 0; split < kNumBuckets - 1; split++) {
+        LightBounds below;
+        LightBounds above;
+        for (int b = 0; b <= split; b++) {
+          below = UnionLightBounds(below, buckets[b]);
+        }
+        for (int b = split + 1; b < kNumBuckets; b++) {
+          above = UnionLightBounds(above, buckets[b]);
+        }
+        if (below.power <= 0.0f || above.power <= 0.0f) {
+          continue;
+        }
+        float cost = SplitCost(below, extent_ratio) +
+                     SplitCost(above, extent_ratio);
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_dim = dim;
+          best_bucket = split;
+        }
+      }
+    }
+
+    if (best_dim >= 0) {
+      uint32_t *mid = std::partition(begin, end, [&](uint32_t i) {
+        return Bucket(Centroid(items_[i].bounds)[best_dim],
+                      centroid_lower[best_dim],
+                      centroid_upper[best_dim]) <= best_bucket;
+      });
+      if (mid != begin && mid != end) {
+        return mid;
+      }
+    }
+
+    glm::vec3 centroid_extent = centroid_upper - centroid_lower;
+    int dim = 0;
+    if (centroid_extent.y > centroid_extent[dim]) {
+      dim = 1;
+    }
+    if (centroid_extent.z > centroid_extent[dim]) {
+      dim = 2;
+    }
+    uint32_t *mid = begin + (end - begin) / 2;
+    std::nth_element(begin, mid, end, [&](uint32_t a, uint32_t b) {
+      return Centroid(items_[a].bounds)[dim] < Centroid(items_[b].bounds)[dim];
+    });
+    return mid;
+  }
+
+  static int Bucket(float x, float lower, float upper) {
+    int b = static_cast<int>(kNumBuckets * (x - lower) / (upper - lower));
+    return std::clamp(b, 0, kNumBuckets - 1);
+  }
+
+  const std::vector<LightBvhItem> &items_;
+  std::vector<LightBvhNode> &nodes_;
+  std::vector<uint32_t> &leaf_nodes_;
+};
+}  // namespace
+
+LightBounds UnionLightBounds(const LightBounds &a, const LightBounds &b) {
+  if (a.power <= 0.0f) {
+    return b;
+  }
+  if (b.power <= 0.0f) {
+    return a;
+  }
+
+  LightBounds result;
+  result.lower = glm::min(a.lower, b.lower);
+  result.upper = glm::max(a.upper, b.upper);
+  result.power = a.power + b.power;
+  result.cos_theta_e = std::min(a.cos_theta_e, b.cos_theta_e);
+  result.two_sided = a.two_sided || b.two_sided;
+
+  // Smallest cone around both orientation cones.
+  const float pi = glm::pi<float>();
+  float theta_a = SafeAcos(a.cos_theta_o);
+  float theta_b = SafeAcos(b.cos_theta_o);
+  float theta_d = SafeAcos(glm::dot(a.axis, b.axis));
+  if (std::min(theta_d + theta_b, pi) <= theta_a) {
+    result.axis = a.axis;
+    result.cos_theta_o = a.cos_theta_o;
+    return result;
+  }
+  if (std::min(theta_d + theta_a, pi) <= theta_b) {
+    result.axis = b.axis;
+    result.cos_theta_o = b.cos_theta_o;
+    return result;
+  }
+
+  float theta_o = (theta_a + theta_d + theta_b) * 0.5f;
+  glm::vec3 rotation_axis = glm::cross(a.axis, b.axis);
+  float rotation_axis_length = glm::length(rotation_axis);
+  if (theta_o >= pi || rotation_axis_length < 1e-12f) {
+    result.axis = a.axis;
+    result.cos_theta_o = -1.0f;
+    return result;
+  }
+  // Rotates a.axis towards b.axis, the rotation axis is perpendicular to it.
+  float theta_r = theta_o - theta_a;
+  rotation_axis /= rotation_axis_length;
+  result.axis = glm::normalize(a.axis * std::cos(theta_r) +
+                               glm::cross(rotation_axis, a.axis) *
+                                   std::sin(theta_r));
+  result.cos_theta_o = std::cos(theta_o);
+  return result;
+}
+
+int BuildLightBvh(const std::vector<LightBvhItem> &items,
+                  std::vector<LightBvhNode> &nodes,
+                  std::vector<uint32_t> &leaf_nodes) {
+  nodes.clear();
+  leaf_nodes.assign(items.size(), kLightBvhInvalid);
+
+  std::vector<uint32_t> order;
+  for (uint32_t i = 0; i < items.size(); i++) {
+    if (items[i].bounds.power > 0.0f) {
+      order.push_back(i);
+    }
+  }
+  if (order.empty()) {
+    return -1;
+  }
+
+  nodes.reserve(order.size() * 2 - 1);
+  LightBvhBuilder(items, nodes, leaf_nodes).Build(order);
+  return 0;
+}
+
+}  // namespace sparks
@@ -0,0 +1,72 @@
+#pragma once
+#include "cstdint"
+#include "glm/glm.hpp"
+#include "limits"
+#include "vector"
+
+namespace sparks {
+
+// Meshes with at most this many triangles keep them on the host, so that the
+// light BVH can give every emissive triangle a leaf of its own. Larger meshes
+// become a single leaf that picks its triangles by area.
+constexpr uint32_t kLightBvhMaxMeshTriangles = 1u << 12;
+
+constexpr uint32_t kLightBvhInvalid = 0xffffffffu;
+
+// Keep in sync with light_bvh.glsl.
+constexpr uint32_t kLightBvhLeaf = 1u << 0;
+// Emits on both sides of the orientation cone, e.g. planar emitters.
+constexpr uint32_t kLightBvhTwoSided = 1u << 1;
+// The leaf stands for a whole entity instead of one of its triangles.
+constexpr uint32_t kLightBvhEntityLeaf = 1u << 2;
+
+// Spatial and directional extent of a set of emitters. The emission leaves
+// the surfaces within theta_o around axis, and spreads by up to theta_e beyond
+// that.
+struct LightBounds {
+  glm::vec3 lower{std::numeric_limits<float>::max()};
+  glm::vec3 upper{std::numeric_limits<float>::lowest()};
+  glm::vec3 axis{0.0f, 0.0f, 1.0f};
+  float power{0.0f};
+  float cos_theta_o{1.0f};
+  float cos_theta_e{1.0f};
+  bool two_sided{false};
+};
+
+LightBounds UnionLightBounds(const LightBounds &a, const LightBounds &b);
+
+struct LightBvhItem {
+  LightBounds bounds;
+  // Copied to the leaf, the scene stores the entity binding index and the
+  // triangle here.
+  uint32_t index;
+  uint32_t primitive_id;
+  // Extra leaf flags, e.g. kLightBvhEntityLeaf.
+  uint32_t flags;
+};
+
+// Node layout shared with the shaders, see light_bvh.glsl. The first child of
+// an interior node directly follows it, index holds the second one.
+struct LightBvhNode {
+  glm::vec3 lower;
+  float power;
+  glm::vec3 upper;
+  float cos_theta_o;
+  glm::vec3 axis;
+  float cos_theta_e;
+  uint32_t flags;
+  uint32_t index;
+  uint32_t primitive_id;
+  // kLightBvhInvalid for the root.
+  uint32_t parent;
+};
+
+// Builds a binary BVH with one light per leaf, splitting by the surface area
+// orientation heuristic. leaf_nodes receives the leaf of every item, or
+// kLightBvhInvalid for items without power. Returns -1 and leaves the nodes
+// empty if no item has power.
+int BuildLightBvh(const std::vector<LightBvhItem> &items,
+                  std::vector<LightBvhNode> &nodes,
+                  std::vector<uint32_t> &leaf_nodes);
+
+}  // namespace sparks
@@ -0,0 +1,125 @@
+#include "sparks/utils/mapped_file.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sparks {
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+#ifdef _WIN32
+
+int MappedFile::Open(const std::string &path) {
+  Close();
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    LogWarning("Failed to open file: {}", path);
+    return -1;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    LogWarning("Failed to query file size: {}", path);
+    CloseHandle(file);
+    return -1;
+  }
+  file_handle_ = file;
+  if (!size.QuadPart) {
+    return 0;
+  }
+
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    LogWarning("Failed to map file: {}", path);
+    Close();
+    return -1;
+  }
+  mapping_handle_ = mapping;
+  data_ = static_cast<const char *>(
+      MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!data_) {
+    LogWarning("Failed to map file: {}", path);
+    Close();
+    return -1;
+  }
+  size_ = static_cast<size_t>(size.QuadPart);
+  return 0;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_handle_) {
+    CloseHandle(mapping_handle_);
+  }
+  if (file_handle_) {
+    CloseHandle(file_handle_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  mapping_handle_ = nullptr;
+  file_handle_ = nullptr;
+}
+
+#else
+
+int MappedFile::Open(const std::string &path) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LogWarning("Failed to open file: {}", path);
+    return -1;
+  }
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) < 0) {
+    LogWarning("Failed to query file size: {}", path);
+    close(fd);
+    return -1;
+  }
+  if (!file_stat.st_size) {
+    close(fd);
+    return 0;
+  }
+
+  void *data = mmap(nullptr, static_cast<size_t>(file_stat.st_size),
+                    PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+  if (data == MAP_FAILED) {
+    LogWarning("Failed to map file: {}", path);
+    return -1;
+  }
+  madvise(data, static_cast<size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+  data_ = static_cast<const char *>(data);
+  size_ = static_cast<size_t>(file_stat.st_size);
+  return 0;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+#endif
+
+}  // namespace sparks
@@ -0,0 +1,34 @@
+#pragma once
+#include "sparks/utils/common.h"
+
+namespace sparks {
+// Read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  int Open(const std::string &path);
+
+  void Close();
+
+  const char *Data() const {
+    return data_;
+  }
+
+  size_t Size() const {
+    return size_;
+  }
+
+ private:
+  const char *data_{nullptr};
+  size_t size_{0};
+#ifdef _WIN32
+  void *file_handle_{nullptr};
+  void *mapping_handle_{nullptr};
+#endif
+};
+}  // namespace sparks
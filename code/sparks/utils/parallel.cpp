@@ -0,0 +1,65 @@
+#include "sparks/utils/parallel.h"
+
+#include "algorithm"
+#include "atomic"
+#include "sparks/utils/thread_pool.h"
+#include "thread"
+#include "vector"
+
+namespace sparks {
+
+namespace {
+std::atomic<uint32_t> worker_thread_count{0};
+
+// Runs every range but the caller's own. Sized on first use, the calling
+// thread being the last worker.
+ThreadPool &SharedThreadPool() {
+  static ThreadPool pool(std::max(WorkerThreadCount() - 1, 1u));
+  return pool;
+}
+}  // namespace
+
+uint32_t WorkerThreadCount() {
+  uint32_t count = worker_thread_count.load();
+  if (!count) {
+    count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  return count;
+}
+
+void SetWorkerThreadCount(uint32_t count) {
+  worker_thread_count = count;
+}
+
+void ParallelFor(uint64_t count,
+                 const std::function<void(uint64_t, uint64_t)> &func,
+                 uint64_t min_grain) {
+  if (!count) {
+    return;
+  }
+  min_grain = std::max<uint64_t>(min_grain, 1);
+  uint64_t num_ranges = std::min<uint64_t>(WorkerThreadCount(),
+                                           (count + min_grain - 1) / min_grain);
+  // Pool workers already keep every core busy, and waiting on the pool from
+  // one of its own workers could stall it.
+  if (num_ranges <= 1 || ThreadPool::OnWorkerThread()) {
+    func(0, count);
+    return;
+  }
+
+  ThreadPool &pool = SharedThreadPool();
+  num_ranges = std::min<uint64_t>(num_ranges, pool.NumThreads() + 1);
+  std::vector<std::future<void>> ranges;
+  ranges.reserve(num_ranges - 1);
+  for (uint64_t i = 1; i < num_ranges; i++) {
+    ranges.push_back(pool.Submit(
+        [&func, begin = count * i / num_ranges,
+         end = count * (i + 1) / num_ranges]() { func(begin, end); }));
+  }
+  func(0, count / num_ranges);
+  for (auto &range : ranges) {
+    range.get();
+  }
+}
+
+}  // namespace sparks
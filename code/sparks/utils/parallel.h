@@ -0,0 +1,23 @@
+#pragma once
+#include "functional"
+#include "sparks/utils/common.h"
+
+namespace sparks {
+
+// Number of worker threads used by ParallelFor, at least 1.
+uint32_t WorkerThreadCount();
+
+// Takes effect for ParallelFor only before its first call, which starts the
+// shared workers.
+void SetWorkerThreadCount(uint32_t count);
+
+// Splits [0, count) into contiguous ranges of at least min_grain elements
+// and invokes func(begin, end) for each range on a shared ThreadPool and the
+// calling thread. Calls from the workers of any ThreadPool run inline. The
+// ranges are disjoint and cover the whole interval, callers must not rely on
+// how many ranges are produced.
+void ParallelFor(uint64_t count,
+                 const std::function<void(uint64_t, uint64_t)> &func,
+                 uint64_t min_grain = 4096);
+
+}  // namespace sparks
@@ -0,0 +1,63 @@
+#include "sparks/utils/thread_pool.h"
+
+#include "sparks/utils/parallel.h"
+
+namespace sparks {
+
+namespace {
+thread_local bool on_worker_thread = false;
+}  // namespace
+
+ThreadPool::ThreadPool(uint32_t num_threads) {
+  if (!num_threads) {
+    num_threads = WorkerThreadCount();
+  }
+  threads_.reserve(num_threads);
+  for (uint32_t i = 0; i < num_threads; i++) {
+    threads_.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  std::deque<std::function<void()>> dropped_tasks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    dropped_tasks.swap(tasks_);
+  }
+  condition_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  condition_.notify_one();
+}
+
+bool ThreadPool::OnWorkerThread() {
+  return on_worker_thread;
+}
+
+void ThreadPool::WorkerLoop() {
+  on_worker_thread = true;
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace sparks
@@ -0,0 +1,56 @@
+#pragma once
+#include "condition_variable"
+#include "deque"
+#include "functional"
+#include "future"
+#include "memory"
+#include "mutex"
+#include "sparks/utils/common.h"
+#include "thread"
+#include "type_traits"
+#include "vector"
+
+namespace sparks {
+
+// Long lived worker threads running tasks in submission order. Unlike
+// ParallelFor, which splits one loop and returns once it is done, tasks run
+// in the background and report through futures.
+class ThreadPool {
+ public:
+  // num_threads of 0 uses WorkerThreadCount().
+  explicit ThreadPool(uint32_t num_threads = 0);
+
+  // Tasks that have not started are dropped, their futures report
+  // std::future_errc::broken_promise. Running tasks are waited for.
+  ~ThreadPool();
+
+  uint32_t NumThreads() const {
+    return threads_.size();
+  }
+
+  // True on the worker threads of any ThreadPool.
+  static bool OnWorkerThread();
+
+  template <class Func>
+  std::future<std::invoke_result_t<Func>> Submit(Func &&func) {
+    using Result = std::invoke_result_t<Func>;
+    // std::function needs a copyable target, packaged_task is move only.
+    auto task = std::make_shared<std::packaged_task<Result()>>(
+        std::forward<Func>(func));
+    std::future<Result> future = task->get_future();
+    Enqueue([task]() { (*task)(); });
+    return future;
+  }
+
+ private:
+  void Enqueue(std::function<void()> task);
+  void WorkerLoop();
+
+  std::vector<std::thread> threads_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_{false};
+};
+
+}  // namespace sparks
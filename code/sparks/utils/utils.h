@@ -1,5 +1,12 @@
 #pragma once
+#include "sparks/utils/alias_table.h"
+#include "sparks/utils/disk_cache.h"
 #include "sparks/utils/file_probe.h"
+#include "sparks/utils/hash.h"
 #include "sparks/utils/hyper_params.h"
+#include "sparks/utils/light_bvh.h"
+#include "sparks/utils/mapped_file.h"
+#include "sparks/utils/parallel.h"
+#include "sparks/utils/thread_pool.h"
 
 namespace sparks {}